@@ -0,0 +1,572 @@
+#include "analysis.hpp"
+
+#include <algorithm>
+
+namespace pl0::analysis {
+
+// ScopedAnalysis
+
+auto ScopedAnalysis::lookup(std::string_view name) const -> const Symbol* {
+
+    for(auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++) {
+        const auto entry = scope->find(name);
+        if(entry != scope->end()) return &entry->second;
+    }
+
+    return nullptr;
+}
+
+auto ScopedAnalysis::lookupVariable(const Token& name) const -> const Symbol* {
+    const Symbol* symbol = lookup(name.lexeme);
+    return symbol != nullptr && symbol->kind == Symbol::Kind::Variable ? symbol : nullptr;
+}
+
+auto ScopedAnalysis::lookupProcedure(const Token& name) const -> ProcedureDeclaration* {
+    const Symbol* symbol = lookup(name.lexeme);
+    return symbol != nullptr && symbol->kind == Symbol::Kind::Procedure ? symbol->procedure : nullptr;
+}
+
+auto ScopedAnalysis::visit(Block* block) -> void {
+
+    m_scopes.emplace_back();
+
+    analyzeStatement(block->constantsDeclaration);
+    analyzeStatement(block->variablesDeclaration);
+    analyzeStatement(block->sharedDeclaration);
+
+    for(auto& procedure : block->procedureDeclarations) {
+        analyzeStatement(procedure);
+    }
+
+    analyzeStatement(block->statement);
+
+    m_scopes.pop_back();
+}
+
+auto ScopedAnalysis::visit(ConstDeclarations* decl) -> void {
+    for(const auto& [ident, _] : decl->declarations) {
+        m_scopes.back().try_emplace(ident.lexeme, Symbol{Symbol::Kind::Constant, depth()});
+    }
+}
+
+auto ScopedAnalysis::visit(VariableDeclarations* decl) -> void {
+    for(const auto& [ident, _] : decl->declarations) {
+        m_scopes.back().try_emplace(ident.lexeme, Symbol{Symbol::Kind::Variable, depth(), &ident});
+    }
+}
+
+auto ScopedAnalysis::visit(ProcedureDeclaration* decl) -> void {
+
+    m_scopes.back().try_emplace(decl->name.lexeme, Symbol{Symbol::Kind::Procedure, depth(), nullptr, decl});
+
+    m_procedures.push_back(decl);
+    analyzeStatement(decl->block);
+    m_procedures.pop_back();
+}
+
+auto ScopedAnalysis::visit(AssignStatement* stmt) -> void {
+    analyzeExpression(stmt->index);
+    analyzeExpression(stmt->rvalue);
+}
+
+auto ScopedAnalysis::visit(CallStatement* stmt) -> void {}
+
+auto ScopedAnalysis::visit(InputStatement* stmt) -> void {
+    analyzeExpression(stmt->index);
+}
+
+auto ScopedAnalysis::visit(PrintStatement* stmt) -> void {
+    analyzeExpression(stmt->argument);
+}
+
+auto ScopedAnalysis::visit(BeginStatement* stmt) -> void {
+    for(auto& statement : stmt->statements) {
+        analyzeStatement(statement);
+    }
+}
+
+auto ScopedAnalysis::visit(IfStatement* stmt) -> void {
+    analyzeExpression(stmt->condition);
+    analyzeStatement(stmt->body);
+}
+
+auto ScopedAnalysis::visit(WhileStatement* stmt) -> void {
+    analyzeExpression(stmt->condition);
+    analyzeStatement(stmt->body);
+}
+
+auto ScopedAnalysis::visit(ForStatement* stmt) -> void {
+    analyzeExpression(stmt->from);
+    analyzeExpression(stmt->to);
+    analyzeExpression(stmt->step);
+    analyzeStatement(stmt->body);
+}
+
+auto ScopedAnalysis::visit(ParallelStatement* stmt) -> void {
+    for(auto& call : stmt->calls) {
+        analyzeStatement(call);
+    }
+}
+
+auto ScopedAnalysis::visit(OddExpression* expr) -> void {
+    analyzeExpression(expr->expr);
+}
+
+auto ScopedAnalysis::visit(BinaryExpression* expr) -> void {
+    analyzeExpression(expr->left);
+    analyzeExpression(expr->right);
+}
+
+auto ScopedAnalysis::visit(UnaryExpression* expr) -> void {
+    analyzeExpression(expr->right);
+}
+
+auto ScopedAnalysis::visit(VariableExpression* expr) -> void {}
+
+auto ScopedAnalysis::visit(IndexExpression* expr) -> void {
+    analyzeExpression(expr->index);
+}
+
+auto ScopedAnalysis::visit(LiteralExpression* expr) -> void {}
+
+// CaptureAnalysis
+
+auto CaptureAnalysis::analyze(StatementPtr& program) -> void {
+
+    // A call can make its caller need the static link, even when the callee
+    // is found out to need it only later (e.g. recursive procedures), so
+    // the program is visited until nothing changes.
+    do {
+        m_changed = false;
+        resetScopes();
+
+        analyzeStatement(program);
+    } while(m_changed);
+}
+
+auto CaptureAnalysis::needsFrame(const ProcedureDeclaration* procedure) const -> bool {
+
+    if(capturedVariables(procedure) > 0) return true;
+
+    const auto* block = static_cast<const Block*>(procedure->block.get());
+    if(block == nullptr) return false;
+
+    for(const auto& nested : block->procedureDeclarations) {
+        if(needsStaticLink(static_cast<const ProcedureDeclaration*>(nested.get()))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto CaptureAnalysis::frameIndex(const Token* variable) const -> std::uint32_t {
+    const auto entry = m_frameIndices.find(variable);
+    return entry != m_frameIndices.end() ? entry->second : 0;
+}
+
+auto CaptureAnalysis::capturedVariables(const ProcedureDeclaration* procedure) const -> std::uint32_t {
+    const auto entry = m_capturedVariables.find(procedure);
+    return entry != m_capturedVariables.end() ? entry->second : 0;
+}
+
+auto CaptureAnalysis::reference(const Token& name) -> void {
+
+    const Symbol* symbol = lookupVariable(name);
+
+    if(symbol == nullptr) return;
+    if(symbol->depth == 0 || symbol->depth == depth()) return;
+
+    if(!m_frameIndices.contains(symbol->variable)) {
+        const ProcedureDeclaration* owner = m_owners.at(symbol->variable);
+        m_frameIndices[symbol->variable] = ++m_capturedVariables[owner];
+        m_changed = true;
+    }
+
+    requireStaticLinks(symbol->depth);
+}
+
+auto CaptureAnalysis::requireStaticLinks(std::uint32_t depth) -> void {
+    for(std::uint32_t i = depth; i < m_procedures.size(); i++) {
+        m_changed |= m_needsStaticLink.insert(m_procedures[i]).second;
+    }
+}
+
+auto CaptureAnalysis::visit(VariableDeclarations* decl) -> void {
+
+    ScopedAnalysis::visit(decl);
+
+    if(depth() == 0) return;
+
+    for(const auto& [ident, _] : decl->declarations) {
+        m_owners[&ident] = m_procedures.back();
+    }
+}
+
+auto CaptureAnalysis::visit(AssignStatement* stmt) -> void {
+    reference(stmt->lvalue);
+    ScopedAnalysis::visit(stmt);
+}
+
+auto CaptureAnalysis::visit(CallStatement* stmt) -> void {
+
+    const Symbol* symbol = lookup(stmt->callee.lexeme);
+
+    if(symbol == nullptr || symbol->kind != Symbol::Kind::Procedure) return;
+
+    // The caller must hand over the frame of the procedure that declares
+    // the callee.
+    if(needsStaticLink(symbol->procedure) && symbol->depth < depth()) {
+        requireStaticLinks(symbol->depth);
+    }
+}
+
+auto CaptureAnalysis::visit(InputStatement* stmt) -> void {
+    reference(stmt->destination);
+    ScopedAnalysis::visit(stmt);
+}
+
+auto CaptureAnalysis::visit(ForStatement* stmt) -> void {
+    reference(stmt->variable);
+    ScopedAnalysis::visit(stmt);
+}
+
+auto CaptureAnalysis::visit(VariableExpression* expr) -> void {
+    reference(expr->name);
+}
+
+auto CaptureAnalysis::visit(IndexExpression* expr) -> void {
+    reference(expr->name);
+    ScopedAnalysis::visit(expr);
+}
+
+// EffectAnalysis
+
+auto EffectAnalysis::analyze(StatementPtr& program) -> void {
+    resetScopes();
+    analyzeStatement(program);
+    propagate();
+}
+
+auto EffectAnalysis::reads(const ProcedureDeclaration* procedure) const -> const VariableSet& {
+    static const VariableSet none;
+
+    const auto entry = m_effects.find(procedure);
+    return entry != m_effects.end() ? entry->second.reads : none;
+}
+
+auto EffectAnalysis::writes(const ProcedureDeclaration* procedure) const -> const VariableSet& {
+    static const VariableSet none;
+
+    const auto entry = m_effects.find(procedure);
+    return entry != m_effects.end() ? entry->second.writes : none;
+}
+
+auto EffectAnalysis::conflicts(const ParallelStatement* stmt) const -> std::vector<Conflict> {
+
+    std::vector<Conflict> conflicts;
+
+    const auto entry = m_parallelCallees.find(stmt);
+    if(entry == m_parallelCallees.end()) return conflicts;
+
+    const auto& callees = entry->second;
+
+    for(std::size_t i = 0; i < callees.size(); i++) {
+        for(std::size_t j = i + 1; j < callees.size(); j++) {
+
+            if(callees[i] == nullptr || callees[j] == nullptr) continue;
+
+            const VariableSet& other = writes(callees[j]);
+
+            for(const Token* variable : writes(callees[i])) {
+                if(!other.contains(variable) || m_shared.contains(variable)) continue;
+
+                const auto* first = static_cast<const CallStatement*>(stmt->calls[i].get());
+                const auto* second = static_cast<const CallStatement*>(stmt->calls[j].get());
+
+                conflicts.push_back({&first->callee, &second->callee, variable});
+            }
+        }
+    }
+
+    return conflicts;
+}
+
+auto EffectAnalysis::concurrentCalls(const BeginStatement* stmt) const -> std::vector<std::pair<std::size_t, std::size_t>> {
+
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+
+    const auto entry = m_beginCallees.find(stmt);
+    if(entry == m_beginCallees.end()) return runs;
+
+    const auto& callees = entry->second;
+
+    const auto effects = [this](const ProcedureDeclaration* procedure) -> const Effects* {
+        const auto entry = m_effects.find(procedure);
+        return entry != m_effects.end() ? &entry->second : nullptr;
+    };
+
+    for(std::size_t first = 0; first < callees.size();) {
+
+        if(callees[first] == nullptr) {
+            first++;
+            continue;
+        }
+
+        std::size_t last = first + 1;
+
+        for(; last < callees.size() && callees[last] != nullptr; last++) {
+            const Effects* callee = effects(callees[last]);
+            if(callee != nullptr && callee->isObservable) break;
+
+            bool isIndependent = true;
+
+            for(std::size_t i = first; i < last && isIndependent; i++) {
+                isIndependent = this->isIndependent(callees[last], callees[i]);
+            }
+
+            if(!isIndependent) break;
+        }
+
+        const auto loops = std::count_if(callees.begin() + first, callees.begin() + last, [&](const auto* procedure) {
+            const Effects* callee = effects(procedure);
+            return callee != nullptr && callee->hasLoops;
+        });
+
+        if(last - first < 2 || loops < 2) {
+            first++;
+            continue;
+        }
+
+        runs.emplace_back(first, last);
+        first = last;
+    }
+
+    return runs;
+}
+
+auto EffectAnalysis::isIndependent(const ProcedureDeclaration* callee, const ProcedureDeclaration* other) const -> bool {
+
+    const VariableSet& otherReads = reads(other);
+    const VariableSet& otherWrites = writes(other);
+
+    for(const Token* variable : writes(callee)) {
+        if(otherReads.contains(variable) || otherWrites.contains(variable)) return false;
+    }
+
+    for(const Token* variable : reads(callee)) {
+        if(otherWrites.contains(variable)) return false;
+    }
+
+    return true;
+}
+
+auto EffectAnalysis::current() -> Effects* {
+    return depth() > 0 ? &m_effects[m_procedures.back()] : nullptr;
+}
+
+auto EffectAnalysis::read(const Token& name) -> void {
+
+    const Symbol* symbol = lookupVariable(name);
+
+    if(symbol == nullptr || depth() == 0 || symbol->depth == depth()) return;
+
+    m_effects[m_procedures.back()].reads.insert(symbol->variable);
+}
+
+auto EffectAnalysis::write(const Token& name) -> void {
+
+    const Symbol* symbol = lookupVariable(name);
+
+    // Writes to the own locals aren't visible to the callers.
+    if(symbol == nullptr || depth() == 0 || symbol->depth == depth()) return;
+
+    m_effects[m_procedures.back()].writes.insert(symbol->variable);
+}
+
+auto EffectAnalysis::propagate() -> void {
+
+    bool changed;
+
+    // The callee's accesses to the caller's locals stay in the caller.
+    const auto isVisible = [this](const Token* variable, const ProcedureDeclaration* caller) {
+        const auto owner = m_owners.find(variable);
+        return owner == m_owners.end() || owner->second != caller;
+    };
+
+    do {
+        changed = false;
+
+        for(auto& [procedure, effects] : m_effects) {
+            for(const ProcedureDeclaration* callee : effects.callees) {
+
+                if(callee == procedure) {
+                    changed |= !effects.hasLoops;
+                    effects.hasLoops = true;
+                    continue;
+                }
+
+                for(const Token* variable : writes(callee)) {
+                    if(isVisible(variable, procedure)) changed |= effects.writes.insert(variable).second;
+                }
+
+                for(const Token* variable : reads(callee)) {
+                    if(isVisible(variable, procedure)) changed |= effects.reads.insert(variable).second;
+                }
+
+                const auto entry = m_effects.find(callee);
+                if(entry == m_effects.end()) continue;
+
+                if(entry->second.isObservable && !effects.isObservable) {
+                    effects.isObservable = changed = true;
+                }
+
+                if(entry->second.hasLoops && !effects.hasLoops) {
+                    effects.hasLoops = changed = true;
+                }
+            }
+        }
+    } while(changed);
+}
+
+auto EffectAnalysis::visit(VariableDeclarations* decl) -> void {
+
+    ScopedAnalysis::visit(decl);
+
+    for(const auto& [ident, _] : decl->declarations) {
+        if(decl->isShared) m_shared.insert(&ident);
+        if(depth() > 0) m_owners[&ident] = m_procedures.back();
+    }
+}
+
+auto EffectAnalysis::visit(AssignStatement* stmt) -> void {
+    write(stmt->lvalue);
+
+    // The index is checked against the length.
+    if(Effects* effects = current(); effects != nullptr && stmt->index != nullptr) {
+        effects->isObservable = true;
+    }
+
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(CallStatement* stmt) -> void {
+
+    ProcedureDeclaration* callee = lookupProcedure(stmt->callee);
+    m_lastCall = stmt;
+
+    if(callee == nullptr || depth() == 0) return;
+
+    m_effects[m_procedures.back()].callees.insert(callee);
+}
+
+auto EffectAnalysis::visit(InputStatement* stmt) -> void {
+    write(stmt->destination);
+    if(Effects* effects = current()) effects->isObservable = true;
+
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(PrintStatement* stmt) -> void {
+    if(Effects* effects = current()) effects->isObservable = true;
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(BeginStatement* stmt) -> void {
+
+    if(!m_findConcurrentCalls) return ScopedAnalysis::visit(stmt);
+
+    std::vector<const ProcedureDeclaration*> callees(stmt->statements.size(), nullptr);
+    bool hasConsecutiveCalls = false;
+
+    for(std::size_t i = 0; i < stmt->statements.size(); i++) {
+        m_lastCall = nullptr;
+        analyzeStatement(stmt->statements[i]);
+
+        if(m_lastCall == nullptr || m_lastCall != stmt->statements[i].get()) continue;
+
+        const ProcedureDeclaration* callee = lookupProcedure(m_lastCall->callee);
+
+        // A recursive call stays in order, it may be a jump.
+        if(std::find(m_procedures.begin(), m_procedures.end(), callee) != m_procedures.end()) continue;
+
+        callees[i] = callee;
+        hasConsecutiveCalls |= i > 0 && callees[i - 1] != nullptr && callee != nullptr;
+    }
+
+    if(hasConsecutiveCalls) m_beginCallees[stmt] = std::move(callees);
+}
+
+auto EffectAnalysis::visit(WhileStatement* stmt) -> void {
+    if(Effects* effects = current()) effects->hasLoops = true;
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(ForStatement* stmt) -> void {
+    write(stmt->variable);
+    if(Effects* effects = current()) effects->hasLoops = true;
+
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(ParallelStatement* stmt) -> void {
+
+    auto& callees = m_parallelCallees[stmt];
+
+    for(auto& call : stmt->calls) {
+        const auto* callStatement = static_cast<const CallStatement*>(call.get());
+        callees.push_back(lookupProcedure(callStatement->callee));
+    }
+
+    ScopedAnalysis::visit(stmt);
+}
+
+auto EffectAnalysis::visit(BinaryExpression* expr) -> void {
+
+    // Dividing by 0 stops the program.
+    if(Effects* effects = current(); effects != nullptr && expr->op.type == token::TokenType::Slash) {
+        effects->isObservable = true;
+    }
+
+    ScopedAnalysis::visit(expr);
+}
+
+auto EffectAnalysis::visit(VariableExpression* expr) -> void {
+    read(expr->name);
+}
+
+auto EffectAnalysis::visit(IndexExpression* expr) -> void {
+    read(expr->name);
+    if(Effects* effects = current()) effects->isObservable = true;
+
+    ScopedAnalysis::visit(expr);
+}
+
+// CallGraphAnalysis
+
+auto CallGraphAnalysis::analyze(StatementPtr& program) -> void {
+
+    resetScopes();
+    analyzeStatement(program);
+
+    std::vector<const ProcedureDeclaration*> worklist = {nullptr};
+
+    while(!worklist.empty()) {
+        const ProcedureDeclaration* caller = worklist.back();
+        worklist.pop_back();
+
+        for(const ProcedureDeclaration* callee : m_callees[caller]) {
+            if(m_reachable.insert(callee).second) worklist.push_back(callee);
+        }
+    }
+}
+
+auto CallGraphAnalysis::visit(CallStatement* stmt) -> void {
+
+    const ProcedureDeclaration* callee = lookupProcedure(stmt->callee);
+    if(callee == nullptr) return;
+
+    m_callees[depth() > 0 ? m_procedures.back() : nullptr].insert(callee);
+}
+
+}
@@ -0,0 +1,289 @@
+#ifndef _ANALYSIS_HPP_
+#define _ANALYSIS_HPP_
+
+#include "ast.hpp"
+#include "os.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace pl0::analysis {
+
+using namespace ast;
+
+// Variables are identified by the token declaring them.
+using VariableSet = std::unordered_set<const Token*>;
+
+// Walks the program resolving the names like the code generator does. The
+// analyses override the visits they are interested in and call these ones
+// to keep walking the tree.
+class ScopedAnalysis : public AstVisitor {
+protected:
+
+    struct Symbol {
+        enum class Kind : std::uint8_t { Constant, Variable, Procedure };
+
+        Kind kind;
+        std::uint32_t depth;
+        const Token* variable = nullptr;
+        ProcedureDeclaration* procedure = nullptr;
+    };
+
+    auto visit(Block* block) -> void;
+    auto visit(ConstDeclarations* decl) -> void;
+    auto visit(VariableDeclarations* decl) -> void;
+    auto visit(ProcedureDeclaration* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(PrintStatement* stmt) -> void;
+    auto visit(BeginStatement* stmt) -> void;
+    auto visit(IfStatement* stmt) -> void;
+    auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
+
+    auto visit(OddExpression* expr) -> void;
+    auto visit(BinaryExpression* expr) -> void;
+    auto visit(UnaryExpression* expr) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+    auto visit(LiteralExpression* expr) -> void;
+
+    inline auto analyzeStatement(StatementPtr& stmt) -> void {
+        if(stmt != nullptr) os::withStack([&] { stmt->accept(this); });
+    }
+
+    inline auto analyzeExpression(ExpressionPtr& expr) -> void {
+        if(expr != nullptr) os::withStack([&] { expr->accept(this); });
+    }
+
+    inline auto depth() const -> std::uint32_t {
+        return static_cast<std::uint32_t>(m_procedures.size());
+    }
+
+    inline auto resetScopes() -> void {
+        m_scopes.clear();
+        m_procedures.clear();
+    }
+
+    auto lookup(std::string_view name) const -> const Symbol*;
+
+    // The variable named `name`, nullptr if it's not a variable.
+    auto lookupVariable(const Token& name) const -> const Symbol*;
+
+    // The procedure named `name`, nullptr if it's not a procedure.
+    auto lookupProcedure(const Token& name) const -> ProcedureDeclaration*;
+
+protected:
+    std::vector<std::unordered_map<std::string_view, Symbol>> m_scopes;
+    std::vector<ProcedureDeclaration*> m_procedures;
+};
+
+/*
+
+Finds the local variables referenced by nested procedures. A captured
+variable lives in the activation frame of the procedure that declares it:
+
+    frame = { static link, captured variables... }
+
+The static link is the frame of the enclosing procedure, it's passed as
+argument to the procedures that reach variables of their ancestors, either
+directly or because they call or contain procedures that do.
+
+Globals are never captured, the variables that are not captured stay plain
+allocas and can be promoted to registers.
+
+*/
+class CaptureAnalysis final : public ScopedAnalysis {
+public:
+    CaptureAnalysis() = default;
+
+    auto analyze(StatementPtr& program) -> void;
+
+    [[nodiscard]]
+    inline auto needsStaticLink(const ProcedureDeclaration* procedure) const -> bool {
+        return m_needsStaticLink.contains(procedure);
+    }
+
+    [[nodiscard]]
+    auto needsFrame(const ProcedureDeclaration* procedure) const -> bool;
+
+    // Field of the variable in the frame of its procedure, 0 if it isn't captured.
+    [[nodiscard]]
+    auto frameIndex(const Token* variable) const -> std::uint32_t;
+
+    [[nodiscard]]
+    auto capturedVariables(const ProcedureDeclaration* procedure) const -> std::uint32_t;
+
+private:
+
+    using ScopedAnalysis::visit;
+
+    auto visit(VariableDeclarations* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+
+    auto reference(const Token& name) -> void;
+
+    // The procedures between `depth` (excluded) and the current one need
+    // the static link to reach the frame at `depth`.
+    auto requireStaticLinks(std::uint32_t depth) -> void;
+
+private:
+    std::unordered_map<const Token*, const ProcedureDeclaration*> m_owners;
+    std::unordered_map<const Token*, std::uint32_t> m_frameIndices;
+    std::unordered_map<const ProcedureDeclaration*, std::uint32_t> m_capturedVariables;
+    std::unordered_set<const ProcedureDeclaration*> m_needsStaticLink;
+
+    bool m_changed = false;
+};
+
+/*
+
+Collects the variables each procedure reads and writes, directly or through
+the procedures it calls. Only the accesses visible outside the procedure
+are kept: globals and locals of the enclosing procedures.
+
+The writes are used to find the branches of a parallel block that race on
+the same variable, writes to shared variables are atomic and never race.
+
+With -auto-parallel the effects also find the consecutive calls of a
+begin...end that can run concurrently without changing the output: none
+writes what another one reads or writes, and only the first one can be
+observed, i.e. do I/O or stop the program with a runtime error. The other
+ones may never return, the output stays the same. At least two of them
+must loop, or the threads cost more than they save.
+
+*/
+class EffectAnalysis final : public ScopedAnalysis {
+public:
+    EffectAnalysis() = default;
+
+    // Two calls of a parallel block writing the same variable.
+    struct Conflict {
+        const Token* first;
+        const Token* second;
+        const Token* variable;
+    };
+
+    auto analyze(StatementPtr& program) -> void;
+
+    inline auto setFindConcurrentCalls(bool find) -> void {
+        m_findConcurrentCalls = find;
+    }
+
+    [[nodiscard]]
+    auto reads(const ProcedureDeclaration* procedure) const -> const VariableSet&;
+
+    [[nodiscard]]
+    auto writes(const ProcedureDeclaration* procedure) const -> const VariableSet&;
+
+    // The runs of calls of `stmt` to run concurrently, as ranges [first,
+    // last) of its statements.
+    [[nodiscard]]
+    auto concurrentCalls(const BeginStatement* stmt) const -> std::vector<std::pair<std::size_t, std::size_t>>;
+
+    [[nodiscard]]
+    auto conflicts(const ParallelStatement* stmt) const -> std::vector<Conflict>;
+
+private:
+
+    struct Effects {
+        VariableSet reads;
+        VariableSet writes;
+        std::unordered_set<const ProcedureDeclaration*> callees;
+
+        // Prints, reads the input or can fail at run time.
+        bool isObservable = false;
+        bool hasLoops = false;
+    };
+
+    using ScopedAnalysis::visit;
+
+    auto visit(VariableDeclarations* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(PrintStatement* stmt) -> void;
+    auto visit(BeginStatement* stmt) -> void;
+    auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
+
+    auto visit(BinaryExpression* expr) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+
+    auto read(const Token& name) -> void;
+    auto write(const Token& name) -> void;
+
+    // Effects of the procedure being visited, nullptr in the main block.
+    auto current() -> Effects*;
+
+    // True if `callee` can run while `other` runs, neither accessing what
+    // the other one writes.
+    auto isIndependent(const ProcedureDeclaration* callee, const ProcedureDeclaration* other) const -> bool;
+
+    // Adds the writes of the callees to their callers, until nothing changes.
+    auto propagate() -> void;
+
+private:
+    std::unordered_map<const ProcedureDeclaration*, Effects> m_effects;
+    std::unordered_map<const Token*, const ProcedureDeclaration*> m_owners;
+    std::unordered_map<const ParallelStatement*, std::vector<const ProcedureDeclaration*>> m_parallelCallees;
+
+    VariableSet m_shared;
+
+    bool m_findConcurrentCalls = false;
+
+    // The callee of every statement of the begin...end blocks with
+    // consecutive calls, nullptr for the other statements.
+    std::unordered_map<const BeginStatement*, std::vector<const ProcedureDeclaration*>> m_beginCallees;
+    const CallStatement* m_lastCall = nullptr;
+};
+
+/*
+
+Call graph of the program. A procedure is reachable when the statement of
+the main block calls it, directly or through reachable procedures; the
+other ones never run.
+
+*/
+class CallGraphAnalysis final : public ScopedAnalysis {
+public:
+    CallGraphAnalysis() = default;
+
+    auto analyze(StatementPtr& program) -> void;
+
+    [[nodiscard]]
+    inline auto isReachable(const ProcedureDeclaration* procedure) const -> bool {
+        return m_reachable.contains(procedure);
+    }
+
+private:
+
+    using ScopedAnalysis::visit;
+
+    auto visit(CallStatement* stmt) -> void;
+
+private:
+    // The callees of the main block are under nullptr.
+    std::unordered_map<const ProcedureDeclaration*, std::unordered_set<const ProcedureDeclaration*>> m_callees;
+    std::unordered_set<const ProcedureDeclaration*> m_reachable;
+};
+
+}
+
+#endif
@@ -1,69 +1,92 @@
 #include "ast.hpp"
 
-#include <iostream>
+#include <charconv>
+
+auto std::default_delete<pl0::ast::Statement>::operator()(pl0::ast::Statement* node) const -> void {
+    pl0::os::withStack([node] { delete node; });
+}
+
+auto std::default_delete<pl0::ast::Expression>::operator()(pl0::ast::Expression* node) const -> void {
+    pl0::os::withStack([node] { delete node; });
+}
 
 namespace pl0::ast {
 
-auto AstPrinter::print(StatementPtr& ast) -> void {
-    ast->accept(this);
-    std::cout << "\n\n";
+auto DumpBuffer::writeNumber(std::int64_t value) -> void {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+
+    write(std::string_view(digits, result.ptr - digits));
 }
 
-auto AstPrinter::newline() const -> void {
+auto DumpBuffer::flush() -> void {
+    std::fwrite(m_data.data(), 1, m_data.size(), m_stream);
+    m_data.clear();
+}
 
-    std::cout << '\n';
-    for(int i = 0; i < m_level * TAB_SIZE; i++){
-        std::cout << ' ';
-    }
+auto AstPrinter::print(StatementPtr& ast) -> void {
+    ast->accept(this);
+    write("\n\n");
+    m_output.flush();
 }
 
 auto AstPrinter::visit(Block* block) -> void {
 
-    std::cout << "Block:";
+    write("Block:");
     
     indent();
     
     if(block->constantsDeclaration != nullptr) {
         newline();
-        std::cout << "Constants:";
+        write("Constants:");
         indent();
         newline();
 
-        block->constantsDeclaration->accept(this);
+        printNode(block->constantsDeclaration);
         dedent();
 
     }
 
     if(block->variablesDeclaration != nullptr) {
         newline();
-        std::cout << "Variables:";
+        write("Variables:");
         indent();
         newline();
 
-        block->variablesDeclaration->accept(this);
+        printNode(block->variablesDeclaration);
         dedent();
 
     }
 
+    if(block->sharedDeclaration != nullptr) {
+        newline();
+        write("Shared:");
+        indent();
+        newline();
+
+        printNode(block->sharedDeclaration);
+        dedent();
+    }
+
     if(!block->procedureDeclarations.empty()) {
         newline();
-        std::cout << "Procedures:";
+        write("Procedures:");
         indent();
 
         for(const auto& proc : block->procedureDeclarations) {
             newline();
-            proc->accept(this);
+            printNode(proc);
         }
 
         dedent();
     }
 
     newline();
-    std::cout << "Statement:";
+    write("Statement:");
     
     indent();
     newline();
-    block->statement->accept(this);
+    printNode(block->statement);
     dedent();
 
     dedent();
@@ -71,13 +94,13 @@ auto AstPrinter::visit(Block* block) -> void {
 
 auto AstPrinter::visit(ConstDeclarations* decl) -> void {
 
-    std::cout << "ConstDeclarations:";
+    write("ConstDeclarations:");
     
     indent();
 
     for(const auto& [name, value] : decl->declarations) {
         newline();
-        std::cout << name.lexeme << " = " << value;
+        write(name.lexeme, " = ", value);
     }
 
     dedent();
@@ -85,101 +108,126 @@ auto AstPrinter::visit(ConstDeclarations* decl) -> void {
 
 auto AstPrinter::visit(VariableDeclarations* decl) -> void {
 
-    std::cout << "VariableDeclarations: ";
+    write("VariableDeclarations: ");
     
-    for(const auto& ident : decl->identifiers){
-        std::cout << ident.lexeme << ' ';
+    for(const auto& [ident, length] : decl->declarations){
+        write(ident.lexeme);
+        if(length.has_value()) write('[', length->lexeme, ']');
+        write(' ');
     }
 }
 
 auto AstPrinter::visit(ProcedureDeclaration* decl) -> void {
-    std::cout << "ProcedureDeclaration:";
+    write("ProcedureDeclaration:");
     indent();
     newline();
 
-    std::cout << "Name: " << decl->name.lexeme;
+    write("Name: ", decl->name.lexeme);
     
     newline();
 
-    std::cout << "Body:";
+    write("Body:");
     indent();
     newline();
     
-    decl->block->accept(this);
+    printNode(decl->block);
     dedent();
 
     dedent();
 }
 
 auto AstPrinter::visit(AssignStatement* stmt) -> void {
-    std::cout << "AssignStatement: ";
+    write("AssignStatement: ");
     
     indent();
     newline();
-    std::cout << "LValue: " << stmt->lvalue.lexeme;
+    write("LValue: ", stmt->lvalue.lexeme);
+
+    if(stmt->index != nullptr) {
+        newline();
+        write("Index: ");
+
+        indent();
+        newline();
+        printNode(stmt->index);
+        dedent();
+    }
     
     newline();
-    std::cout << "RValue: ";
+    write("RValue: ");
 
     indent();
     newline();
-    stmt->rvalue->accept(this);
+    printNode(stmt->rvalue);
     dedent();
 
     dedent();
 }
 
 auto AstPrinter::visit(CallStatement* stmt) -> void {
-    std::cout << "CallStatement: " << stmt->callee.lexeme;
+    write("CallStatement: ", stmt->callee.lexeme);
 }
 
 auto AstPrinter::visit(InputStatement* stmt) -> void {
-    std::cout << "InputStatement: " << stmt->destination.lexeme;
+    write("InputStatement: ", stmt->destination.lexeme);
+
+    if(stmt->index != nullptr) {
+        indent();
+        newline();
+        write("Index: ");
+
+        indent();
+        newline();
+        printNode(stmt->index);
+        dedent();
+
+        dedent();
+    }
 }
 
 auto AstPrinter::visit(PrintStatement* stmt) -> void {
-    std::cout << "PrintStatement:";
+    write("PrintStatement:");
 
     indent();
     newline();
 
-    stmt->argument->accept(this);
+    printNode(stmt->argument);
 
     dedent();
 }
 
 auto AstPrinter::visit(BeginStatement* stmt) -> void {
-    std::cout << "BeginStatement:";
+    write("BeginStatement:");
     
     indent();
 
     for(const auto& statement : stmt->statements) {
         newline();
-        statement->accept(this);
+        printNode(statement);
     }
 
     dedent();
 }
 
 auto AstPrinter::visit(IfStatement* stmt) -> void {
-    std::cout << "IfStatement:";
+    write("IfStatement:");
     
     indent();
     newline();
 
-    std::cout << "Condition:";
+    write("Condition:");
 
     indent();
     newline();
-    stmt->condition->accept(this);
+    printNode(stmt->condition);
     dedent();
 
     newline();
-    std::cout << "Body: ";
+    write("Body: ");
     indent();
     newline();
 
-    stmt->body->accept(this);
+    printNode(stmt->body);
     dedent();
 
     dedent();
@@ -188,87 +236,364 @@ auto AstPrinter::visit(IfStatement* stmt) -> void {
 
 auto AstPrinter::visit(WhileStatement* stmt) -> void {
 
-    std::cout << "WhileStatement:";
+    write("WhileStatement:");
     
     indent();
     newline();
 
-    std::cout << "Condition:";
+    write("Condition:");
 
     indent();
     newline();
-    stmt->condition->accept(this);
+    printNode(stmt->condition);
     dedent();
 
     newline();
-    std::cout << "Body: ";
+    write("Body: ");
     indent();
     newline();
 
-    stmt->body->accept(this);
+    printNode(stmt->body);
     dedent();
 
     dedent();
 }
     
+auto AstPrinter::visit(ForStatement* stmt) -> void {
+
+    write("ForStatement: ", stmt->variable.lexeme);
+    
+    indent();
+    newline();
+
+    write("From:");
+
+    indent();
+    newline();
+    printNode(stmt->from);
+    dedent();
+
+    newline();
+    write("To:");
+
+    indent();
+    newline();
+    printNode(stmt->to);
+    dedent();
+
+    if(stmt->step != nullptr) {
+        newline();
+        write("Step:");
+
+        indent();
+        newline();
+        printNode(stmt->step);
+        dedent();
+    }
+
+    newline();
+    write("Body: ");
+    indent();
+    newline();
+
+    printNode(stmt->body);
+    dedent();
+
+    dedent();
+}
+    
+auto AstPrinter::visit(ParallelStatement* stmt) -> void {
+    write("ParallelStatement:");
+    
+    indent();
+
+    for(const auto& call : stmt->calls) {
+        newline();
+        printNode(call);
+    }
+
+    dedent();
+}
+
 auto AstPrinter::visit(OddExpression* expr) -> void {    
     
-    std::cout << "OddExpression:";
+    write("OddExpression:");
     
     indent();
     newline();
 
-    expr->expr->accept(this);
+    printNode(expr->expr);
     dedent();
 }
 
 auto AstPrinter::visit(BinaryExpression* expr) -> void {
-    std::cout << "BinaryExpression:";
+    write("BinaryExpression:");
     indent();
     newline();
     
-    std::cout << "Operator: " << expr->op.lexeme;
+    write("Operator: ", expr->op.lexeme);
     newline();
 
-    std::cout << "Left:";
+    write("Left:");
     indent();
     newline();
-    expr->left->accept(this);
+    printNode(expr->left);
     dedent();
 
     newline();
-    std::cout << "Right:";
+    write("Right:");
     indent();
     newline();
-    expr->right->accept(this);
+    printNode(expr->right);
     dedent();
 
     dedent();
 }
 
 auto AstPrinter::visit(UnaryExpression* expr) -> void {
-    std::cout << "UnaryExpression:";
+    write("UnaryExpression:");
     indent();
     newline();
     
-    std::cout << "Operator: " << expr->op.lexeme;
+    write("Operator: ", expr->op.lexeme);
     newline();
 
-    std::cout << "Right:";
+    write("Right:");
     indent();
     newline();
-    expr->right->accept(this);
+    printNode(expr->right);
     dedent();
 
     dedent();
 }
 
 auto AstPrinter::visit(VariableExpression* expr) -> void {
-    std::cout << "VariableExpression: " << expr->name.lexeme;
+    write("VariableExpression: ", expr->name.lexeme);
+}
+
+auto AstPrinter::visit(IndexExpression* expr) -> void {
+    write("IndexExpression: ", expr->name.lexeme);
+
+    indent();
+    newline();
+    printNode(expr->index);
+    dedent();
 }
 
 auto AstPrinter::visit(LiteralExpression* expr) -> void {
-    std::cout << "LiteralExpression: " << expr->value;
+    write("LiteralExpression: ", expr->value);
+}
+
+auto AstJsonPrinter::print(StatementPtr& ast) -> void {
+    printNode(ast);
+    write('\n');
+    m_output.flush();
+}
+
+template<typename Node>
+auto AstJsonPrinter::printNodes(const std::vector<Node>& nodes) -> void {
+    write('[');
+
+    for(std::size_t i = 0; i < nodes.size(); i++) {
+        if(i > 0) write(',');
+        printNode(nodes[i]);
+    }
+
+    write(']');
+}
+
+auto AstJsonPrinter::printToken(std::string_view field, const Token& token) -> void {
+    write("\"", field, "\":\"", token.lexeme, "\",\"line\":", token.line);
+}
+
+auto AstJsonPrinter::visit(Block* block) -> void {
+    write("{\"kind\":\"Block\",\"constants\":");
+    printNode(block->constantsDeclaration);
+
+    write(",\"variables\":");
+    printNode(block->variablesDeclaration);
+
+    write(",\"shared\":");
+    printNode(block->sharedDeclaration);
+
+    write(",\"procedures\":");
+    printNodes(block->procedureDeclarations);
+
+    write(",\"statement\":");
+    printNode(block->statement);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(ConstDeclarations* decl) -> void {
+    write("{\"kind\":\"ConstDeclarations\",\"declarations\":[");
+
+    for(std::size_t i = 0; i < decl->declarations.size(); i++) {
+        const auto& [name, value] = decl->declarations[i];
+
+        write(i > 0 ? ",{" : "{");
+        printToken("name", name);
+        write(",\"value\":", value, '}');
+    }
+
+    write("]}");
+}
+
+auto AstJsonPrinter::visit(VariableDeclarations* decl) -> void {
+    write("{\"kind\":\"VariableDeclarations\",\"shared\":", decl->isShared ? "true" : "false", ",\"declarations\":[");
+
+    for(std::size_t i = 0; i < decl->declarations.size(); i++) {
+        const auto& [ident, length] = decl->declarations[i];
+
+        write(i > 0 ? ",{" : "{");
+        printToken("name", ident);
+        write(",\"length\":");
+
+        if(length.has_value()) {
+            write(length->lexeme);
+        } else {
+            write("null");
+        }
+
+        write('}');
+    }
+
+    write("]}");
+}
+
+auto AstJsonPrinter::visit(ProcedureDeclaration* decl) -> void {
+    write("{\"kind\":\"ProcedureDeclaration\",");
+    printToken("name", decl->name);
+
+    write(",\"block\":");
+    printNode(decl->block);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(AssignStatement* stmt) -> void {
+    write("{\"kind\":\"AssignStatement\",");
+    printToken("lvalue", stmt->lvalue);
+
+    write(",\"index\":");
+    printNode(stmt->index);
+
+    write(",\"rvalue\":");
+    printNode(stmt->rvalue);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(CallStatement* stmt) -> void {
+    write("{\"kind\":\"CallStatement\",");
+    printToken("callee", stmt->callee);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(InputStatement* stmt) -> void {
+    write("{\"kind\":\"InputStatement\",");
+    printToken("destination", stmt->destination);
+
+    write(",\"index\":");
+    printNode(stmt->index);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(PrintStatement* stmt) -> void {
+    write("{\"kind\":\"PrintStatement\",\"argument\":");
+    printNode(stmt->argument);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(BeginStatement* stmt) -> void {
+    write("{\"kind\":\"BeginStatement\",\"statements\":");
+    printNodes(stmt->statements);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(IfStatement* stmt) -> void {
+    write("{\"kind\":\"IfStatement\",\"condition\":");
+    printNode(stmt->condition);
+
+    write(",\"body\":");
+    printNode(stmt->body);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(WhileStatement* stmt) -> void {
+    write("{\"kind\":\"WhileStatement\",\"condition\":");
+    printNode(stmt->condition);
+
+    write(",\"body\":");
+    printNode(stmt->body);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(ForStatement* stmt) -> void {
+    write("{\"kind\":\"ForStatement\",");
+    printToken("variable", stmt->variable);
+
+    write(",\"from\":");
+    printNode(stmt->from);
+
+    write(",\"to\":");
+    printNode(stmt->to);
+
+    write(",\"step\":");
+    printNode(stmt->step);
+
+    write(",\"body\":");
+    printNode(stmt->body);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(ParallelStatement* stmt) -> void {
+    write("{\"kind\":\"ParallelStatement\",\"line\":", stmt->keyword.line, ",\"calls\":");
+    printNodes(stmt->calls);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(OddExpression* expr) -> void {
+    write("{\"kind\":\"OddExpression\",\"expr\":");
+    printNode(expr->expr);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(BinaryExpression* expr) -> void {
+    write("{\"kind\":\"BinaryExpression\",");
+    printToken("operator", expr->op);
+
+    write(",\"left\":");
+    printNode(expr->left);
+
+    write(",\"right\":");
+    printNode(expr->right);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(UnaryExpression* expr) -> void {
+    write("{\"kind\":\"UnaryExpression\",");
+    printToken("operator", expr->op);
+
+    write(",\"right\":");
+    printNode(expr->right);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(VariableExpression* expr) -> void {
+    write("{\"kind\":\"VariableExpression\",");
+    printToken("name", expr->name);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(IndexExpression* expr) -> void {
+    write("{\"kind\":\"IndexExpression\",");
+    printToken("name", expr->name);
+
+    write(",\"index\":");
+    printNode(expr->index);
+    write('}');
+}
+
+auto AstJsonPrinter::visit(LiteralExpression* expr) -> void {
+    write("{\"kind\":\"LiteralExpression\",\"value\":", expr->value, '}');
 }
 
 }
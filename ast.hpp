@@ -1,11 +1,44 @@
 #ifndef _AST_HPP_
 #define _AST_HPP_
 
+#include <cstdint>
+#include <cstdio>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "os.hpp"
 #include "token.hpp"
 
+namespace pl0::ast {
+    struct Statement;
+    struct Expression;
+}
+
+// The destructors of the nodes recurse once per level of nesting, the
+// nodes are freed on a new stack when needed.
+template<>
+struct std::default_delete<pl0::ast::Statement> {
+    constexpr default_delete() noexcept = default;
+
+    template<typename Node>
+    default_delete(const default_delete<Node>&) noexcept {}
+
+    auto operator()(pl0::ast::Statement* node) const -> void;
+};
+
+template<>
+struct std::default_delete<pl0::ast::Expression> {
+    constexpr default_delete() noexcept = default;
+
+    template<typename Node>
+    default_delete(const default_delete<Node>&) noexcept {}
+
+    auto operator()(pl0::ast::Expression* node) const -> void;
+};
+
 namespace pl0::ast {
 
 using token::Token;
@@ -24,11 +57,14 @@ struct PrintStatement;
 struct BeginStatement;
 struct IfStatement;
 struct WhileStatement;
+struct ForStatement;
+struct ParallelStatement;
 
 struct OddExpression;
 struct BinaryExpression;
 struct UnaryExpression;
 struct VariableExpression;
+struct IndexExpression;
 struct LiteralExpression;
 
 struct AstVisitor {
@@ -47,11 +83,14 @@ struct AstVisitor {
     virtual auto visit(BeginStatement* stmt) -> void = 0;
     virtual auto visit(IfStatement* stmt) -> void = 0;
     virtual auto visit(WhileStatement* stmt) -> void = 0;
+    virtual auto visit(ForStatement* stmt) -> void = 0;
+    virtual auto visit(ParallelStatement* stmt) -> void = 0;
     
     virtual auto visit(OddExpression* expr) -> void = 0;
     virtual auto visit(BinaryExpression* expr) -> void = 0;
     virtual auto visit(UnaryExpression* expr) -> void = 0;
     virtual auto visit(VariableExpression* expr) -> void = 0;
+    virtual auto visit(IndexExpression* expr) -> void = 0;
     virtual auto visit(LiteralExpression* expr) -> void = 0;
 };
 
@@ -104,10 +143,12 @@ struct Block final : public Statement {
 
     Block(StatementPtr& constantsDeclaration,
           StatementPtr& variablesDeclaration,
+          StatementPtr& sharedDeclaration,
           std::vector<StatementPtr>& procedureDeclarations,
           StatementPtr& statement) 
         : constantsDeclaration(std::move(constantsDeclaration)),
           variablesDeclaration(std::move(variablesDeclaration)),
+          sharedDeclaration(std::move(sharedDeclaration)),
           procedureDeclarations(std::move(procedureDeclarations)),
           statement(std::move(statement)) {}
           
@@ -118,6 +159,7 @@ struct Block final : public Statement {
 
     StatementPtr constantsDeclaration;
     StatementPtr variablesDeclaration;
+    StatementPtr sharedDeclaration;
     std::vector<StatementPtr> procedureDeclarations;
 
     StatementPtr statement;
@@ -140,15 +182,25 @@ struct ConstDeclarations final : public Statement {
     std::vector<ConstDeclaration> declarations;
 };
 
+struct VariableDeclaration {
+    Token identifier;
+
+    // Number or constant, only for arrays.
+    std::optional<Token> length;
+};
+
 struct VariableDeclarations final : public Statement {
-    VariableDeclarations(std::vector<Token>& identifiers)
-        : identifiers(std::move(identifiers)) {}
+    VariableDeclarations(std::vector<VariableDeclaration>& declarations, bool isShared = false)
+        : declarations(std::move(declarations)), isShared(isShared) {}
 
     auto accept(AstVisitor* visitor) -> void {
         visitor->visit(this);
     }
 
-    std::vector<Token> identifiers;
+    std::vector<VariableDeclaration> declarations;
+
+    // Shared variables are accessed atomically by parallel calls.
+    bool isShared;
 };
 
 struct ProcedureDeclaration final : public Statement {
@@ -166,14 +218,15 @@ struct ProcedureDeclaration final : public Statement {
 
 struct AssignStatement final : public Statement {
 
-    AssignStatement(Token lvalue, ExpressionPtr& rvalue)
-        : lvalue(lvalue), rvalue(std::move(rvalue)) {}
+    AssignStatement(Token lvalue, ExpressionPtr& index, ExpressionPtr& rvalue)
+        : lvalue(lvalue), index(std::move(index)), rvalue(std::move(rvalue)) {}
 
     auto accept(AstVisitor* visitor) -> void {
         visitor->visit(this);
     }
 
     Token lvalue;
+    ExpressionPtr index; // Only for array elements.
     ExpressionPtr rvalue;
 };
 
@@ -189,14 +242,15 @@ struct CallStatement final : public Statement {
 };
 
 struct InputStatement final : public Statement {
-    InputStatement(Token destination)
-        : destination(destination) {}
+    InputStatement(Token destination, ExpressionPtr& index)
+        : destination(destination), index(std::move(index)) {}
 
     auto accept(AstVisitor* visitor) -> void {
         visitor->visit(this);
     }
 
     Token destination;
+    ExpressionPtr index; // Only for array elements.
 };
 
 struct PrintStatement final : public Statement {
@@ -249,6 +303,43 @@ struct WhileStatement final : public Statement {
     StatementPtr body;
 };
 
+// for variable := from to to [step step] do body
+// The step is optional and must be a constant, the default is 1.
+struct ForStatement final : public Statement {
+
+    ForStatement(Token variable, ExpressionPtr& from, ExpressionPtr& to, ExpressionPtr& step, StatementPtr& body)
+        : variable(variable),
+          from(std::move(from)),
+          to(std::move(to)),
+          step(std::move(step)),
+          body(std::move(body)) {}
+
+    auto accept(AstVisitor* visitor) -> void {
+        visitor->visit(this);
+    }
+
+    Token variable;
+    ExpressionPtr from;
+    ExpressionPtr to;
+    ExpressionPtr step;
+    StatementPtr body;
+};
+
+// parallel begin call a; call b; ... end
+// The calls run concurrently and the statement ends when all of them return.
+struct ParallelStatement final : public Statement {
+
+    ParallelStatement(Token keyword, std::vector<StatementPtr>& calls)
+        : keyword(keyword), calls(std::move(calls)) {}
+
+    auto accept(AstVisitor* visitor) -> void {
+        visitor->visit(this);
+    }
+
+    Token keyword;
+    std::vector<StatementPtr> calls;
+};
+
 // Expressions
 
 struct OddExpression final : public Expression {
@@ -299,6 +390,18 @@ struct VariableExpression final : public Expression {
     Token name;
 };
 
+struct IndexExpression final : public Expression {
+    IndexExpression(Token name, ExpressionPtr& index)
+        : name(name), index(std::move(index)) {}
+
+    auto accept(AstVisitor* visitor) -> void {
+        visitor->visit(this);
+    }
+
+    Token name;
+    ExpressionPtr index;
+};
+
 struct LiteralExpression final : public Expression {
     constexpr LiteralExpression(int value)
         : value(value) {}
@@ -312,9 +415,57 @@ struct LiteralExpression final : public Expression {
 
 // AST Printer
 
+// Output of the AST dumps. The text is gathered in a buffer and written to
+// the stream in chunks of CHUNK_SIZE bytes, the buffer is reused.
+class DumpBuffer final {
+public:
+    explicit DumpBuffer(std::FILE* stream)
+        : m_stream(stream) {
+        m_data.reserve(CHUNK_SIZE + CHUNK_SLACK);
+    }
+
+    inline auto write(std::string_view text) -> void {
+        m_data.append(text);
+        if(m_data.size() >= CHUNK_SIZE) flush();
+    }
+
+    inline auto write(char c) -> void {
+        m_data.push_back(c);
+        if(m_data.size() >= CHUNK_SIZE) flush();
+    }
+
+    inline auto write(int value) -> void {
+        writeNumber(value);
+    }
+
+    inline auto write(std::uint32_t value) -> void {
+        writeNumber(value);
+    }
+
+    inline auto spaces(std::size_t count) -> void {
+        m_data.append(count, ' ');
+        if(m_data.size() >= CHUNK_SIZE) flush();
+    }
+
+    auto flush() -> void;
+
+private:
+    auto writeNumber(std::int64_t value) -> void;
+
+private:
+    static constexpr std::size_t CHUNK_SIZE = 1 << 20;
+
+    // Room for the write that crosses CHUNK_SIZE, so it doesn't reallocate.
+    static constexpr std::size_t CHUNK_SLACK = 4096;
+
+    std::FILE* m_stream;
+    std::string m_data;
+};
+
 class AstPrinter : public AstVisitor {
 public:
-    AstPrinter() = default;
+    explicit AstPrinter(std::FILE* stream = stdout)
+        : m_output(stream) {}
 
     auto print(StatementPtr& ast) -> void;
 
@@ -331,11 +482,14 @@ private:
     auto visit(BeginStatement* stmt) -> void;
     auto visit(IfStatement* stmt) -> void;
     auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
     
     auto visit(OddExpression* expr) -> void;
     auto visit(BinaryExpression* expr) -> void;
     auto visit(UnaryExpression* expr) -> void;
     auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
     auto visit(LiteralExpression* expr) -> void;
 
     inline auto indent() -> void {
@@ -346,10 +500,86 @@ private:
         m_level--;
     }
 
-    auto newline() const -> void;
+    // On a new stack when needed, like the other walks of the AST.
+    template<typename Node>
+    inline auto printNode(const Node& node) -> void {
+        os::withStack([&] { node->accept(this); });
+    }
+
+    template<typename... Args>
+    inline auto write(const Args&... args) -> void {
+        (m_output.write(args), ...);
+    }
+
+    inline auto newline() -> void {
+        m_output.write('\n');
+        m_output.spaces(m_level * TAB_SIZE);
+    }
+
 private:
     static constexpr int TAB_SIZE = 2;
     int m_level = 0;
+
+    DumpBuffer m_output;
+};
+
+// Dump of the AST as a single JSON document, written while walking the
+// tree. Every node is an object with a "kind" and its fields, the missing
+// children are null. The names and the operators are written as they are,
+// the tokenizer accepts no character that needs an escape.
+class AstJsonPrinter : public AstVisitor {
+public:
+    explicit AstJsonPrinter(std::FILE* stream = stdout)
+        : m_output(stream) {}
+
+    auto print(StatementPtr& ast) -> void;
+
+private:
+    auto visit(Block* block) -> void;
+    auto visit(ConstDeclarations* decl) -> void;
+    auto visit(VariableDeclarations* decl) -> void;
+    auto visit(ProcedureDeclaration* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(PrintStatement* stmt) -> void;
+    auto visit(BeginStatement* stmt) -> void;
+    auto visit(IfStatement* stmt) -> void;
+    auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
+    
+    auto visit(OddExpression* expr) -> void;
+    auto visit(BinaryExpression* expr) -> void;
+    auto visit(UnaryExpression* expr) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+    auto visit(LiteralExpression* expr) -> void;
+
+    // On a new stack when needed, like the other walks of the AST.
+    template<typename Node>
+    inline auto printNode(const Node& node) -> void {
+        if(node == nullptr) {
+            m_output.write("null");
+        } else {
+            os::withStack([&] { node->accept(this); });
+        }
+    }
+
+    template<typename Node>
+    auto printNodes(const std::vector<Node>& nodes) -> void;
+
+    // "name": "<lexeme>", "line": <line>
+    auto printToken(std::string_view field, const Token& token) -> void;
+
+    template<typename... Args>
+    inline auto write(const Args&... args) -> void {
+        (m_output.write(args), ...);
+    }
+
+private:
+    DumpBuffer m_output;
 };
 
 }
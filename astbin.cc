@@ -0,0 +1,590 @@
+#include "astbin.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+namespace pl0::astbin {
+
+using token::TokenType;
+
+static constexpr char MAGIC[6] = {'P', 'L', '0', 'A', 'S', 'T'};
+static constexpr std::uint16_t VERSION = 1;
+
+// The operators the parser puts in each position.
+static constexpr std::initializer_list<TokenType> ARITHMETIC_OPERATORS = {
+    TokenType::Plus, TokenType::Minus, TokenType::Star, TokenType::Slash
+};
+
+static constexpr std::initializer_list<TokenType> RELATIONAL_OPERATORS = {
+    TokenType::Equal, TokenType::NotEqual, TokenType::Less,
+    TokenType::LessEqual, TokenType::Greater, TokenType::GreaterEqual
+};
+
+// Writer
+
+auto AstWriter::write(StatementPtr& ast) -> std::string {
+
+    m_nodes.clear();
+    m_names.clear();
+    m_nameIndices.clear();
+
+    writeStatement(ast);
+
+    std::string nodes = std::move(m_nodes);
+
+    m_nodes.assign(MAGIC, sizeof(MAGIC));
+    m_nodes.push_back(static_cast<char>(VERSION & 0xff));
+    m_nodes.push_back(static_cast<char>(VERSION >> 8));
+
+    writeUnsigned(m_names.size());
+
+    for(const std::string_view name : m_names) {
+        writeUnsigned(name.size());
+        m_nodes += name;
+    }
+
+    m_nodes += nodes;
+
+    return std::move(m_nodes);
+}
+
+auto AstWriter::writeUnsigned(std::uint64_t value) -> void {
+
+    while(value >= 0x80) {
+        m_nodes.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    m_nodes.push_back(static_cast<char>(value));
+}
+
+auto AstWriter::writeSigned(std::int64_t value) -> void {
+    writeUnsigned((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+auto AstWriter::writeToken(const Token& token) -> void {
+
+    const auto [entry, inserted] = m_nameIndices.try_emplace(token.lexeme, static_cast<std::uint32_t>(m_names.size()));
+    if(inserted) m_names.push_back(token.lexeme);
+
+    m_nodes.push_back(static_cast<char>(token.type));
+    writeUnsigned(token.line);
+    writeUnsigned(entry->second);
+}
+
+auto AstWriter::writeStatement(StatementPtr& stmt) -> void {
+    if(stmt == nullptr) {
+        writeKind(NodeKind::None);
+    } else {
+        os::withStack([&] { stmt->accept(this); });
+    }
+}
+
+auto AstWriter::writeExpression(ExpressionPtr& expr) -> void {
+    if(expr == nullptr) {
+        writeKind(NodeKind::None);
+    } else {
+        os::withStack([&] { expr->accept(this); });
+    }
+}
+
+auto AstWriter::visit(Block* block) -> void {
+    writeKind(NodeKind::Block);
+
+    writeStatement(block->constantsDeclaration);
+    writeStatement(block->variablesDeclaration);
+    writeStatement(block->sharedDeclaration);
+
+    writeUnsigned(block->procedureDeclarations.size());
+    for(auto& procedure : block->procedureDeclarations) {
+        writeStatement(procedure);
+    }
+
+    writeStatement(block->statement);
+}
+
+auto AstWriter::visit(ConstDeclarations* decl) -> void {
+    writeKind(NodeKind::ConstDeclarations);
+
+    writeUnsigned(decl->declarations.size());
+    for(const auto& [identifier, initializer] : decl->declarations) {
+        writeToken(identifier);
+        writeSigned(initializer);
+    }
+}
+
+auto AstWriter::visit(VariableDeclarations* decl) -> void {
+    writeKind(NodeKind::VariableDeclarations);
+
+    m_nodes.push_back(decl->isShared);
+
+    writeUnsigned(decl->declarations.size());
+    for(const auto& [identifier, length] : decl->declarations) {
+        writeToken(identifier);
+
+        m_nodes.push_back(length.has_value());
+        if(length.has_value()) writeToken(*length);
+    }
+}
+
+auto AstWriter::visit(ProcedureDeclaration* decl) -> void {
+    writeKind(NodeKind::ProcedureDeclaration);
+    writeToken(decl->name);
+    writeStatement(decl->block);
+}
+
+auto AstWriter::visit(AssignStatement* stmt) -> void {
+    writeKind(NodeKind::AssignStatement);
+    writeToken(stmt->lvalue);
+    writeExpression(stmt->index);
+    writeExpression(stmt->rvalue);
+}
+
+auto AstWriter::visit(CallStatement* stmt) -> void {
+    writeKind(NodeKind::CallStatement);
+    writeToken(stmt->callee);
+}
+
+auto AstWriter::visit(InputStatement* stmt) -> void {
+    writeKind(NodeKind::InputStatement);
+    writeToken(stmt->destination);
+    writeExpression(stmt->index);
+}
+
+auto AstWriter::visit(PrintStatement* stmt) -> void {
+    writeKind(NodeKind::PrintStatement);
+    writeExpression(stmt->argument);
+}
+
+auto AstWriter::visit(BeginStatement* stmt) -> void {
+    writeKind(NodeKind::BeginStatement);
+
+    writeUnsigned(stmt->statements.size());
+    for(auto& statement : stmt->statements) {
+        writeStatement(statement);
+    }
+}
+
+auto AstWriter::visit(IfStatement* stmt) -> void {
+    writeKind(NodeKind::IfStatement);
+    writeExpression(stmt->condition);
+    writeStatement(stmt->body);
+}
+
+auto AstWriter::visit(WhileStatement* stmt) -> void {
+    writeKind(NodeKind::WhileStatement);
+    writeExpression(stmt->condition);
+    writeStatement(stmt->body);
+}
+
+auto AstWriter::visit(ForStatement* stmt) -> void {
+    writeKind(NodeKind::ForStatement);
+    writeToken(stmt->variable);
+    writeExpression(stmt->from);
+    writeExpression(stmt->to);
+    writeExpression(stmt->step);
+    writeStatement(stmt->body);
+}
+
+auto AstWriter::visit(ParallelStatement* stmt) -> void {
+    writeKind(NodeKind::ParallelStatement);
+    writeToken(stmt->keyword);
+
+    writeUnsigned(stmt->calls.size());
+    for(auto& call : stmt->calls) {
+        writeStatement(call);
+    }
+}
+
+auto AstWriter::visit(OddExpression* expr) -> void {
+    writeKind(NodeKind::OddExpression);
+    writeExpression(expr->expr);
+}
+
+auto AstWriter::visit(BinaryExpression* expr) -> void {
+    writeKind(NodeKind::BinaryExpression);
+    writeExpression(expr->left);
+    writeToken(expr->op);
+    writeExpression(expr->right);
+}
+
+auto AstWriter::visit(UnaryExpression* expr) -> void {
+    writeKind(NodeKind::UnaryExpression);
+    writeToken(expr->op);
+    writeExpression(expr->right);
+}
+
+auto AstWriter::visit(VariableExpression* expr) -> void {
+    writeKind(NodeKind::VariableExpression);
+    writeToken(expr->name);
+}
+
+auto AstWriter::visit(IndexExpression* expr) -> void {
+    writeKind(NodeKind::IndexExpression);
+    writeToken(expr->name);
+    writeExpression(expr->index);
+}
+
+auto AstWriter::visit(LiteralExpression* expr) -> void {
+    writeKind(NodeKind::LiteralExpression);
+    writeSigned(expr->value);
+}
+
+// Reader
+
+auto AstReader::fail(std::string_view reason) -> void {
+    if(!hadError()) {
+        pushError(std::format("Load Error: {} at byte {}.", reason, m_position));
+    }
+
+    // Every following read fails too.
+    m_position = m_data.size() + 1;
+}
+
+auto AstReader::read() -> StatementPtr {
+
+    if(m_data.size() < sizeof(MAGIC) + 2 || std::memcmp(m_data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        fail("not a PL/0 AST file");
+        return nullptr;
+    }
+
+    m_position = sizeof(MAGIC);
+
+    const auto version = static_cast<std::uint16_t>(static_cast<std::uint8_t>(m_data[m_position])
+                                                    | static_cast<std::uint8_t>(m_data[m_position + 1]) << 8);
+    m_position += 2;
+
+    if(version != VERSION) {
+        fail(std::format("unsupported version {}", version));
+        return nullptr;
+    }
+
+    const std::uint64_t names = readUnsigned();
+
+    // Every name takes at least a byte, this bounds the allocation.
+    if(names > m_data.size()) {
+        fail("invalid number of names");
+        return nullptr;
+    }
+
+    m_names.reserve(names);
+
+    for(std::uint64_t i = 0; i < names && !hadError(); i++) {
+        const std::uint64_t length = readUnsigned();
+        if(hadError()) return nullptr;
+
+        if(length > m_data.size() - m_position) {
+            fail("name out of the data");
+            return nullptr;
+        }
+
+        m_names.push_back(m_data.substr(m_position, length));
+        m_position += length;
+    }
+
+    StatementPtr program = readBlock();
+
+    if(!hadError() && m_position != m_data.size()) {
+        fail("unexpected data after the program");
+    }
+
+    return hadError() ? nullptr : std::move(program);
+}
+
+auto AstReader::readUnsigned() -> std::uint64_t {
+
+    std::uint64_t value = 0;
+
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+        if(m_position >= m_data.size()) {
+            fail("unexpected end of the data");
+            return 0;
+        }
+
+        const auto byte = static_cast<std::uint8_t>(m_data[m_position++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+        if((byte & 0x80) == 0) return value;
+    }
+
+    fail("invalid integer");
+    return 0;
+}
+
+auto AstReader::readSigned() -> std::int64_t {
+    const std::uint64_t value = readUnsigned();
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+auto AstReader::readKind() -> NodeKind {
+
+    const std::uint64_t kind = readUnsigned();
+
+    if(kind >= static_cast<std::uint64_t>(NodeKind::Count)) {
+        fail("invalid node kind");
+        return NodeKind::None;
+    }
+
+    return static_cast<NodeKind>(kind);
+}
+
+auto AstReader::readToken(std::initializer_list<TokenType> types) -> Token {
+
+    const std::uint64_t type = readUnsigned();
+    const std::uint64_t line = readUnsigned();
+    const std::uint64_t name = readUnsigned();
+
+    if(type > static_cast<std::uint64_t>(TokenType::Eof) || name >= m_names.size()) {
+        fail("invalid token");
+        return {};
+    }
+
+    if(std::find(types.begin(), types.end(), static_cast<TokenType>(type)) == types.end()) {
+        fail("unexpected token");
+        return {};
+    }
+
+    return Token(static_cast<TokenType>(type), m_names[name], static_cast<std::uint32_t>(line));
+}
+
+auto AstReader::readBlock() -> StatementPtr {
+
+    if(readKind() != NodeKind::Block) {
+        fail("expected a block");
+        return nullptr;
+    }
+
+    // Declarations the users cast to their type.
+    const auto readDeclaration = [this](NodeKind expected) {
+        const std::size_t start = m_position;
+        StatementPtr decl = readStatement();
+
+        if(decl != nullptr && static_cast<NodeKind>(m_data[start]) != expected) {
+            fail("unexpected declaration");
+        }
+
+        return decl;
+    };
+
+    StatementPtr constants = readDeclaration(NodeKind::ConstDeclarations);
+    StatementPtr variables = readDeclaration(NodeKind::VariableDeclarations);
+    StatementPtr shared = readDeclaration(NodeKind::VariableDeclarations);
+
+    const std::uint64_t count = readUnsigned();
+    std::vector<StatementPtr> procedures;
+
+    for(std::uint64_t i = 0; i < count && !hadError(); i++) {
+        procedures.push_back(readDeclaration(NodeKind::ProcedureDeclaration));
+
+        if(procedures.back() == nullptr) fail("expected a procedure");
+    }
+
+    StatementPtr statement = readStatement();
+
+    if(hadError()) return nullptr;
+    return buildStatement<Block>(constants, variables, shared, procedures, statement);
+}
+
+auto AstReader::readStatementNode() -> StatementPtr {
+
+    if(hadError()) return nullptr;
+
+    switch(readKind()) {
+        case NodeKind::None:
+            return nullptr;
+
+        case NodeKind::ConstDeclarations: {
+            const std::uint64_t count = readUnsigned();
+            std::vector<ConstDeclaration> declarations;
+
+            for(std::uint64_t i = 0; i < count && !hadError(); i++) {
+                const Token identifier = readToken({TokenType::Identifier});
+                const auto initializer = static_cast<int>(readSigned());
+
+                declarations.push_back({identifier, initializer});
+            }
+
+            return buildStatement<ConstDeclarations>(declarations);
+        }
+
+        case NodeKind::VariableDeclarations: {
+            const bool isShared = readUnsigned() != 0;
+            const std::uint64_t count = readUnsigned();
+            std::vector<VariableDeclaration> declarations;
+
+            for(std::uint64_t i = 0; i < count && !hadError(); i++) {
+                VariableDeclaration declaration = {readToken({TokenType::Identifier}), std::nullopt};
+                if(readUnsigned() != 0) declaration.length = readToken({TokenType::Number, TokenType::Identifier});
+
+                declarations.push_back(declaration);
+            }
+
+            return buildStatement<VariableDeclarations>(declarations, isShared);
+        }
+
+        case NodeKind::ProcedureDeclaration: {
+            const Token name = readToken({TokenType::Identifier});
+            StatementPtr block = readBlock();
+
+            return buildStatement<ProcedureDeclaration>(name, block);
+        }
+
+        case NodeKind::AssignStatement: {
+            const Token lvalue = readToken({TokenType::Identifier});
+            ExpressionPtr index = readExpression();
+            ExpressionPtr rvalue = readExpression();
+
+            if(rvalue == nullptr) fail("expected an expression");
+            return buildStatement<AssignStatement>(lvalue, index, rvalue);
+        }
+
+        case NodeKind::CallStatement:
+            return buildStatement<CallStatement>(readToken({TokenType::Identifier}));
+
+        case NodeKind::InputStatement: {
+            const Token destination = readToken({TokenType::Identifier});
+            ExpressionPtr index = readExpression();
+
+            return buildStatement<InputStatement>(destination, index);
+        }
+
+        case NodeKind::PrintStatement: {
+            ExpressionPtr argument = readExpression();
+            return buildStatement<PrintStatement>(argument);
+        }
+
+        case NodeKind::BeginStatement: {
+            const std::uint64_t count = readUnsigned();
+            std::vector<StatementPtr> statements;
+
+            for(std::uint64_t i = 0; i < count && !hadError(); i++) {
+                statements.push_back(readStatement());
+            }
+
+            return buildStatement<BeginStatement>(statements);
+        }
+
+        case NodeKind::IfStatement: {
+            ExpressionPtr condition = readCondition();
+            StatementPtr body = readStatement();
+
+            if(condition == nullptr) fail("expected a condition");
+            return buildStatement<IfStatement>(condition, body);
+        }
+
+        case NodeKind::WhileStatement: {
+            ExpressionPtr condition = readCondition();
+            StatementPtr body = readStatement();
+
+            if(condition == nullptr) fail("expected a condition");
+            return buildStatement<WhileStatement>(condition, body);
+        }
+
+        case NodeKind::ForStatement: {
+            const Token variable = readToken({TokenType::Identifier});
+            ExpressionPtr from = readExpression();
+            ExpressionPtr to = readExpression();
+            ExpressionPtr step = readExpression();
+            StatementPtr body = readStatement();
+
+            if(from == nullptr || to == nullptr) fail("expected the bounds of the loop");
+            return buildStatement<ForStatement>(variable, from, to, step, body);
+        }
+
+        case NodeKind::ParallelStatement: {
+            const Token keyword = readToken({TokenType::ParallelKeyword});
+            const std::uint64_t count = readUnsigned();
+            std::vector<StatementPtr> calls;
+
+            for(std::uint64_t i = 0; i < count && !hadError(); i++) {
+                const std::size_t start = m_position;
+                calls.push_back(readStatement());
+
+                if(calls.back() == nullptr || static_cast<NodeKind>(m_data[start]) != NodeKind::CallStatement) {
+                    fail("expected a call");
+                }
+            }
+
+            return buildStatement<ParallelStatement>(keyword, calls);
+        }
+
+        default:
+            fail("expected a statement");
+            return nullptr;
+    }
+}
+
+auto AstReader::readExpressionNode() -> ExpressionPtr {
+
+    if(hadError()) return nullptr;
+
+    switch(readKind()) {
+        case NodeKind::None:
+            return nullptr;
+
+        case NodeKind::BinaryExpression: {
+            ExpressionPtr left = readExpression();
+            const Token op = readToken(ARITHMETIC_OPERATORS);
+            ExpressionPtr right = readExpression();
+
+            if(left == nullptr || right == nullptr) fail("expected an operand");
+            return buildExpression<BinaryExpression>(left, op, right);
+        }
+
+        case NodeKind::UnaryExpression: {
+            const Token op = readToken({TokenType::Plus, TokenType::Minus});
+            ExpressionPtr right = readExpression();
+
+            if(right == nullptr) fail("expected an operand");
+            return buildExpression<UnaryExpression>(op, right);
+        }
+
+        case NodeKind::VariableExpression:
+            return buildExpression<VariableExpression>(readToken({TokenType::Identifier}));
+
+        case NodeKind::IndexExpression: {
+            const Token name = readToken({TokenType::Identifier});
+            ExpressionPtr index = readExpression();
+
+            if(index == nullptr) fail("expected an index");
+            return buildExpression<IndexExpression>(name, index);
+        }
+
+        case NodeKind::LiteralExpression:
+            return buildExpression<LiteralExpression>(static_cast<int>(readSigned()));
+
+        default:
+            fail("expected an expression");
+            return nullptr;
+    }
+}
+
+auto AstReader::readConditionNode() -> ExpressionPtr {
+
+    if(hadError()) return nullptr;
+
+    switch(readKind()) {
+        case NodeKind::OddExpression: {
+            ExpressionPtr expr = readExpression();
+
+            if(expr == nullptr) fail("expected an expression");
+            return buildExpression<OddExpression>(expr);
+        }
+
+        case NodeKind::BinaryExpression: {
+            ExpressionPtr left = readExpression();
+            const Token op = readToken(RELATIONAL_OPERATORS);
+            ExpressionPtr right = readExpression();
+
+            if(left == nullptr || right == nullptr) fail("expected an operand");
+            return buildExpression<BinaryExpression>(left, op, right);
+        }
+
+        default:
+            fail("expected a condition");
+            return nullptr;
+    }
+}
+
+}
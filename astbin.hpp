@@ -0,0 +1,160 @@
+#ifndef _ASTBIN_HPP_
+#define _ASTBIN_HPP_
+
+#include "ast.hpp"
+#include "errors_holder_trait.hpp"
+#include "os.hpp"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pl0::astbin {
+
+using namespace ast;
+using namespace error;
+
+/*
+
+Binary encoding of the AST (-emit-ast-bin), loaded back without lexing and
+parsing the source again.
+
+    header      "PL0AST" + version (2 bytes), number of names
+    names       length + bytes of every lexeme, interned
+    nodes       the tree in preorder: a node is its kind followed by its
+                fields, a missing child is the kind None
+
+Integers are LEB128 varints, zigzag encoded when signed. A token is its
+type, its line and the index of its lexeme.
+
+*/
+enum class NodeKind : std::uint8_t {
+    None,
+
+    Block,
+    ConstDeclarations,
+    VariableDeclarations,
+    ProcedureDeclaration,
+
+    AssignStatement,
+    CallStatement,
+    InputStatement,
+    PrintStatement,
+    BeginStatement,
+    IfStatement,
+    WhileStatement,
+    ForStatement,
+    ParallelStatement,
+
+    OddExpression,
+    BinaryExpression,
+    UnaryExpression,
+    VariableExpression,
+    IndexExpression,
+    LiteralExpression,
+
+    Count
+};
+
+class AstWriter final : public AstVisitor {
+public:
+    AstWriter() = default;
+
+    [[nodiscard]]
+    auto write(StatementPtr& ast) -> std::string;
+
+private:
+    auto visit(Block* block) -> void;
+    auto visit(ConstDeclarations* decl) -> void;
+    auto visit(VariableDeclarations* decl) -> void;
+    auto visit(ProcedureDeclaration* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(PrintStatement* stmt) -> void;
+    auto visit(BeginStatement* stmt) -> void;
+    auto visit(IfStatement* stmt) -> void;
+    auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
+
+    auto visit(OddExpression* expr) -> void;
+    auto visit(BinaryExpression* expr) -> void;
+    auto visit(UnaryExpression* expr) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+    auto visit(LiteralExpression* expr) -> void;
+
+    auto writeStatement(StatementPtr& stmt) -> void;
+    auto writeExpression(ExpressionPtr& expr) -> void;
+    auto writeToken(const Token& token) -> void;
+    auto writeUnsigned(std::uint64_t value) -> void;
+    auto writeSigned(std::int64_t value) -> void;
+
+    inline auto writeKind(NodeKind kind) -> void {
+        m_nodes.push_back(static_cast<char>(kind));
+    }
+
+private:
+    std::string m_nodes;
+
+    std::unordered_map<std::string_view, std::uint32_t> m_nameIndices;
+    std::vector<std::string_view> m_names;
+};
+
+// The lexemes of the tokens point into `data`, it must outlive the AST.
+class AstReader final : public ErrorsHolderTrait {
+public:
+    explicit AstReader(std::string_view data)
+        : m_data(data) {}
+
+    // nullptr if the data isn't a valid encoding.
+    [[nodiscard]]
+    auto read() -> StatementPtr;
+
+private:
+    // On a new stack when needed, the nodes nest as deep as the data says.
+    inline auto readStatement() -> StatementPtr {
+        return os::withStack([this] { return readStatementNode(); });
+    }
+
+    // An arithmetic expression: what the code generator computes as an
+    // integer, an operand or a value.
+    inline auto readExpression() -> ExpressionPtr {
+        return os::withStack([this] { return readExpressionNode(); });
+    }
+
+    // The condition of an if or a while: odd or a comparison.
+    inline auto readCondition() -> ExpressionPtr {
+        return os::withStack([this] { return readConditionNode(); });
+    }
+
+    auto readStatementNode() -> StatementPtr;
+    auto readExpressionNode() -> ExpressionPtr;
+    auto readConditionNode() -> ExpressionPtr;
+
+    auto readBlock() -> StatementPtr;
+
+    // Fails unless the type of the token is one of `types`.
+    auto readToken(std::initializer_list<token::TokenType> types) -> Token;
+    auto readKind() -> NodeKind;
+    auto readUnsigned() -> std::uint64_t;
+    auto readSigned() -> std::int64_t;
+
+    // Reports the first error only, the rest of the data is meaningless.
+    auto fail(std::string_view reason) -> void;
+
+private:
+    std::string_view m_data;
+    std::size_t m_position = 0;
+
+    std::vector<std::string_view> m_names;
+};
+
+}
+
+#endif
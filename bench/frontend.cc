@@ -0,0 +1,458 @@
+#include "generator.hpp"
+
+#include "../ast.hpp"
+#include "../astbin.hpp"
+#include "../codegen.hpp"
+#include "../lsp.hpp"
+#include "../os.hpp"
+#include "../parser.hpp"
+#include "../pipeline.hpp"
+#include "../tokenizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+
+Compiler throughput benchmark. Every case generates a synthetic program and
+measures, in a forked process so that peak RSS belongs to the case alone:
+
+    tokens/s          Tokenizer::tokenize
+    nodes/s           Parser::parseProgram
+    pipeline seconds  Parser::parseProgram pulling the tokens from a
+                      LexerThread (-pipeline), against tokenize + parse in
+                      a row: the speedup needs a second core
+    parallel seconds  Parser::parseProgram with the procedures parsed on all
+                      the cores (-parallel-parse)
+    load seconds      AstReader::read of the -emit-ast-bin encoding
+    dump nodes/s      AstPrinter (-ast) and AstJsonPrinter (-ast-json) writing
+                      to /dev/null; the text dump is skipped (null) for the
+                      nesting case, its indentation grows with the square of
+                      the depth
+    edit seconds      lsp::Document::edit, typing a statement in the middle of
+                      the program and deleting it, one character at a time
+    instructions/s    CodeGenerator::generate (IR generation + verifier)
+    one-pass seconds  CodeGenerator::generate from a Parser pulling the tokens
+                      (-one-pass), run first: its peak RSS is the one before
+                      the tokens and the AST exist
+
+Each phase is repeated and the fastest run is kept. Results are written on
+stdout as one JSON object per line.
+
+*/
+
+using namespace pl0::ast;
+
+using pl0::bench::GeneratorOptions;
+using pl0::bench::ProgramGenerator;
+using pl0::codegen::CodeGenerator;
+using pl0::parser::Parser;
+using pl0::token::Token;
+using pl0::token::TokenType;
+using pl0::tokenizer::Tokenizer;
+
+struct BenchCase {
+    const char* name;
+    GeneratorOptions options;
+};
+
+static const BenchCase cases[] = {
+    {"small",        {.statements = 1'000,   .depth = 3, .procedures = 10,    .expressionComplexity = 3,  .seed = 1}},
+    {"medium",       {.statements = 50'000,  .depth = 4, .procedures = 100,   .expressionComplexity = 4,  .seed = 2}},
+    {"large",        {.statements = 500'000, .depth = 4, .procedures = 1'000, .expressionComplexity = 4,  .seed = 3}},
+    {"deep",         {.statements = 50'000,  .depth = 12, .procedures = 20,   .expressionComplexity = 4,  .seed = 4}},
+    {"procedures",   {.statements = 100'000, .depth = 2, .procedures = 10'000, .expressionComplexity = 2, .seed = 5}},
+    {"expressions",  {.statements = 20'000,  .depth = 2, .procedures = 20,    .expressionComplexity = 32, .seed = 6}},
+    {"nesting",      {.depth = 0, .procedures = 0, .seed = 7, .nesting = 1'000'000}},
+};
+
+class NodeCounter final : public AstVisitor {
+public:
+    auto count(StatementPtr& ast) -> std::size_t {
+        m_count = 0;
+        visitStatement(ast);
+        return m_count;
+    }
+
+private:
+    auto visitStatement(StatementPtr& stmt) -> void {
+        if(stmt != nullptr) pl0::os::withStack([&] { stmt->accept(this); });
+    }
+
+    auto visitExpression(ExpressionPtr& expr) -> void {
+        if(expr != nullptr) pl0::os::withStack([&] { expr->accept(this); });
+    }
+
+    auto visit(Block* block) -> void {
+        m_count++;
+        visitStatement(block->constantsDeclaration);
+        visitStatement(block->variablesDeclaration);
+        visitStatement(block->sharedDeclaration);
+        for(auto& procedure : block->procedureDeclarations) visitStatement(procedure);
+        visitStatement(block->statement);
+    }
+
+    auto visit(ConstDeclarations* decl) -> void { m_count++; }
+    auto visit(VariableDeclarations* decl) -> void { m_count++; }
+
+    auto visit(ProcedureDeclaration* decl) -> void {
+        m_count++;
+        visitStatement(decl->block);
+    }
+
+    auto visit(AssignStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->index);
+        visitExpression(stmt->rvalue);
+    }
+
+    auto visit(CallStatement* stmt) -> void { m_count++; }
+    auto visit(InputStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->index);
+    }
+
+    auto visit(PrintStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->argument);
+    }
+
+    auto visit(BeginStatement* stmt) -> void {
+        m_count++;
+        for(auto& statement : stmt->statements) visitStatement(statement);
+    }
+
+    auto visit(IfStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->condition);
+        visitStatement(stmt->body);
+    }
+
+    auto visit(WhileStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->condition);
+        visitStatement(stmt->body);
+    }
+
+    auto visit(ForStatement* stmt) -> void {
+        m_count++;
+        visitExpression(stmt->from);
+        visitExpression(stmt->to);
+        visitExpression(stmt->step);
+        visitStatement(stmt->body);
+    }
+
+    auto visit(ParallelStatement* stmt) -> void {
+        m_count++;
+        for(auto& call : stmt->calls) visitStatement(call);
+    }
+
+    auto visit(OddExpression* expr) -> void {
+        m_count++;
+        visitExpression(expr->expr);
+    }
+
+    auto visit(BinaryExpression* expr) -> void {
+        m_count++;
+        visitExpression(expr->left);
+        visitExpression(expr->right);
+    }
+
+    auto visit(UnaryExpression* expr) -> void {
+        m_count++;
+        visitExpression(expr->right);
+    }
+
+    auto visit(VariableExpression* expr) -> void { m_count++; }
+
+    auto visit(IndexExpression* expr) -> void {
+        m_count++;
+        visitExpression(expr->index);
+    }
+    auto visit(LiteralExpression* expr) -> void { m_count++; }
+
+private:
+    std::size_t m_count = 0;
+};
+
+template<typename Function>
+static auto fastest(int repeat, Function&& function) -> double {
+
+    double best = std::numeric_limits<double>::max();
+
+    for(int i = 0; i < repeat; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+static auto runCase(const BenchCase& bench, int repeat, const char* revision) -> void {
+
+    const std::string source = ProgramGenerator(bench.options).generate();
+
+    std::size_t onePassInstructions = 0;
+    const double onePassSeconds = fastest(repeat, [&] {
+        Tokenizer tokenizer(source);
+        Parser parser(tokenizer);
+        CodeGenerator codegen("bench");
+
+        if(!codegen.generate(parser) || codegen.hadError()) {
+            std::cerr << bench.name << ": the generated program doesn't compile in one pass.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        onePassInstructions = codegen.module().getInstructionCount();
+    });
+
+    rusage onePassUsage;
+    getrusage(RUSAGE_SELF, &onePassUsage);
+
+    std::vector<Token> tokens;
+    const double lexSeconds = fastest(repeat, [&] {
+        tokens = Tokenizer(source).tokenize();
+    });
+
+    StatementPtr ast;
+    double parseSeconds = std::numeric_limits<double>::max();
+
+    for(int i = 0; i < repeat; i++) {
+        std::vector<Token> copy = tokens;
+
+        const auto start = std::chrono::steady_clock::now();
+        Parser parser(copy);
+        ast = parser.parseProgram();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if(parser.hadError()) {
+            std::cerr << bench.name << ": the generated program doesn't parse: " << parser.errors().front() << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+
+        parseSeconds = std::min(parseSeconds, elapsed.count());
+    }
+
+    const std::size_t nodes = NodeCounter().count(ast);
+
+    const double frontendSeconds = fastest(repeat, [&] {
+        std::vector<Token> tokens = Tokenizer(source).tokenize();
+        Parser parser(tokens);
+        StatementPtr parsed = parser.parseProgram();
+    });
+
+    std::size_t pipelinedNodes = 0;
+    const double pipelineSeconds = fastest(repeat, [&] {
+        pl0::pipeline::LexerThread lexer(source);
+        Parser parser(lexer);
+        StatementPtr parsed = parser.parseProgram();
+
+        pipelinedNodes = parser.hadError() ? 0 : NodeCounter().count(parsed);
+    });
+
+    const unsigned parseThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t parallelNodes = 0;
+    double parallelSeconds = std::numeric_limits<double>::max();
+
+    for(int i = 0; i < repeat; i++) {
+        std::vector<Token> copy = tokens;
+
+        const auto start = std::chrono::steady_clock::now();
+        Parser parser(copy);
+        parser.setThreads(parseThreads);
+        StatementPtr parsed = parser.parseProgram();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        parallelNodes = parser.hadError() ? 0 : NodeCounter().count(parsed);
+        parallelSeconds = std::min(parallelSeconds, elapsed.count());
+    }
+
+    if(parallelNodes != nodes) {
+        std::cerr << bench.name << ": the parallel parser doesn't parse the same program.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(pipelinedNodes != nodes) {
+        std::cerr << bench.name << ": the pipelined front end doesn't parse the same program.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    const std::string encoded = pl0::astbin::AstWriter().write(ast);
+    std::size_t loadedNodes = 0;
+
+    const double loadSeconds = fastest(repeat, [&] {
+        pl0::astbin::AstReader reader(encoded);
+        StatementPtr loaded = reader.read();
+
+        loadedNodes = reader.hadError() ? 0 : NodeCounter().count(loaded);
+    });
+
+    if(loadedNodes != nodes) {
+        std::cerr << bench.name << ": the binary AST doesn't load back.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::FILE* null = std::fopen("/dev/null", "w");
+
+    if(null == nullptr) {
+        std::perror("fopen(/dev/null)");
+        std::exit(EXIT_FAILURE);
+    }
+
+    const double dumpSeconds = bench.options.nesting > 0 ? 0 : fastest(repeat, [&] {
+        AstPrinter(null).print(ast);
+    });
+
+    const double jsonSeconds = fastest(repeat, [&] {
+        AstJsonPrinter(null).print(ast);
+    });
+
+    std::fclose(null);
+
+    // The first assignment from the middle of the program.
+    pl0::lsp::Document document(source);
+    const auto& documentTokens = document.tokens();
+
+    std::size_t statement = documentTokens.size() / 2;
+
+    while(statement + 1 < documentTokens.size()
+        && !(documentTokens[statement].type == TokenType::Identifier
+            && documentTokens[statement + 1].type == TokenType::Assign
+            && (documentTokens[statement - 1].type == TokenType::Semicolon
+                || documentTokens[statement - 1].type == TokenType::BeginKeyword))) {
+        statement++;
+    }
+
+    const std::string_view typed = "g0 := g0 + 1;";
+    const std::uint32_t line = documentTokens[statement].line - 1;
+    const std::uint32_t column = document.column(documentTokens[statement]);
+
+    double editSeconds = 0;
+    std::size_t reparsedTokens = 0;
+
+    const auto edit = [&](std::uint32_t start, std::uint32_t end, std::string_view text) {
+        const auto begin = std::chrono::steady_clock::now();
+        document.edit({line, column + start}, {line, column + end}, text);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        editSeconds += elapsed.count();
+        reparsedTokens += document.reparsedTokens();
+    };
+
+    for(std::uint32_t i = 0; i < typed.size(); i++) edit(i, i, typed.substr(i, 1));
+    for(std::uint32_t i = typed.size(); i > 0; i--) edit(i - 1, i, "");
+
+    if(document.text() != source) {
+        std::cerr << bench.name << ": the edited document doesn't match the source.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    const std::size_t edits = typed.size() * 2;
+
+    std::size_t instructions = 0;
+    const double codegenSeconds = fastest(repeat, [&] {
+        CodeGenerator codegen("bench");
+
+        if(!codegen.generate(ast) || codegen.hadError()) {
+            std::cerr << bench.name << ": the generated program doesn't compile.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        instructions = codegen.module().getInstructionCount();
+    });
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::cout << std::format(
+        "{{\"revision\": \"{}\", \"case\": \"{}\", \"bytes\": {}, "
+        "\"tokens\": {}, \"lex_seconds\": {:.6f}, \"tokens_per_second\": {:.0f}, "
+        "\"ast_nodes\": {}, \"parse_seconds\": {:.6f}, \"nodes_per_second\": {:.0f}, "
+        "\"frontend_seconds\": {:.6f}, \"pipeline_seconds\": {:.6f}, \"pipeline_speedup\": {:.2f}, "
+        "\"parse_threads\": {}, \"parallel_parse_seconds\": {:.6f}, \"parallel_parse_speedup\": {:.2f}, "
+        "\"ast_bin_bytes\": {}, \"load_seconds\": {:.6f}, "
+        "\"dump_seconds\": {}, \"dump_nodes_per_second\": {}, "
+        "\"json_seconds\": {:.6f}, \"json_nodes_per_second\": {:.0f}, "
+        "\"edit_seconds\": {:.6f}, \"edit_reparsed_tokens\": {}, "
+        "\"ir_instructions\": {}, \"codegen_seconds\": {:.6f}, \"instructions_per_second\": {:.0f}, "
+        "\"onepass_instructions\": {}, \"onepass_seconds\": {:.6f}, \"onepass_peak_rss_kb\": {}, "
+        "\"peak_rss_kb\": {}}}\n",
+        revision, bench.name, source.size(),
+        tokens.size(), lexSeconds, tokens.size() / lexSeconds,
+        nodes, parseSeconds, nodes / parseSeconds,
+        frontendSeconds, pipelineSeconds, frontendSeconds / pipelineSeconds,
+        parseThreads, parallelSeconds, parseSeconds / parallelSeconds,
+        encoded.size(), loadSeconds,
+        dumpSeconds > 0 ? std::format("{:.6f}", dumpSeconds) : "null",
+        dumpSeconds > 0 ? std::format("{:.0f}", nodes / dumpSeconds) : "null",
+        jsonSeconds, nodes / jsonSeconds,
+        editSeconds / edits, reparsedTokens / edits,
+        instructions, codegenSeconds, instructions / codegenSeconds,
+        onePassInstructions, onePassSeconds, onePassUsage.ru_maxrss,
+        usage.ru_maxrss);
+}
+
+auto main(int argc, char** argv) -> int {
+
+    int repeat = 5;
+    const char* revision = "unknown";
+    const char* only = nullptr;
+
+    for(char** args = argv + 1; *args != nullptr; args++) {
+
+        if(std::strncmp(*args, "-repeat=", 8) == 0) {
+            repeat = std::max(1, std::atoi(*args + 8));
+        } else if(std::strncmp(*args, "-revision=", 10) == 0) {
+            revision = *args + 10;
+        } else if(std::strncmp(*args, "-case=", 6) == 0) {
+            only = *args + 6;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-repeat=N] [-revision=<id>] [-case=<name>]\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    for(const auto& bench : cases) {
+
+        if(only != nullptr && std::strcmp(only, bench.name) != 0) continue;
+
+        std::cout.flush();
+
+        const pid_t child = fork();
+
+        if(child < 0) {
+            std::perror("fork()");
+            std::exit(EXIT_FAILURE);
+        }
+
+        if(child == 0) {
+            runCase(bench, repeat, revision);
+            std::cout.flush();
+            std::_Exit(EXIT_SUCCESS);
+        }
+
+        int status;
+        if(waitpid(child, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << bench.name << ": benchmark failed.\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+#include "generator.hpp"
+
+#include <algorithm>
+
+namespace pl0::bench {
+
+auto ProgramGenerator::generate() -> std::string {
+
+    m_output.clear();
+
+    m_output += "const ";
+    for(std::uint32_t i = 0; i < CONSTANTS; i++) {
+        if(i > 0) m_output += ", ";
+        m_output += "c" + std::to_string(i) + " = " + std::to_string(1 + below(100));
+    }
+    m_output += ";\n";
+
+    m_output += "var ";
+    for(std::uint32_t i = 0; i < GLOBALS; i++) {
+        m_output += "g" + std::to_string(i) + ", ";
+    }
+    for(std::uint32_t i = 0; i < m_options.depth; i++) {
+        m_output += "k" + std::to_string(i) + ", ";
+    }
+    m_output.resize(m_output.size() - 2);
+    m_output += ";\n\n";
+
+    for(std::uint32_t i = 0; i < m_options.procedures; i++) {
+        procedure(i);
+    }
+
+    m_locals = 0;
+    m_callableProcedures = m_options.procedures;
+
+    if(m_options.nesting > 0) {
+        nestedStatements();
+        m_output += ".\n";
+
+        return std::move(m_output);
+    }
+
+    const std::uint32_t budget = m_options.statements / (m_options.procedures + 1);
+    statements(std::max(budget, 1u), 0);
+    m_output += ".\n";
+
+    return std::move(m_output);
+}
+
+auto ProgramGenerator::procedure(std::uint32_t index) -> void {
+
+    m_output += "procedure p" + std::to_string(index) + ";\nvar ";
+
+    for(std::uint32_t i = 0; i < LOCALS; i++) {
+        m_output += "l" + std::to_string(i) + ", ";
+    }
+
+    // Local loop counters shadow the global ones, so a procedure called
+    // inside a loop can't change the caller's trip count.
+    for(std::uint32_t i = 0; i < m_options.depth; i++) {
+        m_output += "k" + std::to_string(i) + ", ";
+    }
+
+    m_output.resize(m_output.size() - 2);
+    m_output += ";\n";
+
+    m_locals = LOCALS;
+
+    // Only the procedures already declared are callable, so the call graph
+    // is acyclic.
+    m_callableProcedures = index;
+
+    const std::uint32_t budget = m_options.statements / (m_options.procedures + 1);
+    statements(std::max(budget, 1u), 0);
+    m_output += ";\n\n";
+}
+
+auto ProgramGenerator::nestedStatements() -> void {
+
+    const std::uint32_t nesting = m_options.nesting;
+
+    m_output += "begin";
+    m_indent++;
+    newline();
+
+    m_output += "g0 := ";
+    m_output.append(nesting, '(');
+    m_output += "c0";
+    m_output.append(nesting, ')');
+    m_output += ';';
+    newline();
+
+    // Not indented, the size of the program stays linear in the nesting.
+    for(std::uint32_t i = 0; i < nesting; i++) {
+        m_output += "if g0 # 0 then begin ";
+    }
+
+    m_output += "g1 := g0";
+    for(std::uint32_t i = 0; i < nesting; i++) {
+        m_output += " + 1";
+    }
+
+    for(std::uint32_t i = 0; i < nesting; i++) {
+        m_output += " end";
+    }
+
+    m_output += ';';
+    newline();
+    m_output += "g2 := g1";
+
+    m_indent--;
+    newline();
+    m_output += "end";
+}
+
+auto ProgramGenerator::statements(std::uint32_t budget, std::uint32_t depth) -> void {
+
+    m_output += "begin";
+    m_indent++;
+
+    bool first = true;
+    while(budget > 0) {
+        if(!first) m_output += ';';
+        first = false;
+
+        newline();
+        statement(budget, depth);
+    }
+
+    m_indent--;
+    newline();
+    m_output += "end";
+}
+
+auto ProgramGenerator::statement(std::uint32_t& budget, std::uint32_t depth) -> void {
+
+    budget--;
+
+    const std::uint32_t choice = below(100);
+    const bool canNest = depth < m_options.depth && budget > 0;
+
+    if(canNest && choice < 22) {
+
+        const std::uint32_t nested = 1 + below(std::min(budget, 1 + budget / 2));
+        budget -= std::min(budget, nested);
+
+        if(choice < 12) {
+            m_output += "if ";
+            condition();
+            m_output += " then";
+
+            m_indent++;
+            newline();
+            statements(nested, depth + 1);
+            m_indent--;
+            return;
+        }
+
+        const std::string counter = "k" + std::to_string(depth);
+
+        m_output += counter + " := 0;";
+        newline();
+        m_output += "while " + counter + " < " + std::to_string(1 + below(4)) + " do";
+
+        m_indent++;
+        newline();
+        m_output += "begin";
+        m_indent++;
+        newline();
+        statements(nested, depth + 1);
+        m_output += ';';
+        newline();
+        m_output += counter + " := " + counter + " + 1";
+        m_indent--;
+        newline();
+        m_output += "end";
+        m_indent--;
+        return;
+    }
+
+    if(choice < 30 && m_callableProcedures > 0) {
+        m_output += "call p" + std::to_string(below(m_callableProcedures));
+        return;
+    }
+
+    if(choice < 38) {
+        m_output += '!';
+        expression(below(m_options.expressionComplexity + 1));
+        return;
+    }
+
+    if(choice < 40) {
+        m_output += '?' + variable();
+        return;
+    }
+
+    m_output += variable() + " := ";
+    expression(below(m_options.expressionComplexity + 1));
+}
+
+auto ProgramGenerator::condition() -> void {
+
+    if(below(5) == 0) {
+        m_output += "odd ";
+        expression(below(m_options.expressionComplexity + 1));
+        return;
+    }
+
+    static constexpr const char* relations[] = {" = ", " # ", " < ", " <= ", " > ", " >= "};
+
+    expression(below(m_options.expressionComplexity / 2 + 1));
+    m_output += relations[below(6)];
+    expression(below(m_options.expressionComplexity / 2 + 1));
+}
+
+auto ProgramGenerator::expression(std::uint32_t operators) -> void {
+
+    if(operators == 0) {
+        operand();
+        return;
+    }
+
+    static constexpr char binaryOperators[] = {'+', '-', '*', '/'};
+    const char op = binaryOperators[below(4)];
+
+    const std::uint32_t left = below(operators);
+
+    m_output += '(';
+    expression(left);
+    m_output += ' ';
+    m_output += op;
+    m_output += ' ';
+
+    if(op == '/') {
+        m_output += std::to_string(1 + below(9));
+    } else {
+        expression(operators - 1 - left);
+    }
+
+    m_output += ')';
+}
+
+auto ProgramGenerator::operand() -> void {
+
+    switch(below(8)) {
+        case 0:
+            m_output += "c" + std::to_string(below(CONSTANTS));
+            break;
+        case 1:
+            m_output += std::to_string(below(1000));
+            break;
+        case 2:
+            m_output += "(-" + variable() + ")";
+            break;
+        case 3:
+            if(m_options.depth > 0) {
+                m_output += "k" + std::to_string(below(m_options.depth));
+                break;
+            }
+            [[fallthrough]];
+        default:
+            m_output += variable();
+            break;
+    }
+}
+
+auto ProgramGenerator::newline() -> void {
+    m_output += '\n';
+    m_output.append(m_indent * 3, ' ');
+}
+
+auto ProgramGenerator::variable() -> std::string {
+
+    const std::uint32_t index = below(GLOBALS + m_locals);
+
+    return index < GLOBALS
+        ? "g" + std::to_string(index)
+        : "l" + std::to_string(index - GLOBALS);
+}
+
+auto ProgramGenerator::next() -> std::uint64_t {
+    std::uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+}
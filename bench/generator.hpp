@@ -0,0 +1,78 @@
+#ifndef _GENERATOR_HPP_
+#define _GENERATOR_HPP_
+
+#include <cstdint>
+#include <string>
+
+namespace pl0::bench {
+
+struct GeneratorOptions {
+    // Approximate number of statements in the whole program.
+    std::uint32_t statements = 1000;
+
+    // Maximum nesting of begin/if/while statements.
+    std::uint32_t depth = 4;
+
+    std::uint32_t procedures = 10;
+
+    // Maximum number of binary operators in a single expression.
+    std::uint32_t expressionComplexity = 4;
+
+    std::uint64_t seed = 1;
+
+    // When not 0, the main block is instead one statement nested this deep in
+    // `if ... then begin ... end`, with as many parentheses around a
+    // literal and binary operators in a chain.
+    std::uint32_t nesting = 0;
+};
+
+// Deterministic generator of valid PL/0 programs: the same options always
+// produce the same program, on every platform. Every `while` is a counted
+// loop and every division has a non zero literal divisor, so the generated
+// programs also terminate when executed.
+class ProgramGenerator final {
+public:
+    explicit ProgramGenerator(GeneratorOptions options)
+        : m_options(options), m_state(options.seed) {}
+
+    auto generate() -> std::string;
+
+private:
+
+    auto procedure(std::uint32_t index) -> void;
+    auto nestedStatements() -> void;
+    auto statements(std::uint32_t budget, std::uint32_t depth) -> void;
+    auto statement(std::uint32_t& budget, std::uint32_t depth) -> void;
+    auto condition() -> void;
+    auto expression(std::uint32_t operators) -> void;
+    auto operand() -> void;
+
+    auto newline() -> void;
+    auto variable() -> std::string;
+
+    // splitmix64, std::uniform_int_distribution isn't portable.
+    auto next() -> std::uint64_t;
+
+    inline auto below(std::uint64_t bound) -> std::uint32_t {
+        return static_cast<std::uint32_t>(next() % bound);
+    }
+
+private:
+    GeneratorOptions m_options;
+    std::uint64_t m_state;
+
+    std::string m_output;
+    std::uint32_t m_indent = 0;
+
+    // Scope of the procedure currently generated.
+    std::uint32_t m_locals = 0;
+    std::uint32_t m_callableProcedures = 0;
+
+    static constexpr std::uint32_t GLOBALS = 16;
+    static constexpr std::uint32_t CONSTANTS = 8;
+    static constexpr std::uint32_t LOCALS = 4;
+};
+
+}
+
+#endif
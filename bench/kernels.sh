@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+#
+# Generated-code benchmark: compiles every kernel in bench/kernels under
+# every mode in MODES and prints, as JSON lines, the runtime, the
+# instructions retired and the binary size. The -interp and -tiered modes
+# run the kernel in the bytecode interpreter, they have no binary;
+# -auto-parallel is compiled at -O2. The outputs of all the modes
+# of a kernel must be equal, otherwise the script fails.
+#
+# Usage: bench/kernels.sh <pl0 compiler> [revision]
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+REVISION=${2:-unknown}
+REPEAT=${REPEAT:-3}
+
+BENCH_DIR=$(dirname "$(realpath "$0")")
+RUNNER="$BENCH_DIR/pl0-run"
+
+MODES=(-O0 -O1 -O2 -O3 -auto-parallel -interp -tiered)
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# Inputs of the kernels that read from stdin.
+{ echo 200000; seq 1 200000; } > "$WORK/echo.in"
+
+failed=0
+
+for kernel in "$BENCH_DIR"/kernels/*.pl0; do
+    name=$(basename "$kernel" .pl0)
+
+    input=()
+    if [ -f "$WORK/$name.in" ]; then
+        input=(-input="$WORK/$name.in")
+    fi
+
+    reference=""
+
+    for mode in "${MODES[@]}"; do
+        dir="$WORK/$name$mode"
+        mkdir -p "$dir"
+        cp "$kernel" "$dir/$name.pl0"
+
+        if [ "$mode" = -interp ] || [ "$mode" = -tiered ]; then
+            size=null
+            result=$("$RUNNER" -repeat="$REPEAT" "${input[@]}" -- "$COMPILER" "$mode" "$dir/$name.pl0")
+        else
+            if [ "$mode" = -auto-parallel ]; then
+                "$COMPILER" -O2 "$mode" "$dir/$name.pl0"
+            else
+                "$COMPILER" "$mode" "$dir/$name.pl0"
+            fi
+
+            size=$(stat -c %s "$dir/$name")
+            result=$("$RUNNER" -repeat="$REPEAT" "${input[@]}" -- "$dir/$name")
+        fi
+        hash=$(sed 's/.*"output_hash": "\([0-9a-f]*\)".*/\1/' <<< "$result")
+
+        if [ -z "$reference" ]; then
+            reference=$hash
+        elif [ "$hash" != "$reference" ]; then
+            echo "$name: the output of $mode differs from ${MODES[0]}." >&2
+            failed=1
+        fi
+
+        echo "{\"revision\": \"$REVISION\", \"kernel\": \"$name\", \"mode\": \"$mode\", \"binary_bytes\": $size, ${result#\{}"
+    done
+done
+
+exit $failed
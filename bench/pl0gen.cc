@@ -0,0 +1,44 @@
+#include "generator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using pl0::bench::GeneratorOptions;
+using pl0::bench::ProgramGenerator;
+
+static auto parseNumber(const char* arg, const char* prefix) -> std::uint64_t {
+    return std::strtoull(arg + std::strlen(prefix), nullptr, 10);
+}
+
+auto main(int argc, char** argv) -> int {
+
+    GeneratorOptions options;
+
+    for(char** args = argv + 1; *args != nullptr; args++) {
+
+        if(std::strncmp(*args, "-statements=", 12) == 0) {
+            options.statements = parseNumber(*args, "-statements=");
+        } else if(std::strncmp(*args, "-depth=", 7) == 0) {
+            options.depth = parseNumber(*args, "-depth=");
+        } else if(std::strncmp(*args, "-procedures=", 12) == 0) {
+            options.procedures = parseNumber(*args, "-procedures=");
+        } else if(std::strncmp(*args, "-complexity=", 12) == 0) {
+            options.expressionComplexity = parseNumber(*args, "-complexity=");
+        } else if(std::strncmp(*args, "-seed=", 6) == 0) {
+            options.seed = parseNumber(*args, "-seed=");
+        } else if(std::strncmp(*args, "-nesting=", 9) == 0) {
+            options.nesting = parseNumber(*args, "-nesting=");
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                << " [-statements=N] [-depth=N] [-procedures=N] [-complexity=N] [-seed=N] [-nesting=N]\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    const std::string program = ProgramGenerator(options).generate();
+    std::fwrite(program.data(), 1, program.size(), stdout);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <optional>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+
+Runs a program several times and prints on stdout a JSON object with:
+
+    seconds         fastest wall-clock time
+    instructions    user-space instructions retired by the fastest run,
+                    null when the kernel doesn't allow perf events
+    output_hash     FNV-1a hash of the program stdout, equal for every run
+
+It doesn't need the perf tool, the counter is read through perf_event_open.
+
+*/
+
+struct Run {
+    double seconds;
+    std::optional<std::uint64_t> instructions;
+    std::uint64_t outputHash;
+};
+
+static auto openInstructionCounter(pid_t pid) -> int {
+
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.inherit = 1;
+    attributes.enable_on_exec = 1;
+
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, pid, -1, -1, 0));
+}
+
+static auto runOnce(char** program, const char* input) -> Run {
+
+    int output[2];
+    int start[2];
+
+    if(pipe(output) == -1 || pipe(start) == -1) {
+        std::perror("pipe()");
+        std::exit(EXIT_FAILURE);
+    }
+
+    const pid_t child = fork();
+
+    if(child < 0) {
+        std::perror("fork()");
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(child == 0) {
+        const int stdinFd = open(input != nullptr ? input : "/dev/null", O_RDONLY);
+
+        if(stdinFd == -1) {
+            std::perror("open()");
+            std::_Exit(EXIT_FAILURE);
+        }
+
+        dup2(stdinFd, STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(output[0]);
+        close(start[1]);
+
+        // Wait for the counter to be attached before exec.
+        char ready;
+        if(read(start[0], &ready, 1) != 1) std::_Exit(EXIT_FAILURE);
+
+        execv(program[0], program);
+        std::perror("execv()");
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    close(output[1]);
+    close(start[0]);
+
+    const int counter = openInstructionCounter(child);
+
+    const auto begin = std::chrono::steady_clock::now();
+    if(write(start[1], "x", 1) != 1) {
+        std::perror("write()");
+        std::exit(EXIT_FAILURE);
+    }
+    close(start[1]);
+
+    std::uint64_t hash = 14695981039346656037ULL;
+    char buffer[1 << 16];
+    ssize_t length;
+
+    while((length = read(output[0], buffer, sizeof(buffer))) > 0) {
+        for(ssize_t i = 0; i < length; i++) {
+            hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ULL;
+        }
+    }
+
+    close(output[0]);
+
+    int status;
+    waitpid(child, &status, 0);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << program[0] << ": the program failed.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    Run run = {elapsed.count(), {}, hash};
+
+    if(counter != -1) {
+        std::uint64_t instructions;
+        if(read(counter, &instructions, sizeof(instructions)) == sizeof(instructions)) {
+            run.instructions = instructions;
+        }
+        close(counter);
+    }
+
+    return run;
+}
+
+auto main(int argc, char** argv) -> int {
+
+    int repeat = 3;
+    const char* input = nullptr;
+
+    char** args;
+    for(args = argv + 1; *args != nullptr && std::strcmp(*args, "--") != 0; args++) {
+
+        if(std::strncmp(*args, "-repeat=", 8) == 0) {
+            repeat = std::max(1, std::atoi(*args + 8));
+        } else if(std::strncmp(*args, "-input=", 7) == 0) {
+            input = *args + 7;
+        } else {
+            break;
+        }
+    }
+
+    if(*args == nullptr || std::strcmp(*args, "--") != 0 || args[1] == nullptr) {
+        std::cerr << "Usage: " << argv[0] << " [-repeat=N] [-input=<file>] -- <program> [args...]\n";
+        return EXIT_FAILURE;
+    }
+
+    char** program = args + 1;
+    Run best = {std::numeric_limits<double>::max(), {}, 0};
+
+    for(int i = 0; i < repeat; i++) {
+        const Run run = runOnce(program, input);
+
+        if(i > 0 && run.outputHash != best.outputHash) {
+            std::cerr << program[0] << ": the output changes between runs.\n";
+            return EXIT_FAILURE;
+        }
+
+        if(run.seconds < best.seconds) best = run;
+    }
+
+    std::cout << std::format("{{\"seconds\": {:.6f}, \"instructions\": {}, \"output_hash\": \"{:x}\"}}\n",
+                             best.seconds,
+                             best.instructions.has_value() ? std::to_string(*best.instructions) : "null",
+                             best.outputHash);
+
+    return EXIT_SUCCESS;
+}
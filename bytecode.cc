@@ -0,0 +1,775 @@
+#include "bytecode.hpp"
+
+#include <array>
+#include <cstdio>
+#include <limits>
+
+namespace pl0::bytecode {
+
+using token::TokenType;
+
+struct OpCodeInfo {
+    std::string_view name;
+    std::uint32_t operands;
+};
+
+static constexpr std::array<OpCodeInfo, static_cast<std::size_t>(OpCode::Count)> opcodes = {{
+    {"push", 1},
+    {"dup", 0},
+
+    {"load_global", 1},
+    {"store_global", 1},
+    {"load_local", 1},
+    {"store_local", 1},
+    {"load_outer", 2},
+    {"store_outer", 2},
+
+    {"load_global_element", 3},
+    {"store_global_element", 3},
+    {"load_local_element", 3},
+    {"store_local_element", 3},
+    {"load_outer_element", 4},
+    {"store_outer_element", 4},
+
+    {"add", 0},
+    {"sub", 0},
+    {"mul", 0},
+    {"div", 1},
+    {"negate", 0},
+    {"odd", 0},
+    {"equal", 0},
+    {"not_equal", 0},
+    {"less", 0},
+    {"less_equal", 0},
+    {"greater", 0},
+    {"greater_equal", 0},
+
+    {"add_immediate", 1},
+    {"add_global", 1},
+    {"add_local", 1},
+    {"add_global_immediate", 2},
+    {"add_local_immediate", 2},
+    {"jump_unless_equal", 1},
+    {"jump_unless_not_equal", 1},
+    {"jump_unless_less", 1},
+    {"jump_unless_less_equal", 1},
+    {"jump_unless_greater", 1},
+    {"jump_unless_greater_equal", 1},
+
+    {"jump", 1},
+    {"jump_if_false", 1},
+
+    {"for_init", 3},
+    {"for_next", 3},
+
+    {"call", 2},
+    {"tail_call", 2},
+    {"return", 0},
+
+    {"print", 0},
+    {"input", 0},
+
+    {"halt", 0},
+}};
+
+auto operandCount(OpCode opcode) -> std::uint32_t {
+    return opcodes[static_cast<std::size_t>(opcode)].operands;
+}
+
+auto opcodeName(OpCode opcode) -> std::string_view {
+    return opcodes[static_cast<std::size_t>(opcode)].name;
+}
+
+auto disassemble(const Program& program) -> void {
+
+    for(std::uint32_t i = 0; i < program.procedures.size(); i++) {
+        const auto& [name, entry, frameSize, parent] = program.procedures[i];
+        std::printf("; procedure %u '%s': entry %u, frame %u, parent %u\n", i, name.c_str(), entry, frameSize, parent);
+    }
+
+    std::printf("; globals: %u\n", program.globals);
+
+    for(std::size_t pc = 0; pc < program.code.size();) {
+        const auto opcode = static_cast<OpCode>(program.code[pc]);
+        const std::string_view name = opcodeName(opcode);
+
+        std::printf("%6zu  %.*s", pc, static_cast<int>(name.size()), name.data());
+
+        for(std::uint32_t i = 1; i <= operandCount(opcode); i++) {
+            std::printf(" %d", program.code[pc + i]);
+        }
+
+        std::putchar('\n');
+        pc += operandCount(opcode) + 1;
+    }
+}
+
+// Arithmetic wraps around like the compiled code.
+static auto wrap(std::int64_t value) -> std::int32_t {
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+}
+
+static auto isComparison(OpCode opcode) -> bool {
+    return opcode >= OpCode::Equal && opcode <= OpCode::GreaterEqual;
+}
+
+// Compiler
+
+auto Compiler::compile(StatementPtr& program) -> Program {
+
+    m_program.procedures.push_back({"main", 0, 1});
+    m_frames.push_back({0, 1});
+
+    compileStatement(program);
+
+    return std::move(m_program);
+}
+
+auto Compiler::lookup(std::string_view name) -> Symbol* {
+
+    for(auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++) {
+        const auto entry = scope->find(name);
+        if(entry != scope->end()) return &entry->second;
+    }
+
+    return nullptr;
+}
+
+auto Compiler::allocateSlots(std::uint32_t count) -> std::int32_t {
+    const std::uint32_t slot = m_frames.back().size;
+    m_frames.back().size += count;
+
+    return static_cast<std::int32_t>(slot);
+}
+
+auto Compiler::isLoopVariable(const Symbol* symbol) const -> bool {
+    for(const Symbol* variable : m_loopVariables) {
+        if(variable == symbol) return true;
+    }
+
+    return false;
+}
+
+auto Compiler::constantValue(std::size_t start) const -> std::optional<std::int32_t> {
+
+    const auto& code = m_program.code;
+
+    if(code.size() == start + 2 && static_cast<OpCode>(code[start]) == OpCode::Push) {
+        return code[start + 1];
+    }
+
+    return {};
+}
+
+auto Compiler::truncate(std::size_t start) -> void {
+    m_program.code.resize(start);
+    m_lastInstruction = std::numeric_limits<std::size_t>::max();
+}
+
+auto Compiler::match(ExpressionPtr& expr) -> Match {
+    Match match;
+
+    m_match = &match;
+    expr->accept(this);
+    m_match = nullptr;
+
+    return match;
+}
+
+auto Compiler::checkIndexing(const Symbol* symbol, const Token& name, const ExpressionPtr& index) -> bool {
+
+    if(index != nullptr && symbol->length == 0) {
+        error("[Ln: {}] Compile Error: '{}' is not an array.", name.line, name.lexeme);
+        return false;
+    }
+
+    if(index == nullptr && symbol->length > 0) {
+        error("[Ln: {}] Compile Error: the array '{}' must be indexed.", name.line, name.lexeme);
+        return false;
+    }
+
+    return true;
+}
+
+auto Compiler::compileIndex(const Symbol* symbol, const Token& name, ExpressionPtr& index) -> bool {
+
+    const std::size_t start = m_program.code.size();
+    compileExpression(index);
+
+    const auto value = constantValue(start);
+
+    if(value.has_value() && static_cast<std::uint32_t>(*value) >= symbol->length) {
+        error("[Ln: {}] Compile Error: index {} out of bounds of '{}', its length is {}.",
+              name.line, *value, name.lexeme, symbol->length);
+        return false;
+    }
+
+    return true;
+}
+
+auto Compiler::emitLoad(const Symbol* symbol, std::uint32_t line) -> void {
+
+    const std::int32_t slot = symbol->value;
+    const std::uint32_t levels = depth() - symbol->depth;
+
+    if(symbol->length == 0) {
+        if(symbol->depth == 0) emit(OpCode::LoadGlobal, slot);
+        else if(levels == 0) emit(OpCode::LoadLocal, slot);
+        else emit(OpCode::LoadOuter, levels, slot);
+        return;
+    }
+
+    if(symbol->depth == 0) emit(OpCode::LoadGlobalElement, slot, symbol->length, line);
+    else if(levels == 0) emit(OpCode::LoadLocalElement, slot, symbol->length, line);
+    else emit(OpCode::LoadOuterElement, levels, slot, symbol->length, line);
+}
+
+auto Compiler::emitStore(const Symbol* symbol, std::uint32_t line) -> void {
+
+    const std::int32_t slot = symbol->value;
+    const std::uint32_t levels = depth() - symbol->depth;
+
+    if(symbol->length == 0) {
+        if(symbol->depth == 0) emit(OpCode::StoreGlobal, slot);
+        else if(levels == 0) emit(OpCode::StoreLocal, slot);
+        else emit(OpCode::StoreOuter, levels, slot);
+        return;
+    }
+
+    if(symbol->depth == 0) emit(OpCode::StoreGlobalElement, slot, symbol->length, line);
+    else if(levels == 0) emit(OpCode::StoreLocalElement, slot, symbol->length, line);
+    else emit(OpCode::StoreOuterElement, levels, slot, symbol->length, line);
+}
+
+auto Compiler::lookupProcedure(const Token& callee) -> Symbol* {
+
+    Symbol* symbol = lookup(callee.lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared procedure.", callee.line, callee.lexeme);
+        return nullptr;
+    }
+
+    if(symbol->kind != Symbol::Kind::Procedure) {
+        error("[Ln: {}] Compile Error: '{}' is not callable.", callee.line, callee.lexeme);
+        return nullptr;
+    }
+
+    return symbol;
+}
+
+auto Compiler::emitCall(const Symbol* procedure) -> void {
+    // The callee's static link is the frame of the procedure declaring it.
+    emit(OpCode::Call, procedure->value, depth() - procedure->depth);
+}
+
+auto Compiler::compileExpression(ExpressionPtr& expr) -> void {
+    if(expr != nullptr) os::withStack([&] { expr->accept(this); });
+}
+
+auto Compiler::compileCondition(ExpressionPtr& condition) -> std::size_t {
+
+    compileExpression(condition);
+
+    const auto& code = m_program.code;
+
+    // The comparison is the last instruction of a condition, it becomes
+    // a compare and branch.
+    if(m_lastInstruction < code.size() && m_lastInstruction + 1 == code.size()
+       && isComparison(static_cast<OpCode>(code.back()))) {
+        const auto opcode = static_cast<OpCode>(code.back());
+        const auto offset = static_cast<std::int32_t>(opcode) - static_cast<std::int32_t>(OpCode::Equal);
+        truncate(m_program.code.size() - 1);
+
+        emit(static_cast<OpCode>(static_cast<std::int32_t>(OpCode::JumpUnlessEqual) + offset), 0);
+        return lastOperand();
+    }
+
+    emit(OpCode::JumpIfFalse, 0);
+    return lastOperand();
+}
+
+auto Compiler::visit(Block* block) -> void {
+
+    m_scopes.emplace_back();
+
+    compileStatement(block->constantsDeclaration);
+    compileStatement(block->variablesDeclaration);
+    compileStatement(block->sharedDeclaration);
+
+    for(auto& procedure : block->procedureDeclarations) {
+        compileStatement(procedure);
+    }
+
+    // The code of the nested procedures comes first.
+    Procedure& procedure = m_program.procedures[m_frames.back().procedure];
+    procedure.entry = static_cast<std::uint32_t>(here());
+
+    compileStatement(block->statement);
+
+    if(depth() == 0) {
+        emit(OpCode::Halt);
+    } else {
+        // A call followed by the return reuses the caller's frame, unless
+        // the callee is nested in the caller and needs its frame.
+        auto& code = m_program.code;
+
+        if(m_lastInstruction < code.size() && m_lastInstruction + 3 == code.size()
+           && static_cast<OpCode>(code[m_lastInstruction]) == OpCode::Call
+           && code[m_lastInstruction + 2] != 0) {
+            code[m_lastInstruction] = static_cast<std::int32_t>(OpCode::TailCall);
+        }
+
+        emit(OpCode::Return);
+    }
+
+    // Fetched again, the nested procedures may have moved it.
+    m_program.procedures[m_frames.back().procedure].frameSize = m_frames.back().size;
+
+    m_scopes.pop_back();
+}
+
+auto Compiler::visit(ConstDeclarations* decl) -> void {
+    for(const auto& [ident, value] : decl->declarations) {
+        m_scopes.back().try_emplace(ident.lexeme, Symbol{Symbol::Kind::Constant, depth(), value});
+    }
+}
+
+auto Compiler::visit(VariableDeclarations* decl) -> void {
+
+    const bool areGlobals = depth() == 0;
+
+    if(decl->isShared && !areGlobals) {
+        error("[Ln: {}] Compile Error: shared variables must be global.", decl->declarations.front().identifier.line);
+        return;
+    }
+
+    for(const auto& [ident, lengthToken] : decl->declarations) {
+
+        const auto& [_, lexeme, line] = ident;
+
+        std::uint32_t length = 0;
+
+        if(lengthToken.has_value()) {
+            std::int64_t value = 0;
+
+            if(lengthToken->type == TokenType::Number) {
+                for(const char digit : lengthToken->lexeme) {
+                    value = value * 10 + (digit - '0');
+                    if(value > std::numeric_limits<std::int32_t>::max()) break;
+                }
+            } else if(const Symbol* constant = lookup(lengthToken->lexeme);
+                      constant != nullptr && constant->kind == Symbol::Kind::Constant) {
+                value = constant->value;
+            }
+
+            if(value <= 0 || value > std::numeric_limits<std::int32_t>::max()) {
+                error("[Ln: {}] Compile Error: the length of '{}' must be a positive constant.", line, lexeme);
+                return;
+            }
+
+            if(decl->isShared) {
+                error("[Ln: {}] Compile Error: the shared variable '{}' can't be an array.", line, lexeme);
+                return;
+            }
+
+            length = static_cast<std::uint32_t>(value);
+        }
+
+        const std::uint32_t size = length > 0 ? length : 1;
+        std::int32_t slot;
+
+        if(areGlobals) {
+            slot = static_cast<std::int32_t>(m_program.globals);
+            m_program.globals += size;
+
+            m_program.variables.push_back({std::string(lexeme), static_cast<std::uint32_t>(slot)});
+        } else {
+            slot = allocateSlots(size);
+        }
+
+        if(!m_scopes.back().try_emplace(lexeme, Symbol{Symbol::Kind::Variable, depth(), slot, length}).second) {
+            const char* const kind = areGlobals ? "global" : "local";
+            error("[Ln: {}] Compile Error: {} variable '{}' already declared.", line, kind, lexeme);
+            return;
+        }
+    }
+}
+
+auto Compiler::visit(ProcedureDeclaration* decl) -> void {
+
+    const auto index = static_cast<std::int32_t>(m_program.procedures.size());
+
+    m_scopes.back().try_emplace(decl->name.lexeme, Symbol{Symbol::Kind::Procedure, depth(), index});
+
+    std::string name{decl->name.lexeme};
+    m_program.procedures.push_back({name, 0, 1, m_frames.back().procedure});
+
+    m_frames.push_back({static_cast<std::uint32_t>(index), 1});
+    compileStatement(decl->block);
+    m_frames.pop_back();
+}
+
+auto Compiler::visit(AssignStatement* stmt) -> void {
+
+    const auto& [_, lexeme, line] = stmt->lvalue;
+    Symbol* symbol = lookup(lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared variable.", line, lexeme);
+        return;
+    }
+
+    if(symbol->kind != Symbol::Kind::Variable) {
+        error("[Ln: {}] Compile Error: can't assign to a constant or a procedure.", line);
+        return;
+    }
+
+    if(isLoopVariable(symbol)) {
+        error("[Ln: {}] Compile Error: can't assign to the loop variable '{}'.", line, lexeme);
+        return;
+    }
+
+    if(!checkIndexing(symbol, stmt->lvalue, stmt->index)) return;
+
+    if(symbol->length > 0) {
+        if(!compileIndex(symbol, stmt->lvalue, stmt->index)) return;
+
+        compileExpression(stmt->rvalue);
+        emitStore(symbol, line);
+        return;
+    }
+
+    // x := x + e and x := x - e update the variable in place.
+    const bool isDirect = symbol->depth == 0 || symbol->depth == depth();
+    const Match rvalue = match(stmt->rvalue);
+
+    if(isDirect && rvalue.binary != nullptr
+       && (rvalue.binary->op.type == TokenType::Plus || rvalue.binary->op.type == TokenType::Minus)
+       && match(rvalue.binary->left).variable != nullptr
+       && lookup(match(rvalue.binary->left).variable->name.lexeme) == symbol) {
+
+        const bool isGlobal = symbol->depth == 0;
+        const bool isMinus = rvalue.binary->op.type == TokenType::Minus;
+
+        const std::size_t start = m_program.code.size();
+        compileExpression(rvalue.binary->right);
+
+        if(const auto value = constantValue(start); value.has_value()) {
+            truncate(start);
+
+            const std::int32_t increment = isMinus ? wrap(-static_cast<std::int64_t>(*value)) : *value;
+            emit(isGlobal ? OpCode::AddGlobalImmediate : OpCode::AddLocalImmediate, symbol->value, increment);
+            return;
+        }
+
+        if(isMinus) emit(OpCode::Negate);
+        emit(isGlobal ? OpCode::AddGlobal : OpCode::AddLocal, symbol->value);
+        return;
+    }
+
+    compileExpression(stmt->rvalue);
+    emitStore(symbol, line);
+}
+
+auto Compiler::visit(CallStatement* stmt) -> void {
+    const Symbol* procedure = lookupProcedure(stmt->callee);
+    if(procedure != nullptr) emitCall(procedure);
+}
+
+auto Compiler::visit(InputStatement* stmt) -> void {
+
+    const auto& [_, lexeme, line] = stmt->destination;
+    Symbol* symbol = lookup(lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared variable.", line, lexeme);
+        return;
+    }
+
+    if(symbol->kind != Symbol::Kind::Variable) {
+        error("[Ln: {}] Compile Error: can store data only in variables '{}'.", line, lexeme);
+        return;
+    }
+
+    if(isLoopVariable(symbol)) {
+        error("[Ln: {}] Compile Error: can't assign to the loop variable '{}'.", line, lexeme);
+        return;
+    }
+
+    if(!checkIndexing(symbol, stmt->destination, stmt->index)) return;
+
+    // The variable keeps its value when the input isn't a number, Input
+    // replaces the current value on the stack.
+    if(symbol->length > 0) {
+        if(!compileIndex(symbol, stmt->destination, stmt->index)) return;
+        emit(OpCode::Dup);
+    }
+
+    emitLoad(symbol, line);
+    emit(OpCode::Input);
+    emitStore(symbol, line);
+}
+
+auto Compiler::visit(PrintStatement* stmt) -> void {
+    compileExpression(stmt->argument);
+    emit(OpCode::Print);
+}
+
+auto Compiler::visit(BeginStatement* stmt) -> void {
+    for(auto& statement : stmt->statements) {
+        compileStatement(statement);
+    }
+}
+
+auto Compiler::visit(IfStatement* stmt) -> void {
+    const std::size_t exit = compileCondition(stmt->condition);
+    compileStatement(stmt->body);
+    patch(exit, here());
+}
+
+auto Compiler::visit(WhileStatement* stmt) -> void {
+
+    const std::int32_t start = here();
+    const std::size_t exit = compileCondition(stmt->condition);
+
+    compileStatement(stmt->body);
+    emit(OpCode::Jump, start);
+
+    patch(exit, here());
+}
+
+auto Compiler::visit(ForStatement* stmt) -> void {
+
+    const auto& [_, lexeme, line] = stmt->variable;
+    Symbol* symbol = lookup(lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared variable.", line, lexeme);
+        return;
+    }
+
+    if(symbol->kind != Symbol::Kind::Variable) {
+        error("[Ln: {}] Compile Error: the loop variable '{}' must be a variable.", line, lexeme);
+        return;
+    }
+
+    if(isLoopVariable(symbol)) {
+        error("[Ln: {}] Compile Error: '{}' is already the variable of an enclosing loop.", line, lexeme);
+        return;
+    }
+
+    if(symbol->length > 0) {
+        error("[Ln: {}] Compile Error: the loop variable '{}' can't be an array.", line, lexeme);
+        return;
+    }
+
+    std::optional<std::int32_t> step = 1;
+
+    if(stmt->step != nullptr) {
+        const std::size_t start = m_program.code.size();
+        compileExpression(stmt->step);
+
+        step = constantValue(start);
+        truncate(start);
+    }
+
+    if(!step.has_value() || *step == 0) {
+        error("[Ln: {}] Compile Error: the step of the loop must be a constant other than 0.", line);
+        return;
+    }
+
+    compileExpression(stmt->from);
+    compileExpression(stmt->to);
+
+    // { value, iterations left }
+    const std::int32_t slot = allocateSlots(2);
+
+    emit(OpCode::ForInit, slot, *step, 0);
+    const std::size_t exit = lastOperand();
+
+    // The value of the iteration is on the stack.
+    const std::int32_t body = here();
+    emitStore(symbol, line);
+
+    m_loopVariables.push_back(symbol);
+    compileStatement(stmt->body);
+    m_loopVariables.pop_back();
+
+    emit(OpCode::ForNext, slot, *step, body);
+    patch(exit, here());
+}
+
+auto Compiler::visit(ParallelStatement* stmt) -> void {
+
+    // The calls run one after the other, a valid schedule of the block.
+    for(auto& call : stmt->calls) {
+        const auto* callStatement = static_cast<const CallStatement*>(call.get());
+
+        const Symbol* procedure = lookupProcedure(callStatement->callee);
+        if(procedure != nullptr) emitCall(procedure);
+    }
+}
+
+auto Compiler::visit(OddExpression* expr) -> void {
+
+    if(m_match != nullptr) return;
+
+    const std::size_t start = m_program.code.size();
+    compileExpression(expr->expr);
+
+    if(const auto value = constantValue(start); value.has_value()) {
+        truncate(start);
+        emit(OpCode::Push, *value % 2 != 0);
+        return;
+    }
+
+    emit(OpCode::Odd);
+}
+
+auto Compiler::visit(BinaryExpression* expr) -> void {
+
+    if(m_match != nullptr) {
+        m_match->binary = expr;
+        return;
+    }
+
+    const std::size_t start = m_program.code.size();
+    compileExpression(expr->left);
+
+    const auto left = constantValue(start);
+    const std::size_t rightStart = m_program.code.size();
+
+    compileExpression(expr->right);
+
+    const auto right = constantValue(rightStart);
+    const TokenType op = expr->op.type;
+
+    if(left.has_value() && right.has_value()) {
+        const std::int64_t a = *left;
+        const std::int64_t b = *right;
+
+        std::optional<std::int32_t> value;
+
+        switch(op) {
+            case TokenType::Plus: value = wrap(a + b); break;
+            case TokenType::Minus: value = wrap(a - b); break;
+            case TokenType::Star: value = wrap(a * b); break;
+            case TokenType::Slash:
+                // Left to the runtime error.
+                if(b != 0 && !(a == std::numeric_limits<std::int32_t>::min() && b == -1)) value = wrap(a / b);
+                break;
+            case TokenType::Equal: value = a == b; break;
+            case TokenType::NotEqual: value = a != b; break;
+            case TokenType::Less: value = a < b; break;
+            case TokenType::LessEqual: value = a <= b; break;
+            case TokenType::Greater: value = a > b; break;
+            case TokenType::GreaterEqual: value = a >= b; break;
+            default: break;
+        }
+
+        if(value.has_value()) {
+            truncate(start);
+            emit(OpCode::Push, *value);
+            return;
+        }
+    }
+
+    if(right.has_value() && (op == TokenType::Plus || op == TokenType::Minus)) {
+        truncate(rightStart);
+        emit(OpCode::AddImmediate, op == TokenType::Plus ? *right : wrap(-static_cast<std::int64_t>(*right)));
+        return;
+    }
+
+    switch(op) {
+        case TokenType::Plus: emit(OpCode::Add); break;
+        case TokenType::Minus: emit(OpCode::Sub); break;
+        case TokenType::Star: emit(OpCode::Mul); break;
+        case TokenType::Slash: emit(OpCode::Div, expr->op.line); break;
+        case TokenType::Equal: emit(OpCode::Equal); break;
+        case TokenType::NotEqual: emit(OpCode::NotEqual); break;
+        case TokenType::Less: emit(OpCode::Less); break;
+        case TokenType::LessEqual: emit(OpCode::LessEqual); break;
+        case TokenType::Greater: emit(OpCode::Greater); break;
+        case TokenType::GreaterEqual: emit(OpCode::GreaterEqual); break;
+        default:
+            error("[Ln: {}] Compile Error: '{}' is an invalid binary operator.", expr->op.line, expr->op.lexeme);
+            break;
+    }
+}
+
+auto Compiler::visit(UnaryExpression* expr) -> void {
+
+    if(m_match != nullptr) return;
+
+    const std::size_t start = m_program.code.size();
+    compileExpression(expr->right);
+
+    if(expr->op.type != TokenType::Minus) return;
+
+    if(const auto value = constantValue(start); value.has_value()) {
+        truncate(start);
+        emit(OpCode::Push, wrap(-static_cast<std::int64_t>(*value)));
+        return;
+    }
+
+    emit(OpCode::Negate);
+}
+
+auto Compiler::visit(VariableExpression* expr) -> void {
+
+    if(m_match != nullptr) {
+        m_match->variable = expr;
+        return;
+    }
+
+    const auto& [_, lexeme, line] = expr->name;
+    const Symbol* symbol = lookup(lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: undeclared variable '{}'.", line, lexeme);
+        return;
+    }
+
+    switch(symbol->kind) {
+        case Symbol::Kind::Constant:
+            emit(OpCode::Push, symbol->value);
+            break;
+        case Symbol::Kind::Variable:
+            if(checkIndexing(symbol, expr->name, nullptr)) emitLoad(symbol, line);
+            break;
+        case Symbol::Kind::Procedure:
+            error("[Ln: {}] Compile Error: functions are not first class objects.", line);
+            break;
+    }
+}
+
+auto Compiler::visit(IndexExpression* expr) -> void {
+
+    if(m_match != nullptr) return;
+
+    const auto& [_, lexeme, line] = expr->name;
+    const Symbol* symbol = lookup(lexeme);
+
+    if(symbol == nullptr) {
+        error("[Ln: {}] Compile Error: undeclared variable '{}'.", line, lexeme);
+        return;
+    }
+
+    if(symbol->kind != Symbol::Kind::Variable) {
+        error("[Ln: {}] Compile Error: '{}' is not an array.", line, lexeme);
+        return;
+    }
+
+    if(!checkIndexing(symbol, expr->name, expr->index)) return;
+    if(!compileIndex(symbol, expr->name, expr->index)) return;
+
+    emitLoad(symbol, line);
+}
+
+auto Compiler::visit(LiteralExpression* expr) -> void {
+    if(m_match != nullptr) return;
+    emit(OpCode::Push, expr->value);
+}
+
+}
@@ -0,0 +1,281 @@
+#ifndef _BYTECODE_HPP_
+#define _BYTECODE_HPP_
+
+#include "ast.hpp"
+#include "errors_holder_trait.hpp"
+#include "os.hpp"
+
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pl0::bytecode {
+
+using namespace ast;
+using namespace error;
+
+/*
+
+Stack based bytecode run by the interpreter (-interp). An instruction is
+an opcode followed by its operands, every word is an int32.
+
+Memory is a vector of integers: the globals are at the start, the frames of
+the active procedures follow. The first slot of a frame is the static link,
+the index of the frame of the enclosing procedure. Frames are zeroed when
+they are pushed.
+
+Locals of the enclosing procedures are reached following `levels` static
+links. Arrays are `length` contiguous slots, the index is popped from the
+stack and checked.
+
+*/
+enum class OpCode : std::uint8_t {
+    Push,                   // value
+    Dup,
+
+    LoadGlobal,             // address
+    StoreGlobal,            // address
+    LoadLocal,              // slot
+    StoreLocal,             // slot
+    LoadOuter,              // levels, slot
+    StoreOuter,             // levels, slot
+
+    LoadGlobalElement,      // address, length, line
+    StoreGlobalElement,     // address, length, line
+    LoadLocalElement,       // slot, length, line
+    StoreLocalElement,      // slot, length, line
+    LoadOuterElement,       // levels, slot, length, line
+    StoreOuterElement,      // levels, slot, length, line
+
+    Add,
+    Sub,
+    Mul,
+    Div,                    // line
+    Negate,
+    Odd,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+
+    // Superinstructions.
+    AddImmediate,           // value
+    AddGlobal,              // address: x := x + e
+    AddLocal,               // slot
+    AddGlobalImmediate,     // address, value: x := x + n
+    AddLocalImmediate,      // slot, value
+    JumpUnlessEqual,        // target: compare and branch
+    JumpUnlessNotEqual,     // target
+    JumpUnlessLess,         // target
+    JumpUnlessLessEqual,    // target
+    JumpUnlessGreater,      // target
+    JumpUnlessGreaterEqual, // target
+
+    Jump,                   // target
+    JumpIfFalse,            // target
+
+    // Counted loops, the value and the iterations left live in 2 slots.
+    ForInit,                // slot, step, exit target
+    ForNext,                // slot, step, body target
+
+    Call,                   // procedure, levels
+    TailCall,               // procedure, levels
+    Return,
+
+    Print,
+    Input,
+
+    Halt,
+
+    Count
+};
+
+[[nodiscard]]
+auto operandCount(OpCode opcode) -> std::uint32_t;
+
+[[nodiscard]]
+auto opcodeName(OpCode opcode) -> std::string_view;
+
+struct Procedure {
+    std::string name;
+
+    std::uint32_t entry;
+    std::uint32_t frameSize;
+
+    // Index of the enclosing procedure, 0 for the top level ones and main.
+    std::uint32_t parent = 0;
+};
+
+struct Global {
+    std::string name;
+    std::uint32_t address;
+};
+
+struct Program {
+    std::vector<std::int32_t> code;
+
+    // The main program is the procedure 0.
+    std::vector<Procedure> procedures;
+
+    std::uint32_t globals = 0;
+
+    // The global variables by name, to share them with native code.
+    std::vector<Global> variables;
+};
+
+// Prints the instructions, one per line.
+auto disassemble(const Program& program) -> void;
+
+class Compiler final : public AstVisitor,
+                       public ErrorsHolderTrait {
+public:
+    Compiler() = default;
+
+    [[nodiscard]]
+    auto compile(StatementPtr& program) -> Program;
+
+private:
+
+    struct Symbol {
+        enum class Kind : std::uint8_t { Constant, Variable, Procedure };
+
+        Kind kind;
+        std::uint32_t depth;
+
+        // Constant value, slot (address of the globals) or procedure index.
+        std::int32_t value;
+
+        // 0 for scalars.
+        std::uint32_t length = 0;
+    };
+
+    auto visit(Block* block) -> void;
+    auto visit(ConstDeclarations* decl) -> void;
+    auto visit(VariableDeclarations* decl) -> void;
+    auto visit(ProcedureDeclaration* decl) -> void;
+
+    auto visit(AssignStatement* stmt) -> void;
+    auto visit(CallStatement* stmt) -> void;
+    auto visit(InputStatement* stmt) -> void;
+    auto visit(PrintStatement* stmt) -> void;
+    auto visit(BeginStatement* stmt) -> void;
+    auto visit(IfStatement* stmt) -> void;
+    auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
+
+    auto visit(OddExpression* expr) -> void;
+    auto visit(BinaryExpression* expr) -> void;
+    auto visit(UnaryExpression* expr) -> void;
+    auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
+    auto visit(LiteralExpression* expr) -> void;
+
+    inline auto compileStatement(StatementPtr& stmt) -> void {
+        if(stmt != nullptr) os::withStack([&] { stmt->accept(this); });
+    }
+
+    auto compileExpression(ExpressionPtr& expr) -> void;
+
+    // Jumps to the returned operand, to be patched, when `condition` is false.
+    auto compileCondition(ExpressionPtr& condition) -> std::size_t;
+
+    // Operations on constants are folded while they are compiled: the
+    // value of the code emitted from `start`, if it's a single push.
+    auto constantValue(std::size_t start) const -> std::optional<std::int32_t>;
+
+    // Drops the code emitted from `start`.
+    auto truncate(std::size_t start) -> void;
+
+    // The node of an expression, without compiling it.
+    struct Match {
+        BinaryExpression* binary = nullptr;
+        VariableExpression* variable = nullptr;
+    };
+
+    auto match(ExpressionPtr& expr) -> Match;
+
+    auto lookup(std::string_view name) -> Symbol*;
+    auto lookupProcedure(const Token& callee) -> Symbol*;
+
+    auto isLoopVariable(const Symbol* symbol) const -> bool;
+
+    // Checks that `symbol` is (not) an array when it's (not) indexed.
+    auto checkIndexing(const Symbol* symbol, const Token& name, const ExpressionPtr& index) -> bool;
+
+    // Compiles an index, reporting the constant ones out of bounds.
+    auto compileIndex(const Symbol* symbol, const Token& name, ExpressionPtr& index) -> bool;
+
+    // Loads and stores of a variable, the index is already on the stack.
+    auto emitLoad(const Symbol* symbol, std::uint32_t line) -> void;
+    auto emitStore(const Symbol* symbol, std::uint32_t line) -> void;
+
+    auto emitCall(const Symbol* procedure) -> void;
+
+    inline auto depth() const -> std::uint32_t {
+        return static_cast<std::uint32_t>(m_frames.size()) - 1;
+    }
+
+    // Allocates `count` slots in the frame of the current procedure.
+    auto allocateSlots(std::uint32_t count) -> std::int32_t;
+
+    inline auto emit(OpCode opcode) -> void {
+        m_lastInstruction = m_program.code.size();
+        m_program.code.push_back(static_cast<std::int32_t>(opcode));
+    }
+
+    template<typename... Operands>
+    inline auto emit(OpCode opcode, Operands... operands) -> void {
+        emit(opcode);
+        (m_program.code.push_back(static_cast<std::int32_t>(operands)), ...);
+    }
+
+    // Position of the last operand, the target of a jump just emitted.
+    inline auto lastOperand() const -> std::size_t {
+        return m_program.code.size() - 1;
+    }
+
+    inline auto here() const -> std::int32_t {
+        return static_cast<std::int32_t>(m_program.code.size());
+    }
+
+    inline auto patch(std::size_t operand, std::int32_t target) -> void {
+        m_program.code[operand] = target;
+    }
+
+    template<typename... Args>
+    inline auto error(std::string_view fmt, Args&&... args) -> void {
+        pushError(std::vformat(fmt, std::make_format_args(args...)));
+    }
+
+private:
+    Program m_program;
+
+    std::vector<std::unordered_map<std::string_view, Symbol>> m_scopes;
+
+    struct Frame {
+        std::uint32_t procedure;
+        std::uint32_t size;
+    };
+
+    // Frames of the procedures enclosing the code being compiled.
+    std::vector<Frame> m_frames;
+
+    // Variables of the for loops being compiled, they are read-only.
+    std::vector<const Symbol*> m_loopVariables;
+
+    std::size_t m_lastInstruction = 0;
+
+    // Set while matching an expression.
+    Match* m_match = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include "cache.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace pl0::cache {
+
+using namespace llvm;
+
+namespace {
+
+// The last byte is the version of the entries layout.
+constexpr char MAGIC[8] = {'P', 'L', '0', 'O', 'B', 'J', '\0', '1'};
+
+struct Header {
+    char magic[8];
+    std::uint8_t key[32];
+    std::uint64_t size;
+    std::uint64_t checksum;
+};
+
+}
+
+auto defaultDirectory() -> std::string {
+
+    if(const char* directory = std::getenv("PL0_CACHE_DIR")) {
+        return directory;
+    }
+
+    SmallString<128> directory;
+    if(!sys::path::cache_directory(directory)) return {};
+
+    sys::path::append(directory, "pl0");
+    return std::string(directory);
+}
+
+DiskCache::DiskCache(std::string directory, std::string target)
+    : m_directory(std::move(directory)), m_target(std::move(target)) {}
+
+auto DiskCache::key(const Module* module) const -> Key {
+
+    std::string text;
+    raw_string_ostream stream(text);
+
+    // Another LLVM can generate other code from the same IR.
+    stream << LLVM_VERSION_STRING << '\n' << m_target << '\n';
+    module->print(stream, nullptr);
+    stream.flush();
+
+    return SHA256::hash(arrayRefFromStringRef(text));
+}
+
+auto DiskCache::path(const Key& key) const -> std::string {
+    SmallString<128> path(m_directory);
+    sys::path::append(path, toHex(key, true) + ".o");
+
+    return std::string(path);
+}
+
+auto DiskCache::getObject(const Module* module) -> std::unique_ptr<MemoryBuffer> {
+
+    const Key key = this->key(module);
+    const std::string path = this->path(key);
+
+    auto file = MemoryBuffer::getFile(path, false, false);
+
+    if(!file) {
+        m_misses[module] = key;
+        return nullptr;
+    }
+
+    const StringRef entry = (*file)->getBuffer();
+    StringRef object;
+
+    Header header;
+    bool isValid = entry.size() >= sizeof(Header);
+
+    if(isValid) {
+        std::memcpy(&header, entry.data(), sizeof(Header));
+        object = entry.drop_front(sizeof(Header));
+
+        isValid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+            && std::memcmp(header.key, key.data(), key.size()) == 0
+            && header.size == object.size()
+            && header.checksum == xxHash64(object);
+    }
+
+    if(!isValid) {
+        sys::fs::remove(path);
+        m_misses[module] = key;
+        return nullptr;
+    }
+
+    return MemoryBuffer::getMemBufferCopy(object, path);
+}
+
+auto DiskCache::notifyObjectCompiled(const Module* module, MemoryBufferRef object) -> void {
+
+    Key key;
+
+    if(const auto miss = m_misses.find(module); miss != m_misses.end()) {
+        key = miss->second;
+        m_misses.erase(miss);
+    } else {
+        key = this->key(module);
+    }
+
+    if(sys::fs::create_directories(m_directory)) return;
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    std::memcpy(header.key, key.data(), key.size());
+    header.size = object.getBufferSize();
+    header.checksum = xxHash64(object.getBuffer());
+
+    const std::string path = this->path(key);
+
+    // Written aside and renamed, so other runs never read half an entry.
+    SmallString<128> temporary;
+    int fd;
+
+    if(sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, temporary)) return;
+
+    raw_fd_ostream stream(fd, true);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    stream << object.getBuffer();
+    stream.close();
+
+    if(stream.has_error()) {
+        stream.clear_error();
+        sys::fs::remove(temporary);
+        return;
+    }
+
+    if(sys::fs::rename(temporary, path)) {
+        sys::fs::remove(temporary);
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef _CACHE_HPP_
+#define _CACHE_HPP_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace pl0::cache {
+
+// $PL0_CACHE_DIR, or pl0 in the user cache directory. Empty if unknown.
+auto defaultDirectory() -> std::string;
+
+/*
+
+Objects compiled in process, stored on disk to skip the optimizer and the
+backend in the next runs. The key is the hash of the module, before the
+optimization, plus `target`: CPU, features and optimization level.
+
+An entry is a header (magic, key, size and checksum of the object) and the
+object. Entries with a different header are stale or corrupt: they are
+removed and compiled again.
+
+*/
+class DiskCache final : public llvm::ObjectCache {
+public:
+    DiskCache(std::string directory, std::string target);
+
+    auto notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) -> void override;
+    auto getObject(const llvm::Module* module) -> std::unique_ptr<llvm::MemoryBuffer> override;
+
+private:
+    using Key = std::array<std::uint8_t, 32>;
+
+    auto key(const llvm::Module* module) const -> Key;
+    auto path(const Key& key) const -> std::string;
+
+private:
+    std::string m_directory;
+    std::string m_target;
+
+    // Keys of the modules missing in the cache, computed before the
+    // optimization changes them.
+    llvm::DenseMap<const llvm::Module*, Key> m_misses;
+};
+
+}
+
+#endif
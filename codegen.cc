@@ -1,7 +1,15 @@
 #include "codegen.hpp"
+#include "memstats.hpp"
 #include "os.hpp"
+#include "peephole.hpp"
+#include "timing.hpp"
 
+#include "runtime/pl0rt.h"
+
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/BinaryFormat/Dwarf.h"
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -9,16 +17,28 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Metadata.h"
 
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include <charconv>
 #include <string_view>
 #include <system_error>
 
@@ -26,6 +46,24 @@ namespace pl0::codegen {
 
 using token::TokenType;
 
+auto hostCpuName() -> std::string {
+    return sys::getHostCPUName().str();
+}
+
+auto hostCpuFeatures() -> std::string {
+
+    SubtargetFeatures features;
+    StringMap<bool> available;
+
+    if(sys::getHostCPUFeatures(available)) {
+        for(const auto& feature : available) {
+            features.AddFeature(feature.getKey(), feature.getValue());
+        }
+    }
+
+    return features.getString();
+}
+
 CodeGenerator::CodeGenerator(std::string_view moduleName)
     : m_moduleName(moduleName) {
     m_module = std::make_unique<Module>(moduleName, m_context);
@@ -51,15 +89,80 @@ CodeGenerator::CodeGenerator(std::string_view moduleName)
 
 }
 
+auto CodeGenerator::setDebugInfo(std::string_view sourcePath) -> void {
+
+    m_debugBuilder = std::make_unique<DIBuilder>(*m_module);
+
+    SmallString<128> path(sourcePath);
+    sys::fs::make_absolute(path);
+
+    m_debugFile = m_debugBuilder->createFile(sys::path::filename(path), sys::path::parent_path(path));
+
+    m_debugBuilder->createCompileUnit(dwarf::DW_LANG_Pascal83, m_debugFile, "pl0", m_optimizationLevel > 0,
+                                      "", 0, "", DICompileUnit::LineTablesOnly);
+
+    m_module->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+    m_module->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+
+    m_mainSubprogram = createSubprogram(m_module->getFunction("main"), "main", 1);
+    setLocation(1);
+}
+
+auto CodeGenerator::createSubprogram(Function* function, std::string_view name, std::uint32_t line) -> DISubprogram* {
+
+    DISubroutineType* type = m_debugBuilder->createSubroutineType(m_debugBuilder->getOrCreateTypeArray({}));
+
+    DISubprogram::DISPFlags flags = DISubprogram::SPFlagDefinition;
+    if(function->hasLocalLinkage()) flags |= DISubprogram::SPFlagLocalToUnit;
+
+    DISubprogram* subprogram = m_debugBuilder->createFunction(m_debugFile, name, function->getName(), m_debugFile,
+                                                              line, type, line, DINode::FlagZero, flags);
+    function->setSubprogram(subprogram);
+
+    return subprogram;
+}
+
 auto CodeGenerator::generate(StatementPtr& ast) -> bool {
 
-    codegenStatement(ast);
-    endProgram();
+    {
+        timing::Phase phase("codegen");
+        m_captures.analyze(ast);
+        m_effects.setFindConcurrentCalls(m_autoParallel);
+        m_effects.analyze(ast);
+        if(m_eliminateDeadProcedures) m_callGraph.analyze(ast);
+
+        codegenStatement(ast);
+        endProgram();
 
+        // Only the dead procedures call each other.
+        for(Function* function : m_deadFunctions) function->dropAllReferences();
+        for(Function* function : m_deadFunctions) function->eraseFromParent();
+    }
+
+    timing::Phase phase("verify");
     return !verifyModule(*m_module, &errs());
 }
 
-auto CodeGenerator::produceObjectFile() -> void {      
+auto CodeGenerator::generate(parser::Parser& parser) -> bool {
+
+    {
+        timing::Phase phase("one-pass");
+        m_onePass = true;
+
+        parser.setEmitter(this);
+        parser.parseProgram();
+
+        if(parser.hadError()) return false;
+        endProgram();
+    }
+
+    timing::Phase phase("verify");
+    return !verifyModule(*m_module, &errs());
+}
+
+auto CodeGenerator::initializeTarget() -> bool {
+
+    if(m_targetMachine != nullptr) return true;
 
     const std::string& targetTriple = llvm::sys::getDefaultTargetTriple();
     
@@ -74,15 +177,89 @@ auto CodeGenerator::produceObjectFile() -> void {
 
     if(target == nullptr) {
         errs() << error;
-        return;
+        return false;
     }
 
+    static constexpr CodeGenOpt::Level codegenLevels[] = {
+        CodeGenOpt::None,
+        CodeGenOpt::Less,
+        CodeGenOpt::Default,
+        CodeGenOpt::Aggressive
+    };
+
+    const std::string cpu = m_hostTarget ? hostCpuName() : "generic";
+    const std::string features = m_hostTarget ? hostCpuFeatures() : "";
+
     TargetOptions opt;
-    TargetMachine* targetMachine = target->createTargetMachine(targetTriple, "generic", "", opt, Reloc::PIC_);
+    m_targetMachine.reset(target->createTargetMachine(targetTriple, cpu, features, opt, Reloc::PIC_,
+                                                      std::nullopt, codegenLevels[m_optimizationLevel]));
 
-    m_module->setDataLayout(targetMachine->createDataLayout());
+    m_module->setDataLayout(m_targetMachine->createDataLayout());
     m_module->setTargetTriple(targetTriple);
 
+    return true;
+}
+
+auto CodeGenerator::optimize() -> void {
+
+    if(!initializeTarget()) return;
+
+    LoopAnalysisManager loopAnalysis;
+    FunctionAnalysisManager functionAnalysis;
+    CGSCCAnalysisManager cgsccAnalysis;
+    ModuleAnalysisManager moduleAnalysis;
+
+    // The time profiler of -trace records every pass through them.
+    PassInstrumentationCallbacks instrumentation;
+    StandardInstrumentations standardInstrumentations(m_module->getContext(), false);
+    standardInstrumentations.registerCallbacks(instrumentation, &moduleAnalysis);
+
+    PassBuilder builder(m_targetMachine.get(), PipelineTuningOptions(), std::nullopt, &instrumentation);
+
+    builder.registerModuleAnalyses(moduleAnalysis);
+    builder.registerCGSCCAnalyses(cgsccAnalysis);
+    builder.registerFunctionAnalyses(functionAnalysis);
+    builder.registerLoopAnalyses(loopAnalysis);
+    builder.crossRegisterProxies(loopAnalysis, functionAnalysis, cgsccAnalysis, moduleAnalysis);
+
+    static const OptimizationLevel levels[] = {
+        OptimizationLevel::O0,
+        OptimizationLevel::O1,
+        OptimizationLevel::O2,
+        OptimizationLevel::O3
+    };
+
+    const OptimizationLevel& level = levels[m_optimizationLevel];
+
+    builder.registerPipelineStartEPCallback([](ModulePassManager& passes, OptimizationLevel) {
+        passes.addPass(createModuleToFunctionPassAdaptor(peephole::PeepholePass()));
+    });
+
+    ModulePassManager passes = m_optimizationLevel == 0
+        ? builder.buildO0DefaultPipeline(level)
+        : builder.buildPerModuleDefaultPipeline(level);
+
+    passes.run(*m_module, moduleAnalysis);
+}
+
+auto CodeGenerator::emitObject(raw_pwrite_stream& stream) -> bool {
+
+    legacy::PassManager pass;
+    CodeGenFileType fileType = CodeGenFileType::ObjectFile;
+
+    if (m_targetMachine->addPassesToEmitFile(pass, stream, nullptr, fileType)) {
+        errs() << "TargetMachine can't emit a file of this type";
+        return false;
+    }
+
+    pass.run(*m_module);
+    return true;
+}
+
+auto CodeGenerator::produceObjectFile() -> void {      
+
+    if(!initializeTarget()) return;
+
     std::error_code streamErrorCode;
     llvm::raw_fd_ostream stream(m_moduleName + ".o", streamErrorCode, sys::fs::OF_None);
 
@@ -91,16 +268,92 @@ auto CodeGenerator::produceObjectFile() -> void {
         return;
     }
 
-    legacy::PassManager pass;
-    CodeGenFileType fileType = CodeGenFileType::ObjectFile;
+    if(emitObject(stream)) stream.flush();
+}
 
-    if (targetMachine->addPassesToEmitFile(pass, stream, nullptr, fileType)) {
-        errs() << "TargetMachine can't emit a file of this type";
-        return;
+auto CodeGenerator::produceObjectBuffer() -> std::unique_ptr<MemoryBuffer> {
+
+    if(!initializeTarget()) return nullptr;
+
+    SmallVector<char, 0> object;
+    raw_svector_ostream stream(object);
+
+    if(!emitObject(stream)) return nullptr;
+
+    auto buffer = std::make_unique<SmallVectorMemoryBuffer>(std::move(object), m_moduleName, false);
+
+    if(m_objectCache != nullptr) {
+        m_objectCache->notifyObjectCompiled(m_module.get(), buffer->getMemBufferRef());
     }
 
-    pass.run(*m_module);
-    stream.flush();
+    return buffer;
+}
+
+auto CodeGenerator::cachedObject() -> std::unique_ptr<MemoryBuffer> {
+
+    // The target triple and data layout are part of the module.
+    if(m_objectCache == nullptr || !initializeTarget()) return nullptr;
+
+    return m_objectCache->getObject(m_module.get());
+}
+
+auto CodeGenerator::reachableFunctions(Function* procedure) const -> SmallPtrSet<Function*, 8> {
+
+    SmallVector<Function*, 8> worklist = {procedure};
+    SmallPtrSet<Function*, 8> reached = {procedure};
+
+    while(!worklist.empty()) {
+        Function* function = worklist.pop_back_val();
+
+        for(const auto& block : *function) {
+            for(const auto& instruction : block) {
+                const auto* call = dyn_cast<CallBase>(&instruction);
+                if(call == nullptr) continue;
+
+                Function* callee = call->getCalledFunction();
+
+                if(callee != nullptr && reached.insert(callee).second) {
+                    worklist.push_back(callee);
+                }
+            }
+        }
+    }
+
+    return reached;
+}
+
+auto CodeGenerator::isStandalone(std::string_view name) const -> bool {
+
+    Function* procedure = m_module->getFunction(name);
+    if(procedure == nullptr || !procedure->arg_empty()) return false;
+
+    // The runtime library isn't linked in the compiler.
+    for(const Function* function : reachableFunctions(procedure)) {
+        if(function->getName().starts_with("pl0rt_")) return false;
+    }
+
+    return true;
+}
+
+auto CodeGenerator::extractProcedure(std::string_view name) -> void {
+
+    Function* procedure = m_module->getFunction(name);
+    procedure->setLinkage(GlobalValue::ExternalLinkage);
+
+    // Also at -O0, the object mustn't refer to what the procedure doesn't use.
+    const auto reached = reachableFunctions(procedure);
+    std::vector<Function*> unreached;
+
+    for(Function& function : *m_module) {
+        if(function.isDeclaration() || reached.contains(&function)) continue;
+
+        function.dropAllReferences();
+        unreached.push_back(&function);
+    }
+
+    for(Function* function : unreached) {
+        function->eraseFromParent();
+    }
 }
 
 auto CodeGenerator::produceExecutable() -> bool {
@@ -114,26 +367,446 @@ auto CodeGenerator::produceExecutable() -> bool {
     #error Unsupported compiler
 #endif
     
-    char* const args[] = {
+    std::vector<char*> args = {
         const_cast<char*>(compilerName), 
         const_cast<char*>(objectFile.c_str()), 
         const_cast<char*>("-o"), 
         const_cast<char*>(m_moduleName.c_str()),
-        nullptr,
     };
 
-    return os::spawnProcess(compilerName, args) == 0;
+    // The runtime library is built next to the compiler.
+    std::string runtime;
+
+    if(m_module->getFunction("pl0rt_parallel") != nullptr || m_module->getFunction("pl0rt_profile_start") != nullptr) {
+        runtime = os::executableDirectory() + "/runtime/libpl0rt.a";
+
+        args.push_back(runtime.data());
+        args.push_back(const_cast<char*>("-pthread"));
+    }
+
+    args.push_back(nullptr);
+
+    return os::spawnProcess(compilerName, args.data()) == 0;
 }
 
 auto CodeGenerator::endProgram() -> void {
     m_builder.CreateRet(getIntegerConstant(0));
 
+    if(m_profileRuntime) emitProfile();
+
+    if(m_debugBuilder != nullptr) {
+        // perf and the unwinders walk the stack through the frame pointers.
+        for(Function& function : *m_module) {
+            if(!function.isDeclaration()) function.addFnAttr("frame-pointer", "all");
+        }
+
+        m_debugBuilder->finalize();
+    }
+
     if(verifyFunction(*m_builder.GetInsertBlock()->getParent())) {
         error("Compile Error: unable to compile the program.");
     }
 }
 
+auto CodeGenerator::mangle(std::string_view name) const -> std::string {
+
+    std::string mangled = "pl0.";
+
+    for(const auto& procedure : m_procedures) {
+        mangled += procedure.name;
+        mangled += '.';
+    }
+
+    return mangled += name;
+}
+
+auto CodeGenerator::getFrame(std::uint32_t depth) -> Value* {
+
+    if(depth == this->depth()) {
+        return m_procedures.back().frame;
+    }
+
+    // Every procedure between the current one and the one at `depth` has
+    // the static link, stored in the first field of its frame.
+    Value* frame = m_procedures.back().staticLink;
+
+    for(std::uint32_t level = this->depth() - 1; level > depth; level--) {
+        StructType* frameType = m_procedures[level - 1].frameType;
+        Value* link = m_builder.CreateStructGEP(frameType, frame, 0, "static_link_addr");
+        frame = m_builder.CreateLoad(getPointerType(), link, "static_link");
+    }
+
+    return frame;
+}
+
+auto CodeGenerator::getVariableAddress(SymbolEntry* entry) -> Value* {
+
+    if(!entry->isCaptured()) {
+        return entry->variable();
+    }
+
+    const auto [depth, index] = entry->frameSlot();
+    StructType* frameType = m_procedures[depth - 1].frameType;
+
+    return m_builder.CreateStructGEP(frameType, getFrame(depth), index);
+}
+
+auto CodeGenerator::getElementAddress(SymbolEntry* entry, const Token& name, ExpressionPtr& index) -> Value* {
+
+    if(!entry->isArray()) {
+        error("[Ln: {}] Compile Error: '{}' is not an array.", name.line, name.lexeme);
+        return nullptr;
+    }
+
+    if(index == nullptr) {
+        error("[Ln: {}] Compile Error: the array '{}' must be indexed.", name.line, name.lexeme);
+        return nullptr;
+    }
+
+    Value* position = codegenExpression(index);
+    if(position == nullptr) return nullptr;
+
+    const std::uint32_t length = entry->length();
+
+    // Compared unsigned, negative indices are out of bounds too. The check
+    // is folded away when the index is a constant or the optimizer can
+    // bound it, e.g. with the variable of a counted loop.
+    Value* isInBounds = m_builder.CreateICmpULT(position, getIntegerConstant(length), "in_bounds");
+
+    auto* known = dyn_cast<ConstantInt>(isInBounds);
+
+    if(known != nullptr && known->isZero()) {
+        error("[Ln: {}] Compile Error: index {} out of bounds of '{}', its length is {}.",
+              name.line, cast<ConstantInt>(position)->getSExtValue(), name.lexeme, length);
+        return nullptr;
+    }
+
+    if(known == nullptr) {
+        Function* function = m_builder.GetInsertBlock()->getParent();
+
+        BasicBlock* errorBlock = BasicBlock::Create(m_context, "index_error", function);
+        BasicBlock* continueBlock = BasicBlock::Create(m_context, "index_ok", function);
+
+        m_builder.CreateCondBr(isInBounds, continueBlock, errorBlock,
+                               MDBuilder(m_context).createBranchWeights(1 << 20, 1));
+
+        m_builder.SetInsertPoint(errorBlock);
+        m_builder.CreateCall(getIndexErrorFunction(), {getIntegerConstant(name.line), position, getIntegerConstant(length)});
+        m_builder.CreateUnreachable();
+
+        m_builder.SetInsertPoint(continueBlock);
+    }
+
+    ArrayType* arrayType = ArrayType::get(getIntegerType(), length);
+    Value* offset = m_builder.CreateZExt(position, m_builder.getInt64Ty(), "offset");
+
+    return m_builder.CreateInBoundsGEP(arrayType, getVariableAddress(entry), {m_builder.getInt64(0), offset}, name.lexeme);
+}
+
+auto CodeGenerator::getIndexErrorFunction() -> Function* {
+
+    if(Function* function = m_module->getFunction("pl0.index_error")) {
+        return function;
+    }
+
+    // void (line, index, length)
+    FunctionType* type = FunctionType::get(m_builder.getVoidTy(),
+                                           {getIntegerType(), getIntegerType(), getIntegerType()},
+                                           false);
+
+    Function* function = Function::Create(type, Function::InternalLinkage, "pl0.index_error", m_module.get());
+
+    function->setDoesNotReturn();
+    function->addFnAttr(Attribute::Cold);
+    function->addFnAttr(Attribute::NoInline);
+
+    IRBuilder<> builder(BasicBlock::Create(m_context, "entry", function));
+
+    Value* format = builder.CreateGlobalStringPtr("[Ln: %d] Runtime Error: index %d out of bounds, the length is %d.\n",
+                                                  "__index_error_fmt");
+
+    builder.CreateCall(m_module->getFunction("printf"), {format, function->getArg(0), function->getArg(1), function->getArg(2)});
+
+    FunctionCallee exit = m_module->getOrInsertFunction("exit", builder.getVoidTy(), getIntegerType());
+    builder.CreateCall(exit, {getIntegerConstant(1)});
+    builder.CreateUnreachable();
+
+    return function;
+}
+
+auto CodeGenerator::createDivision(Value* left, Value* right, std::uint32_t line) -> Value* {
+
+    // A constant divisor needs no check, the division stays speculatable.
+    auto* constant = dyn_cast<ConstantInt>(right);
+
+    if(constant != nullptr && constant->isMinusOne()) {
+        return m_builder.CreateSub(getIntegerConstant(0), left, "negtmp");
+    }
+
+    if(constant != nullptr && !constant->isZero()) {
+        return m_builder.CreateSDiv(left, right, "divtmp");
+    }
+
+    Function* function = m_builder.GetInsertBlock()->getParent();
+
+    BasicBlock* errorBlock = BasicBlock::Create(m_context, "division_error", function);
+    BasicBlock* continueBlock = BasicBlock::Create(m_context, "division_ok", function);
+
+    Value* isZero = m_builder.CreateICmpEQ(right, getIntegerConstant(0), "is_zero");
+    m_builder.CreateCondBr(isZero, errorBlock, continueBlock, MDBuilder(m_context).createBranchWeights(1, 1 << 20));
+
+    m_builder.SetInsertPoint(errorBlock);
+    m_builder.CreateCall(getDivisionErrorFunction(), {getIntegerConstant(line)});
+    m_builder.CreateUnreachable();
+
+    m_builder.SetInsertPoint(continueBlock);
+
+    // sdiv traps on INT_MIN / -1, x / -1 is computed as 0 - x instead.
+    Value* isMinusOne = m_builder.CreateICmpEQ(right, getIntegerConstant(-1), "is_minus_one");
+    Value* divisor = m_builder.CreateSelect(isMinusOne, getIntegerConstant(1), right, "divisor");
+    Value* quotient = m_builder.CreateSDiv(left, divisor, "divtmp");
+    Value* negated = m_builder.CreateSub(getIntegerConstant(0), left, "negtmp");
+
+    return m_builder.CreateSelect(isMinusOne, negated, quotient, "quotient");
+}
+
+auto CodeGenerator::getDivisionErrorFunction() -> Function* {
+
+    if(Function* function = m_module->getFunction("pl0.division_error")) {
+        return function;
+    }
+
+    // void (line)
+    FunctionType* type = FunctionType::get(m_builder.getVoidTy(), {getIntegerType()}, false);
+
+    Function* function = Function::Create(type, Function::InternalLinkage, "pl0.division_error", m_module.get());
+
+    function->setDoesNotReturn();
+    function->addFnAttr(Attribute::Cold);
+    function->addFnAttr(Attribute::NoInline);
+
+    IRBuilder<> builder(BasicBlock::Create(m_context, "entry", function));
+
+    Value* format = builder.CreateGlobalStringPtr("[Ln: %d] Runtime Error: division by zero.\n", "__division_error_fmt");
+
+    builder.CreateCall(m_module->getFunction("printf"), {format, function->getArg(0)});
+
+    FunctionCallee exit = m_module->getOrInsertFunction("exit", builder.getVoidTy(), getIntegerType());
+    builder.CreateCall(exit, {getIntegerConstant(1)});
+    builder.CreateUnreachable();
+
+    return function;
+}
+
+auto CodeGenerator::addProfileEntry(std::string_view procedure, std::uint32_t line, std::int32_t kind,
+                                    std::uint32_t counters) -> Constant* {
+
+    if(m_profileCounters == nullptr) {
+        m_profileCounters = new GlobalVariable(*m_module, m_builder.getInt64Ty(), false, GlobalValue::InternalLinkage,
+                                               m_builder.getInt64(0), "pl0.profile.placeholder");
+    }
+
+    // main and pl0.outer.inner are reported as main and outer.inner.
+    if(procedure.starts_with("pl0.")) procedure.remove_prefix(4);
+
+    m_profileEntries.push_back({std::string(procedure), line, kind, m_profileCounterCount});
+    m_profileCounterCount += counters;
+
+    return ConstantExpr::getGetElementPtr(m_builder.getInt64Ty(), m_profileCounters,
+                                          m_builder.getInt64(m_profileEntries.back().counter));
+}
+
+auto CodeGenerator::profileFunction(Function* function, BasicBlock* body, std::string_view name,
+                                    std::uint32_t line) -> void {
+
+    Type* countType = m_builder.getInt64Ty();
+
+    Constant* calls = addProfileEntry(name, line, PL0RT_PROFILE_PROCEDURE, 3);
+    Constant* samples = ConstantExpr::getGetElementPtr(countType, calls, m_builder.getInt64(1));
+    Constant* cycles = ConstantExpr::getGetElementPtr(countType, calls, m_builder.getInt64(2));
+
+    Function* readCycles = Intrinsic::getDeclaration(m_module.get(), Intrinsic::readcyclecounter);
+    MDNode* rarely = MDBuilder(m_context).createBranchWeights(1, PL0RT_PROFILE_SAMPLING - 1);
+
+    // The self tail calls jump back to the body, each one ends a call and
+    // starts the next. They are found before the body is split.
+    std::vector<Instruction*> exits;
+
+    for(BasicBlock* predecessor : predecessors(body)) {
+        if(predecessor != &function->getEntryBlock()) exits.push_back(predecessor->getTerminator());
+    }
+
+    // After the allocas, which must stay in the entry block.
+    Instruction* first = &*std::find_if(body->begin(), body->end(), [](const Instruction& instruction) {
+        return !isa<AllocaInst>(instruction);
+    });
+
+    IRBuilder<> builder(first);
+
+    Value* count = addToProfileCounter(builder, calls, builder.getInt64(1), "profile_calls");
+
+    // The top bits of the Fibonacci hash of the call number.
+    Value* hash = builder.CreateMul(count, builder.getInt64(0x9E3779B97F4A7C15));
+    Value* isSampled = builder.CreateICmpEQ(builder.CreateLShr(hash, 64 - Log2_32(PL0RT_PROFILE_SAMPLING)),
+                                            builder.getInt64(0));
+
+    Instruction* sample = SplitBlockAndInsertIfThen(isSampled, first, false, rarely);
+
+    builder.SetInsertPoint(sample);
+    addToProfileCounter(builder, samples, builder.getInt64(1));
+    Value* now = builder.CreateCall(readCycles);
+
+    builder.SetInsertPoint(first);
+    PHINode* start = builder.CreatePHI(countType, 2, "profile_start");
+    start->addIncoming(now, sample->getParent());
+    start->addIncoming(builder.getInt64(0), body);
+
+    for(BasicBlock& block : *function) {
+        auto* ret = dyn_cast<ReturnInst>(block.getTerminator());
+        if(ret == nullptr) continue;
+
+        // Nothing can come between a tail call and its ret. The caller
+        // is done, the cycles of the callee are counted on its own.
+        Instruction* exit = ret;
+
+        if(auto* call = dyn_cast_or_null<CallInst>(ret->getPrevNode()); call != nullptr && call->isTailCall()) {
+            exit = call;
+        }
+
+        exits.push_back(exit);
+    }
+
+    for(Instruction* exit : exits) {
+        builder.SetInsertPoint(exit);
+
+        Value* wasSampled = builder.CreateICmpNE(start, builder.getInt64(0));
+        Instruction* measure = SplitBlockAndInsertIfThen(wasSampled, exit, false, rarely);
+
+        builder.SetInsertPoint(measure);
+        Value* elapsed = builder.CreateSub(builder.CreateCall(readCycles), start);
+        addToProfileCounter(builder, cycles, elapsed);
+    }
+}
+
+auto CodeGenerator::profileLoop(std::int32_t kind, std::uint32_t line, Value* iterations) -> void {
+
+    Function* function = m_builder.GetInsertBlock()->getParent();
+    Constant* counter = addProfileEntry(function->getName(), line, kind, 1);
+
+    addToProfileCounter(m_builder, counter, iterations);
+}
+
+auto CodeGenerator::addToProfileCounter(IRBuilder<>& builder, Value* counter, Value* amount, const Twine& name) -> Value* {
+
+    LoadInst* count = builder.CreateLoad(builder.getInt64Ty(), counter, name);
+    m_profileUpdates.push_back(builder.CreateStore(builder.CreateAdd(count, amount), counter));
+
+    return count;
+}
+
+auto CodeGenerator::emitProfile() -> void {
+
+    Function* main = m_module->getFunction("main");
+    profileFunction(main, &main->getEntryBlock(), "main", 1);
+
+    ArrayType* countersType = ArrayType::get(m_builder.getInt64Ty(), m_profileCounterCount);
+    auto* counters = new GlobalVariable(*m_module, countersType, false, GlobalValue::InternalLinkage,
+                                        ConstantAggregateZero::get(countersType));
+
+    m_profileCounters->replaceAllUsesWith(ConstantExpr::getPointerCast(counters, m_profileCounters->getType()));
+    m_profileCounters->eraseFromParent();
+    counters->setName("pl0.profile.counters");
+
+    // The procedures called by the parallel blocks update the counters
+    // concurrently, the updates become atomic.
+    if(m_module->getFunction("pl0rt_parallel") != nullptr) {
+        for(StoreInst* update : m_profileUpdates) {
+            auto* sum = cast<BinaryOperator>(update->getValueOperand());
+            auto* count = cast<LoadInst>(sum->getOperand(0));
+
+            IRBuilder<> builder(count);
+            Instruction* previous = builder.CreateAtomicRMW(AtomicRMWInst::Add, count->getPointerOperand(), sum->getOperand(1),
+                                                            MaybeAlign(), AtomicOrdering::Monotonic);
+
+            update->eraseFromParent();
+            sum->eraseFromParent();
+
+            previous->takeName(count);
+            count->replaceAllUsesWith(previous);
+            count->eraseFromParent();
+        }
+    }
+
+    // { procedure, line, kind, counters }, as pl0rt_profile_entry.
+    StructType* entryType = StructType::get(m_context, {getPointerType(), getIntegerType(), getIntegerType(), getPointerType()});
+
+    std::vector<Constant*> entries;
+    StringMap<Constant*> names;
+
+    for(const auto& [procedure, line, kind, counter] : m_profileEntries) {
+        Constant*& name = names[procedure];
+        if(name == nullptr) name = m_builder.CreateGlobalStringPtr(procedure, "pl0.profile.name");
+
+        Constant* address = ConstantExpr::getGetElementPtr(countersType, counters,
+                                                           ArrayRef<Constant*>{m_builder.getInt64(0), m_builder.getInt64(counter)});
+
+        entries.push_back(ConstantStruct::get(entryType, {name, getIntegerConstant(line), getIntegerConstant(kind), address}));
+    }
+
+    ArrayType* entriesType = ArrayType::get(entryType, entries.size());
+    auto* table = new GlobalVariable(*m_module, entriesType, true, GlobalValue::InternalLinkage,
+                                     ConstantArray::get(entriesType, entries), "pl0.profile.entries");
+
+    FunctionCallee start = m_module->getOrInsertFunction("pl0rt_profile_start", m_builder.getVoidTy(),
+                                                         getPointerType(), getIntegerType(), getPointerType());
+
+    const std::string program = sys::path::filename(m_moduleName).str();
+
+    // Before the program starts, the entry block of main only counts its call.
+    IRBuilder<> builder(main->getEntryBlock().getTerminator());
+    builder.CreateCall(start, {table, getIntegerConstant(entries.size()), builder.CreateGlobalStringPtr(program, "pl0.profile.program")});
+}
+
+auto CodeGenerator::arrayLength(const Token& length) -> std::optional<std::uint32_t> {
+
+    int value = 0;
+
+    if(length.type == TokenType::Number) {
+        const char* const end = length.lexeme.data() + length.lexeme.size();
+        if(std::from_chars(length.lexeme.data(), end, value).ec != std::errc()) return {};
+    } else {
+        SymbolEntry* entry = m_symtable->lookup(std::string(length.lexeme));
+        if(entry == nullptr || !entry->isConstant()) return {};
+
+        value = static_cast<int>(cast<ConstantInt>(entry->constant())->getSExtValue());
+    }
+
+    if(value <= 0) return {};
+    return static_cast<std::uint32_t>(value);
+}
+
+auto CodeGenerator::loadVariable(SymbolEntry* entry, std::string_view name) -> Value* {
+
+    LoadInst* load = m_builder.CreateLoad(getIntegerType(), getVariableAddress(entry), name);
+
+    if(entry->isShared()) {
+        load->setAtomic(AtomicOrdering::Monotonic);
+    }
+
+    return load;
+}
+
+auto CodeGenerator::storeVariable(SymbolEntry* entry, Value* value) -> void {
+
+    StoreInst* store = m_builder.CreateStore(value, getVariableAddress(entry));
+
+    if(entry->isShared()) {
+        store->setAtomic(AtomicOrdering::Monotonic);
+    }
+}
+
 auto CodeGenerator::beginScope() -> void {
+    memstats::CategoryScope category(memstats::Category::SymbolTables);
     m_symtable = std::make_shared<SymbolTable>(m_symtable);
 }
 
@@ -144,10 +817,10 @@ auto CodeGenerator::endScope() -> void {
 
 auto CodeGenerator::visit(Block* block) -> void {
 
-    beginScope();
-
-    codegenStatement(block->constantsDeclaration);
-    codegenStatement(block->variablesDeclaration);
+    beginBlock(block->constantsDeclaration,
+               block->variablesDeclaration,
+               block->sharedDeclaration,
+               !block->procedureDeclarations.empty());
 
     for(auto& procedure : block->procedureDeclarations){
         codegenStatement(procedure);
@@ -155,118 +828,486 @@ auto CodeGenerator::visit(Block* block) -> void {
     
     codegenStatement(block->statement);
 
-    endScope();
+    endBlock();
+}
+
+auto CodeGenerator::beginBlock(StatementPtr& constants, StatementPtr& variables,
+                               StatementPtr& shared, bool hasProcedures) -> void {
+
+    beginScope();
+
+    codegenStatement(constants);
+
+    // The lengths of the captured arrays can be local constants.
+    if(depth() > 0) {
+        const bool needsFrame = m_onePass
+            ? hasProcedures
+            : m_captures.needsFrame(m_procedures.back().declaration);
+
+        if(needsFrame) createFrame(static_cast<const VariableDeclarations*>(variables.get()));
+    }
+
+    codegenStatement(variables);
+    codegenStatement(shared);
+}
+
+auto CodeGenerator::endBlock() -> void {
+    endScope();
+}
+
+auto CodeGenerator::frameIndex(const Token& variable, std::size_t position) const -> std::uint32_t {
+
+    if(!m_onePass) return m_captures.frameIndex(&variable);
+
+    // The nested procedures are parsed after the variables, the captured
+    // ones aren't known yet: all of them are in the frame.
+    return m_procedures.back().frame != nullptr ? position + 1 : 0;
+}
+
+auto CodeGenerator::createFrame(const VariableDeclarations* variables) -> void {
+
+    Procedure& procedure = m_procedures.back();
+
+    const std::uint32_t captured = m_onePass
+        ? (variables != nullptr ? variables->declarations.size() : 0)
+        : m_captures.capturedVariables(procedure.declaration);
+
+    // { static link, captured variables... }
+    std::vector<Type*> fields(captured + 1, getIntegerType());
+    fields[0] = getPointerType();
+
+    if(variables != nullptr) {
+        for(std::size_t i = 0; i < variables->declarations.size(); i++) {
+            const auto& [ident, length] = variables->declarations[i];
+
+            const std::uint32_t index = m_onePass ? i + 1 : m_captures.frameIndex(&ident);
+            if(index == 0 || !length.has_value()) continue;
+
+            // Invalid lengths are reported with the declaration.
+            fields[index] = ArrayType::get(getIntegerType(), arrayLength(*length).value_or(1));
+        }
+    }
+
+    Function* function = m_builder.GetInsertBlock()->getParent();
+    IRBuilder<> entryBuilder(function->getEntryBlock().getTerminator());
+
+    procedure.frameType = StructType::create(m_context, fields, "frame." + function->getName().str());
+    procedure.frame = entryBuilder.CreateAlloca(procedure.frameType, nullptr, "frame");
+
+    Value* link = entryBuilder.CreateStructGEP(procedure.frameType, procedure.frame, 0, "static_link_addr");
+    entryBuilder.CreateStore(procedure.staticLink != nullptr ? procedure.staticLink : ConstantPointerNull::get(getPointerType()), link);
+}
+
+auto CodeGenerator::visit(ConstDeclarations* decl) -> void {
+    
+    for(const auto& [ident, initializer] : decl->declarations) {
+        std::string name{ident.lexeme};
+        Value* value = getIntegerConstant(initializer);
+
+        m_symtable->insert(name, SymbolEntry::constant(value));
+    }
+}
+
+auto CodeGenerator::visit(VariableDeclarations* decl) -> void {
+
+    const bool areGlobals = !m_symtable->hasParent();
+    Function* function = m_builder.GetInsertBlock()->getParent();
+
+    if(decl->isShared && !areGlobals) {
+        error("[Ln: {}] Compile Error: shared variables must be global.", decl->declarations.front().identifier.line);
+        return;
+    }
+
+    for(std::size_t i = 0; i < decl->declarations.size(); i++){
+
+        const auto& [ident, lengthToken] = decl->declarations[i];
+        const auto& [_, lexeme, line] = ident;
+        
+        SymbolEntry entry;
+        std::string name{lexeme};
+
+        std::uint32_t length = 0;
+
+        if(lengthToken.has_value()) {
+            const auto value = arrayLength(*lengthToken);
+
+            if(!value.has_value()) {
+                error("[Ln: {}] Compile Error: the length of '{}' must be a positive constant.", line, lexeme);
+                return;
+            }
+
+            if(decl->isShared) {
+                error("[Ln: {}] Compile Error: the shared variable '{}' can't be an array.", line, lexeme);
+                return;
+            }
+
+            length = value.value();
+        }
+
+        Type* variableType = length > 0
+            ? static_cast<Type*>(ArrayType::get(getIntegerType(), length))
+            : getIntegerType();
+
+        // Arrays are aligned for vectorized loops.
+        const Align arrayAlign(16);
+
+        if(areGlobals && m_externalGlobals) {
+
+            // Not dso_local, the memory can be anywhere in the address space.
+            GlobalVariable* global = new GlobalVariable(*m_module, variableType, false,
+                                                        GlobalValue::ExternalLinkage, nullptr, mangle(name));
+
+            if(length > 0) {
+                entry = SymbolEntry::array(global, length);
+            } else {
+                entry = decl->isShared ? SymbolEntry::sharedVariable(global) : SymbolEntry::variable(global);
+            }
+        } else if(areGlobals) {
+
+            Constant* initializer = length > 0
+                ? ConstantAggregateZero::get(variableType)
+                : getIntegerConstant(0);
+
+            GlobalVariable* global = new GlobalVariable(*m_module, 
+                                             variableType, 
+                                             false, 
+                                             getLinkage(),
+                                             initializer,
+                                             mangle(name));
+
+           global->setDSOLocal(true);
+
+           if(length > 0) {
+               global->setAlignment(arrayAlign);
+               entry = SymbolEntry::array(global, length);
+           } else {
+               entry = decl->isShared ? SymbolEntry::sharedVariable(global) : SymbolEntry::variable(global);
+           }
+        } else if(const std::uint32_t index = frameIndex(ident, i); index != 0) {
+
+            entry = SymbolEntry::capturedVariable({depth(), index}, length);
+
+            if(length > 0) {
+                m_builder.CreateMemSet(getVariableAddress(&entry), m_builder.getInt8(0), length * sizeof(std::int32_t), MaybeAlign());
+            } else {
+                m_builder.CreateStore(getIntegerConstant(0), getVariableAddress(&entry));
+            }
+        } else {
+
+            IRBuilder<> tmpIRBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+            AllocaInst* value = tmpIRBuilder.CreateAlloca(variableType, nullptr, name);
+
+            // Initialized in the body, it's executed again by the self
+            // recursive tail calls.
+            if(length > 0) {
+                value->setAlignment(arrayAlign);
+                m_builder.CreateMemSet(value, m_builder.getInt8(0), length * sizeof(std::int32_t), arrayAlign);
+
+                entry = SymbolEntry::array(value, length);
+            } else {
+                m_builder.CreateStore(getIntegerConstant(0), value);
+
+                entry = SymbolEntry::variable(value);
+            }
+        }
+
+        if(!m_symtable->insert(name, entry)) {
+            const char* const kind = areGlobals ? "global" : "local";
+            error("[Ln: {}] Compile Error: {} variable '{}' already declared.", line, kind, lexeme);
+            return;
+        }
+    }
+}
+
+auto CodeGenerator::visit(ProcedureDeclaration* decl) -> void {
+
+    const bool isDead = m_eliminateDeadProcedures && !m_callGraph.isReachable(decl);
+    if(isDead) m_removedProcedures.push_back(decl);
+
+    // The profile entries of the procedure and of those nested in it.
+    const std::size_t firstProfileEntry = m_profileEntries.size();
+
+    enterProcedure(decl->name, decl, m_captures.needsStaticLink(decl));
+    Function* function = m_builder.GetInsertBlock()->getParent();
+
+    codegenStatement(decl->block);
+    exitProcedure();
+
+    if(isDead) {
+        m_deadFunctions.push_back(function);
+
+        // Not reported, their counters stay unused in the table.
+        m_profileEntries.resize(firstProfileEntry);
+    }
+}
+
+auto CodeGenerator::enterProcedure(const Token& name, const ProcedureDeclaration* decl, bool hasStaticLink) -> void {
+
+    std::string lexeme{name.lexeme};
+
+    FunctionType* procedureType = hasStaticLink
+        ? FunctionType::get(m_builder.getVoidTy(), {getPointerType()}, false)
+        : FunctionType::get(m_builder.getVoidTy(), false);
+
+    Function* proc = Function::Create(procedureType, getLinkage(), mangle(lexeme), m_module.get());
+    proc->setDSOLocal(true);
+
+    m_symtable->insert(lexeme, SymbolEntry::procedure(proc, depth()));
+
+    BasicBlock* prevBlock = m_builder.GetInsertBlock();
+    BasicBlock* procedureBlock = BasicBlock::Create(m_context, "entry", proc);
+
+    m_builder.SetInsertPoint(procedureBlock);
+
+    Procedure procedure = {name.lexeme, name.line, decl};
+
+    if(m_debugBuilder != nullptr) {
+        procedure.subprogram = createSubprogram(proc, name.lexeme, name.line);
+        procedure.enclosingLocation = m_builder.getCurrentDebugLocation();
+
+        m_builder.SetCurrentDebugLocation(DILocation::get(m_context, name.line, 0, procedure.subprogram));
+    }
+
+    if(hasStaticLink) {
+        procedure.staticLink = proc->getArg(0);
+        procedure.staticLink->setName("static_link");
+    }
+
+    // The frame is allocated here by the block, see createFrame.
+    procedure.body = BasicBlock::Create(m_context, "body", proc);
+    m_builder.CreateBr(procedure.body);
+    m_builder.SetInsertPoint(procedure.body);
+
+    procedure.enclosingBlock = prevBlock;
+    procedure.wasTailPosition = m_tailPosition;
+
+    m_procedures.push_back(procedure);
+    m_tailPosition = true;
+}
+
+auto CodeGenerator::exitProcedure() -> void {
+
+    const Procedure procedure = m_procedures.back();
+    Function* proc = m_builder.GetInsertBlock()->getParent();
+
+    m_builder.CreateRetVoid();
+
+    m_tailPosition = procedure.wasTailPosition;
+    m_procedures.pop_back();
+
+    if(m_debugBuilder != nullptr) {
+        m_debugBuilder->finalizeSubprogram(procedure.subprogram);
+        m_builder.SetCurrentDebugLocation(procedure.enclosingLocation);
+    }
+
+    if(verifyFunction(*proc)) {
+        error("[Ln: {}] Compile Error: unable to compile '{}' procedure.", procedure.line, procedure.name);
+        return;
+    }
+
+    if(m_profileRuntime) profileFunction(proc, procedure.body, proc->getName(), procedure.line);
+
+    m_builder.SetInsertPoint(procedure.enclosingBlock);
+}
+
+auto CodeGenerator::visit(AssignStatement* stmt) -> void {
+    setLocation(stmt->lvalue.line);
+
+    std::string name{stmt->lvalue.lexeme};
+
+    SymbolEntry* entry = m_symtable->lookup(name);
+    if(entry == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared variable.", stmt->lvalue.line, stmt->lvalue.lexeme);
+        return;
+    }
+
+    if(!entry->isVariable()){
+        error("[Ln: {}] Compile Error: can't assign to a constant or a procedure.", stmt->lvalue.line, stmt->lvalue.lexeme);
+        return;
+    }
+
+    if(isLoopVariable(entry)) {
+        error("[Ln: {}] Compile Error: can't assign to the loop variable '{}'.", stmt->lvalue.line, stmt->lvalue.lexeme);
+        return;
+    }
+
+    if(stmt->index != nullptr || entry->isArray()) {
+        Value* address = getElementAddress(entry, stmt->lvalue, stmt->index);
+        if(address == nullptr) return;
+
+        Value* rvalue = codegenExpression(stmt->rvalue);
+        if(rvalue == nullptr) return;
+
+        m_builder.CreateStore(rvalue, address);
+        return;
+    }
+
+    Value* rvalue = codegenExpression(stmt->rvalue);
+    if(rvalue == nullptr) return;
+
+    if(entry->isShared() && emitAtomicUpdate(entry, rvalue)) return;
+
+    storeVariable(entry, rvalue);
 }
 
-auto CodeGenerator::visit(ConstDeclarations* decl) -> void {
-    
-    for(const auto& [ident, initializer] : decl->declarations) {
-        std::string name{ident.lexeme};
-        Value* value = getIntegerConstant(initializer);
+auto CodeGenerator::emitAtomicUpdate(SymbolEntry* entry, Value* rvalue) -> bool {
 
-        m_symtable->insert(name, SymbolEntry::constant(value));
+    auto* update = dyn_cast<BinaryOperator>(rvalue);
+    if(update == nullptr) return false;
+
+    const auto opcode = update->getOpcode();
+    if(opcode != Instruction::Add && opcode != Instruction::Sub) return false;
+
+    Value* address = getVariableAddress(entry);
+
+    const auto isCounter = [address](Value* operand) {
+        auto* load = dyn_cast<LoadInst>(operand);
+        return load != nullptr && load->getPointerOperand() == address && load->hasOneUse();
+    };
+
+    // x - e, or x + e and e + x.
+    unsigned counterIndex;
+    if(isCounter(update->getOperand(0))) {
+        counterIndex = 0;
+    } else if(opcode == Instruction::Add && isCounter(update->getOperand(1))) {
+        counterIndex = 1;
+    } else {
+        return false;
     }
-}
 
-auto CodeGenerator::visit(VariableDeclarations* decl) -> void {
+    auto* counter = cast<LoadInst>(update->getOperand(counterIndex));
+    Value* operand = update->getOperand(1 - counterIndex);
 
-    const bool areGlobals = !m_symtable->hasParent();
-    Function* function = m_builder.GetInsertBlock()->getParent();
-    Type* variableType = getIntegerType();
+    const auto operation = opcode == Instruction::Add ? AtomicRMWInst::Add : AtomicRMWInst::Sub;
+    m_builder.CreateAtomicRMW(operation, address, operand, MaybeAlign(), AtomicOrdering::Monotonic);
 
-    for(const auto& [_, lexeme, line] : decl->identifiers){
-        
-        Value* value;
-        std::string name{lexeme};
+    update->eraseFromParent();
+    counter->eraseFromParent();
 
-        if(!areGlobals) {
+    return true;
+}
 
-            IRBuilder<> tmpIRBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
-            value = tmpIRBuilder.CreateAlloca(variableType, nullptr, name);
-            tmpIRBuilder.CreateStore(getIntegerConstant(0), value);
-        } else {
+auto CodeGenerator::lookupProcedure(const Token& callee) -> SymbolEntry* {
 
-            GlobalVariable* global = new GlobalVariable(*m_module, 
-                                             variableType, 
-                                             false, 
-                                             GlobalVariable::ExternalLinkage,
-                                             getIntegerConstant(0),
-                                             name);
+    SymbolEntry* entry = m_symtable->lookup(std::string(callee.lexeme));
 
-           global->setDSOLocal(true);
-           value = global;
-        }
+    if(entry == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared procedure.", callee.line, callee.lexeme);
+        return nullptr;
+    }
 
-        if(!m_symtable->insert(name, SymbolEntry::variable(value))) {
-            const char* const kind = areGlobals ? "global" : "local";
-            error("[Ln: {}] Compile Error: {} variable '{}' already declared.", line, kind, lexeme);
-            return;
-        }
+    if(!entry->isProcedure()) {
+        error("[Ln: {}] Compile Error: '{}' is not callable.", callee.line, callee.lexeme);
+        return nullptr;
     }
+
+    return entry;
 }
 
-auto CodeGenerator::visit(ProcedureDeclaration* decl) -> void {
+auto CodeGenerator::visit(CallStatement* stmt) -> void {
 
-    std::string name{decl->name.lexeme};
+    setLocation(stmt->callee.line);
 
-    FunctionType* procedureType = FunctionType::get(m_builder.getVoidTy(), false);
-    Function* proc = Function::Create(procedureType, Function::ExternalLinkage, name, m_module.get());
+    SymbolEntry* entry = lookupProcedure(stmt->callee);
+    if(entry == nullptr) return;
 
-    m_symtable->insert(name, SymbolEntry::procedure(proc));
+    Function* procedure = entry->procedure();
+    Function* caller = m_builder.GetInsertBlock()->getParent();
 
-    BasicBlock* prevBlock = m_builder.GetInsertBlock();
-    BasicBlock* procedureBlock = BasicBlock::Create(m_context, "entry", proc);
+    if(m_tailPosition && procedure == caller) {
+        // The static link doesn't change, so the call becomes a jump.
+        BranchInst* jump = m_builder.CreateBr(m_procedures.back().body);
+        BasicBlock* next = BasicBlock::Create(m_context, "after_tail_call", caller);
 
-    m_builder.SetInsertPoint(procedureBlock);
+        m_builder.SetInsertPoint(next);
 
-    codegenStatement(decl->block);
-    m_builder.CreateRetVoid();
+        if(m_onePass) {
+            m_tailCalls.push_back({nullptr, jump, next, procedure, m_procedures.back().staticLink});
+        }
 
-    if(verifyFunction(*proc)) {
-        error("[Ln: {}] Compile Error: unable to compile '{}' procedure.", decl->name.line, name);
         return;
     }
 
-    m_builder.SetInsertPoint(prevBlock);
+    if(procedure->arg_empty()) {
+        emitCall(procedure, nullptr);
+        return;
+    }
+
+    // The callee's static link is the frame of the procedure declaring it.
+    // When unused the frame doesn't escape, and the call can be a tail call.
+    Value* staticLink = usesStaticLink(procedure)
+        ? getFrame(entry->depth())
+        : PoisonValue::get(getPointerType());
+
+    emitCall(procedure, staticLink);
 }
 
-auto CodeGenerator::visit(AssignStatement* stmt) -> void {
-    std::string name{stmt->lvalue.lexeme};
+auto CodeGenerator::usesStaticLink(Function* procedure) const -> bool {
 
-    SymbolEntry* entry = m_symtable->lookup(name);
-    if(entry == nullptr) {
-        error("[Ln: {}] Compile Error: '{}' undeclared variable.", stmt->lvalue.line, stmt->lvalue.lexeme);
-        return;
-    }
+    if(!m_onePass) return true;
 
-    if(!entry->isVariable()){
-        error("[Ln: {}] Compile Error: can't assign to a constant or a procedure.", stmt->lvalue.line, stmt->lvalue.lexeme);
-        return;
+    for(const auto& enclosing : m_procedures) {
+        if(enclosing.body->getParent() == procedure) return true;
     }
 
-    Value* rvalue = codegenExpression(stmt->rvalue);
-    m_builder.CreateStore(rvalue, entry->variable());
+    return !procedure->getArg(0)->use_empty();
 }
 
-auto CodeGenerator::visit(CallStatement* stmt) -> void {
+auto CodeGenerator::emitCall(Function* procedure, Value* staticLink) -> void {
 
-    SymbolEntry* entry = m_symtable->lookup(std::string(stmt->callee.lexeme));
+    Function* caller = m_builder.GetInsertBlock()->getParent();
 
-    if(entry == nullptr) {
-        error("[Ln: {}] Compile Error: '{}' undeclared procedure.", stmt->callee.line, stmt->callee.lexeme);
-        return;
+    CallInst* call = staticLink != nullptr
+        ? m_builder.CreateCall(procedure, {staticLink})
+        : m_builder.CreateCall(procedure, std::nullopt);
+
+    if(!m_tailPosition) return;
+
+    // A callee using the caller's frame needs the caller's stack.
+    if(staticLink != nullptr && staticLink == m_procedures.back().frame) return;
+
+    // musttail is guaranteed also at -O0, but only between equal signatures.
+    call->setTailCallKind(procedure->getFunctionType() == caller->getFunctionType()
+                              ? CallInst::TCK_MustTail
+                              : CallInst::TCK_Tail);
+
+    ReturnInst* ret = m_builder.CreateRetVoid();
+    BasicBlock* next = BasicBlock::Create(m_context, "after_tail_call", caller);
+
+    m_builder.SetInsertPoint(next);
+
+    if(m_onePass) {
+        m_tailCalls.push_back({call, ret, next, procedure, staticLink});
     }
+}
 
-    if(!entry->isProcedure()) {
-        error("[Ln: {}] Compile Error: '{}' is not callable.", stmt->callee.line, stmt->callee.lexeme);
-        return;
+auto CodeGenerator::demoteTailCalls(std::size_t first) -> void {
+
+    for(std::size_t i = first; i < m_tailCalls.size(); i++) {
+        const auto& [call, exit, next, procedure, staticLink] = m_tailCalls[i];
+
+        if(call != nullptr) {
+            call->setTailCallKind(CallInst::TCK_None);
+        } else {
+            IRBuilder<> builder(exit);
+
+            staticLink != nullptr
+                ? builder.CreateCall(procedure, {staticLink})
+                : builder.CreateCall(procedure, std::nullopt);
+        }
+
+        // The code after the call is reachable again.
+        BranchInst::Create(next, exit);
+        exit->eraseFromParent();
     }
 
-    m_builder.CreateCall(entry->procedure(), std::nullopt);
+    m_tailCalls.resize(first);
 }
 
 auto CodeGenerator::visit(InputStatement* stmt) -> void {
 
+    setLocation(stmt->destination.line);
+
     std::string name{stmt->destination.lexeme};
     SymbolEntry* entry = m_symtable->lookup(name);
 
@@ -280,12 +1321,39 @@ auto CodeGenerator::visit(InputStatement* stmt) -> void {
         return;
     }
 
+    if(isLoopVariable(entry)) {
+        error("[Ln: {}] Compile Error: can't assign to the loop variable '{}'.", stmt->destination.line, name);
+        return;
+    }
+
     SmallVector<Value*, 2> args;
 
     args.push_back(m_module->getNamedValue("__scanf_fmt"));
-    args.push_back(entry->variable());
 
+    if(stmt->index != nullptr || entry->isArray()) {
+        Value* address = getElementAddress(entry, stmt->destination, stmt->index);
+        if(address == nullptr) return;
+
+        args.push_back(address);
+        m_builder.CreateCall(m_module->getFunction("scanf"), args, "call_scanftmp");
+        return;
+    }
+
+    if(!entry->isShared()) {
+        args.push_back(getVariableAddress(entry));
+        m_builder.CreateCall(m_module->getFunction("scanf"), args, "call_scanftmp");
+        return;
+    }
+
+    // scanf can't store atomically, the value is read in a temporary.
+    Function* function = m_builder.GetInsertBlock()->getParent();
+    IRBuilder<> tmpIRBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    Value* input = tmpIRBuilder.CreateAlloca(getIntegerType(), nullptr, "input");
+
+    args.push_back(input);
     m_builder.CreateCall(m_module->getFunction("scanf"), args, "call_scanftmp");
+
+    storeVariable(entry, m_builder.CreateLoad(getIntegerType(), input, name));
 }
 
 auto CodeGenerator::visit(PrintStatement* stmt) -> void {
@@ -299,18 +1367,102 @@ auto CodeGenerator::visit(PrintStatement* stmt) -> void {
 }
 
 auto CodeGenerator::visit(BeginStatement* stmt) -> void {
-    for(auto& statement : stmt->statements) {
-        codegenStatement(statement);
+
+    const bool isTailPosition = m_tailPosition;
+
+    const auto runs = m_autoParallel
+        ? m_effects.concurrentCalls(stmt)
+        : std::vector<std::pair<std::size_t, std::size_t>>();
+
+    auto run = runs.begin();
+
+    for(std::size_t i = 0; i < stmt->statements.size(); i++) {
+
+        if(run != runs.end() && run->first == i) {
+            m_tailPosition = false;
+            setLocation(static_cast<const CallStatement*>(stmt->statements[i].get())->callee.line);
+            emitParallelCalls(std::span(stmt->statements).subspan(run->first, run->second - run->first));
+
+            i = run->second - 1;
+            run++;
+            continue;
+        }
+
+        m_tailPosition = isTailPosition && i + 1 == stmt->statements.size();
+        codegenStatement(stmt->statements[i]);
     }
+
+    m_tailPosition = isTailPosition;
+}
+
+auto CodeGenerator::beginProcedure(const Token& name) -> void {
+    enterProcedure(name, nullptr, depth() > 0);
+}
+
+auto CodeGenerator::endProcedure() -> void {
+    exitProcedure();
+
+    // The enclosing procedures are still in their declarations.
+    m_tailCalls.clear();
+}
+
+auto CodeGenerator::statement(StatementPtr& stmt) -> void {
+    if(!isSkipping()) codegenStatement(stmt);
+}
+
+auto CodeGenerator::beginStatements() -> void {
+    m_statementTailCalls.push_back(m_tailCalls.size());
+}
+
+auto CodeGenerator::nextStatement() -> void {
+    demoteTailCalls(m_statementTailCalls.back());
+}
+
+auto CodeGenerator::endStatements() -> void {
+    m_statementTailCalls.pop_back();
+}
+
+auto CodeGenerator::beginIf(ExpressionPtr& condition) -> void {
+    pushCompound(isSkipping() ? std::nullopt : enterIf(condition));
+}
+
+auto CodeGenerator::endIf() -> void {
+    if(const auto compound = popCompound()) exitIf(*compound);
+}
+
+auto CodeGenerator::beginWhile(ExpressionPtr& condition) -> void {
+    pushCompound(isSkipping() ? std::nullopt : enterWhile(condition));
+}
+
+auto CodeGenerator::endWhile() -> void {
+    if(const auto compound = popCompound()) exitWhile(*compound);
+}
+
+auto CodeGenerator::beginFor(const Token& variable, ExpressionPtr& from,
+                             ExpressionPtr& to, ExpressionPtr& step) -> void {
+    pushCompound(isSkipping() ? std::nullopt : enterFor(variable, from, to, step));
+}
+
+auto CodeGenerator::endFor() -> void {
+    if(const auto compound = popCompound()) exitFor(*compound);
 }
 
 auto CodeGenerator::visit(IfStatement* stmt) -> void {
 
-    Value* condition = codegenExpression(stmt->condition);
+    const auto compound = enterIf(stmt->condition);
+    if(!compound.has_value()) return;
+
+    codegenStatement(stmt->body);
+    exitIf(*compound);
+}
+
+auto CodeGenerator::enterIf(ExpressionPtr& expr) -> std::optional<Compound> {
+
+    Value* condition = codegenExpression(expr);
     
     if(condition == nullptr) {
         error("Compile Error: unable to generate the code for the condition.");
-        return;
+        return {};
     }
 
     Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
@@ -321,29 +1473,55 @@ auto CodeGenerator::visit(IfStatement* stmt) -> void {
     m_builder.CreateCondBr(condition, thenBlock, endBlock);
     m_builder.SetInsertPoint(thenBlock);
 
-    codegenStatement(stmt->body);
-    m_builder.CreateBr(endBlock);
+    return Compound{endBlock};
+}
+
+auto CodeGenerator::exitIf(const Compound& compound) -> void {
+
+    Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
+
+    m_builder.CreateBr(compound.end);
     
-    currentProcedure->insert(currentProcedure->end(), endBlock);
-    m_builder.SetInsertPoint(endBlock);
+    currentProcedure->insert(currentProcedure->end(), compound.end);
+    m_builder.SetInsertPoint(compound.end);
 }
 
 auto CodeGenerator::visit(WhileStatement* stmt) -> void {
 
+    const auto compound = enterWhile(stmt->condition);
+    if(!compound.has_value()) return;
+
+    codegenStatement(stmt->body);
+    exitWhile(*compound);
+}
+
+auto CodeGenerator::enterWhile(ExpressionPtr& expr) -> std::optional<Compound> {
+
     Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
 
     BasicBlock* whileBlock = BasicBlock::Create(m_context, "while", currentProcedure);
     BasicBlock* whileBodyBlock = BasicBlock::Create(m_context, "while_body");
     BasicBlock* endBlock = BasicBlock::Create(m_context, "loop_end");
 
+    // The iterations are counted in a register and added to the table when
+    // the loop ends, not to touch memory in the loop.
+    AllocaInst* iterations = nullptr;
+
+    if(m_profileRuntime) {
+        IRBuilder<> tmpIRBuilder(&currentProcedure->getEntryBlock(), currentProcedure->getEntryBlock().begin());
+        iterations = tmpIRBuilder.CreateAlloca(m_builder.getInt64Ty(), nullptr, "profile_iterations");
+
+        m_builder.CreateStore(m_builder.getInt64(0), iterations);
+    }
+
     m_builder.CreateBr(whileBlock);
     m_builder.SetInsertPoint(whileBlock);
 
-    Value* condition = codegenExpression(stmt->condition);
+    Value* condition = codegenExpression(expr);
     
     if(condition == nullptr) {
         error("Compile Error: unable to generate the code for the condition.");
-        return;
+        return {};
     }
 
     m_builder.CreateCondBr(condition, whileBodyBlock, endBlock);
@@ -351,13 +1529,228 @@ auto CodeGenerator::visit(WhileStatement* stmt) -> void {
     currentProcedure->insert(currentProcedure->end(), whileBodyBlock);
     m_builder.SetInsertPoint(whileBodyBlock);
 
-    codegenStatement(stmt->body);
-    m_builder.CreateBr(whileBlock);
+    if(iterations != nullptr) {
+        Value* count = m_builder.CreateLoad(m_builder.getInt64Ty(), iterations);
+        m_builder.CreateStore(m_builder.CreateAdd(count, m_builder.getInt64(1)), iterations);
+
+        m_profiledLoops.push_back({iterations, m_line});
+    }
+
+    Compound compound = {endBlock, whileBlock, m_tailPosition};
+    m_tailPosition = false;
+
+    return compound;
+}
+
+auto CodeGenerator::exitWhile(const Compound& compound) -> void {
+
+    Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
+
+    m_builder.CreateBr(compound.header);
+
+    m_tailPosition = compound.wasTailPosition;
     
+    currentProcedure->insert(currentProcedure->end(), compound.end);
+    m_builder.SetInsertPoint(compound.end);
+
+    if(m_profileRuntime) {
+        const auto [iterations, line] = m_profiledLoops.back();
+        m_profiledLoops.pop_back();
+
+        profileLoop(PL0RT_PROFILE_WHILE, line, m_builder.CreateLoad(m_builder.getInt64Ty(), iterations));
+    }
+}
+
+auto CodeGenerator::visit(ForStatement* stmt) -> void {
+
+    const auto compound = enterFor(stmt->variable, stmt->from, stmt->to, stmt->step);
+    if(!compound.has_value()) return;
+
+    codegenStatement(stmt->body);
+    exitFor(*compound);
+}
+
+auto CodeGenerator::enterFor(const Token& variable, ExpressionPtr& fromExpr,
+                             ExpressionPtr& toExpr, ExpressionPtr& stepExpr) -> std::optional<Compound> {
+
+    const auto& [_, lexeme, line] = variable;
+    SymbolEntry* entry = m_symtable->lookup(std::string(lexeme));
+
+    setLocation(line);
+
+    if(entry == nullptr) {
+        error("[Ln: {}] Compile Error: '{}' undeclared variable.", line, lexeme);
+        return {};
+    }
+
+    if(!entry->isVariable()) {
+        error("[Ln: {}] Compile Error: the loop variable '{}' must be a variable.", line, lexeme);
+        return {};
+    }
+
+    if(isLoopVariable(entry)) {
+        error("[Ln: {}] Compile Error: '{}' is already the variable of an enclosing loop.", line, lexeme);
+        return {};
+    }
+
+    if(entry->isArray()) {
+        error("[Ln: {}] Compile Error: the loop variable '{}' can't be an array.", line, lexeme);
+        return {};
+    }
+
+    Value* from = codegenExpression(fromExpr);
+    Value* to = codegenExpression(toExpr);
+
+    if(from == nullptr || to == nullptr) {
+        error("[Ln: {}] Compile Error: unable to generate the code for the loop bounds.", line);
+        return {};
+    }
+
+    // Constant expressions are folded by the builder.
+    auto* step = stepExpr != nullptr
+        ? dyn_cast_or_null<ConstantInt>(codegenExpression(stepExpr))
+        : cast<ConstantInt>(getIntegerConstant(1));
+
+    if(step == nullptr || step->isZero()) {
+        error("[Ln: {}] Compile Error: the step of the loop must be a constant other than 0.", line);
+        return {};
+    }
+
+    // The trip count is computed once, in 64 bits so that it can't overflow:
+    // (to - from) / step + 1, or 0 when the range is empty.
+    Type* countType = m_builder.getInt64Ty();
+    Value* first = m_builder.CreateSExt(from, countType, "for_from");
+    Value* last = m_builder.CreateSExt(to, countType, "for_to");
+
+    const bool isIncreasing = !step->isNegative();
+
+    Value* distance = isIncreasing
+        ? m_builder.CreateSub(last, first, "for_distance")
+        : m_builder.CreateSub(first, last, "for_distance");
+
+    Value* stride = ConstantInt::get(countType, step->getValue().abs().getZExtValue());
+    Value* iterations = m_builder.CreateAdd(m_builder.CreateUDiv(distance, stride), ConstantInt::get(countType, 1));
+
+    Value* isEmpty = m_builder.CreateICmpSLT(distance, ConstantInt::get(countType, 0), "for_empty");
+    Value* tripCount = m_builder.CreateSelect(isEmpty, ConstantInt::get(countType, 0), iterations, "for_trip_count");
+
+    // Counted once, in the preheader.
+    if(m_profileRuntime) profileLoop(PL0RT_PROFILE_FOR, line, tripCount);
+
+    Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
+    BasicBlock* preheaderBlock = m_builder.GetInsertBlock();
+
+    BasicBlock* bodyBlock = BasicBlock::Create(m_context, "for_body", currentProcedure);
+    BasicBlock* latchBlock = BasicBlock::Create(m_context, "for_latch");
+    BasicBlock* endBlock = BasicBlock::Create(m_context, "for_end");
+
+    m_builder.CreateCondBr(isEmpty, endBlock, bodyBlock);
+    m_builder.SetInsertPoint(bodyBlock);
+
+    PHINode* counter = m_builder.CreatePHI(countType, 2, "for_counter");
+    PHINode* value = m_builder.CreatePHI(getIntegerType(), 2, lexeme);
+
+    counter->addIncoming(ConstantInt::get(countType, 0), preheaderBlock);
+    value->addIncoming(from, preheaderBlock);
+
+    storeVariable(entry, value);
+
+    Compound compound = {endBlock, latchBlock, m_tailPosition};
+    compound.body = bodyBlock;
+    compound.counter = counter;
+    compound.value = value;
+    compound.step = step;
+    compound.tripCount = tripCount;
+
+    m_tailPosition = false;
+    m_loopVariables.push_back(entry);
+
+    return compound;
+}
+
+auto CodeGenerator::exitFor(const Compound& compound) -> void {
+
+    const auto& [endBlock, latchBlock, isTailPosition, bodyBlock, counter, value, step, tripCount] = compound;
+    Function* currentProcedure = m_builder.GetInsertBlock()->getParent();
+    Type* countType = m_builder.getInt64Ty();
+
+    m_loopVariables.pop_back();
+    m_tailPosition = isTailPosition;
+
+    m_builder.CreateBr(latchBlock);
+
+    currentProcedure->insert(currentProcedure->end(), latchBlock);
+    m_builder.SetInsertPoint(latchBlock);
+
+    Value* nextCounter = m_builder.CreateAdd(counter, ConstantInt::get(countType, 1), "for_next_counter", true, true);
+    Value* nextValue = m_builder.CreateAdd(value, step, "for_next");
+
+    counter->addIncoming(nextCounter, latchBlock);
+    value->addIncoming(nextValue, latchBlock);
+
+    Value* isDone = m_builder.CreateICmpEQ(nextCounter, tripCount, "for_done");
+    BranchInst* backEdge = m_builder.CreateCondBr(isDone, endBlock, bodyBlock);
+
+    // A counted loop always terminates.
+    Metadata* mustProgress = MDNode::get(m_context, MDString::get(m_context, "llvm.loop.mustprogress"));
+    MDNode* loopID = MDNode::getDistinct(m_context, {nullptr, mustProgress});
+    loopID->replaceOperandWith(0, loopID);
+    backEdge->setMetadata(LLVMContext::MD_loop, loopID);
+
     currentProcedure->insert(currentProcedure->end(), endBlock);
     m_builder.SetInsertPoint(endBlock);
 }
     
+auto CodeGenerator::visit(ParallelStatement* stmt) -> void {
+
+    for(const auto& [first, second, variable] : m_effects.conflicts(stmt)) {
+        warning("[Ln: {}] Warning: '{}' and '{}' both write '{}' in the parallel block.",
+                stmt->keyword.line, first->lexeme, second->lexeme, variable->lexeme);
+    }
+
+    setLocation(stmt->keyword.line);
+    emitParallelCalls(stmt->calls);
+}
+
+auto CodeGenerator::emitParallelCalls(std::span<StatementPtr> calls) -> void {
+
+    // { procedure, static link }
+    StructType* taskType = StructType::getTypeByName(m_context, "pl0rt.task");
+    if(taskType == nullptr) {
+        taskType = StructType::create(m_context, {getPointerType(), getPointerType()}, "pl0rt.task");
+    }
+
+    FunctionCallee parallel = m_module->getOrInsertFunction("pl0rt_parallel",
+                                                            m_builder.getVoidTy(),
+                                                            getPointerType(),
+                                                            getIntegerType());
+
+    Function* function = m_builder.GetInsertBlock()->getParent();
+    IRBuilder<> tmpIRBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+
+    ArrayType* tasksType = ArrayType::get(taskType, calls.size());
+    Value* tasks = tmpIRBuilder.CreateAlloca(tasksType, nullptr, "tasks");
+
+    for(std::size_t i = 0; i < calls.size(); i++) {
+        const auto* call = static_cast<const CallStatement*>(calls[i].get());
+
+        SymbolEntry* entry = lookupProcedure(call->callee);
+        if(entry == nullptr) return;
+
+        Function* procedure = entry->procedure();
+        Value* staticLink = procedure->arg_empty()
+            ? ConstantPointerNull::get(getPointerType())
+            : getFrame(entry->depth());
+
+        Value* task = m_builder.CreateConstInBoundsGEP2_32(tasksType, tasks, 0, i, "task");
+
+        m_builder.CreateStore(procedure, m_builder.CreateStructGEP(taskType, task, 0));
+        m_builder.CreateStore(staticLink, m_builder.CreateStructGEP(taskType, task, 1));
+    }
+
+    m_builder.CreateCall(parallel, {tasks, getIntegerConstant(calls.size())});
+}
+
 auto CodeGenerator::visit(OddExpression* expr) -> void {
 
     Value* left = codegenExpression(expr->expr);
@@ -384,6 +1777,8 @@ auto CodeGenerator::visit(BinaryExpression* expr) -> void {
     Value* left = codegenExpression(expr->left);
     Value* right = codegenExpression(expr->right);
 
+    setLocation(expr->op.line);
+
     if(left == nullptr || right == nullptr) {
         error("[Ln: {}] Compile Error: unable to generate the code for this expression.", expr->op.line);
         return;
@@ -400,7 +1795,7 @@ auto CodeGenerator::visit(BinaryExpression* expr) -> void {
             setValue(m_builder.CreateMul(left, right, "multmp"));
             break;
         case TokenType::Slash:
-            setValue(m_builder.CreateSDiv(left, right, "divtmp"));
+            setValue(createDivision(left, right, expr->op.line));
             break;
         case TokenType::Greater:
             setValue(m_builder.CreateICmpSGT(left, right, "sgt_icmptmp"));
@@ -429,6 +1824,7 @@ auto CodeGenerator::visit(BinaryExpression* expr) -> void {
 auto CodeGenerator::visit(UnaryExpression* expr) -> void {
 
     Value* right = codegenExpression(expr->right);
+    setLocation(expr->op.line);
 
     if(right == nullptr) {
         error("[Ln: {}] Compile Error: unable to generate the code for the following expression.", expr->op.line);
@@ -443,7 +1839,9 @@ auto CodeGenerator::visit(UnaryExpression* expr) -> void {
 }
 
 auto CodeGenerator::visit(VariableExpression* expr) -> void {
-    
+
+    setLocation(expr->name.line);
+
     std::string name{expr->name.lexeme};
     auto entry = m_symtable->lookup(name);
 
@@ -457,14 +1855,37 @@ auto CodeGenerator::visit(VariableExpression* expr) -> void {
         return;
     }
     
+    if(entry->isArray()) {
+        error("[Ln: {}] Compile Error: the array '{}' must be indexed.", expr->name.line, name);
+        return;
+    }
+
     if(entry->isVariable()){
-        setValue(m_builder.CreateLoad(getIntegerType(), entry->variable(), name.c_str()));
+        setValue(loadVariable(entry, name));
         return;
     }
 
     error("[Ln: {}] Compile Error: functions are not first class objects.", expr->name.line);
 }
 
+auto CodeGenerator::visit(IndexExpression* expr) -> void {
+
+    setLocation(expr->name.line);
+
+    std::string name{expr->name.lexeme};
+    SymbolEntry* entry = m_symtable->lookup(name);
+
+    if(entry == nullptr) {
+        error("[Ln: {}] Compile Error: undeclared variable '{}'.", expr->name.line, name);
+        return;
+    }
+
+    Value* address = getElementAddress(entry, expr->name, expr->index);
+    if(address == nullptr) return;
+
+    setValue(m_builder.CreateLoad(getIntegerType(), address, name));
+}
+
 auto CodeGenerator::visit(LiteralExpression* expr) -> void {
     setValue(getIntegerConstant(expr->value));
 }
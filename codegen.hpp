@@ -1,18 +1,29 @@
 #ifndef _CODEGEN_HPP_
 #define _CODEGEN_HPP_
 
+#include "analysis.hpp"
 #include "ast.hpp"
 #include "errors_holder_trait.hpp"
+#include "os.hpp"
+#include "parser.hpp"
 #include "symtable.hpp"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
 
+#include <algorithm>
 #include <memory>
 #include <format>
+#include <optional>
+#include <span>
 #include <string_view>
 
 namespace pl0::codegen {
@@ -22,14 +33,43 @@ using namespace ast;
 using namespace error;
 using namespace llvm;
 
+// CPU of this machine and its features, as "+feature,-feature,...".
+auto hostCpuName() -> std::string;
+auto hostCpuFeatures() -> std::string;
+
 class CodeGenerator : public AstVisitor, 
-                      public ErrorsHolderTrait {
+                      public ErrorsHolderTrait,
+                      public parser::Emitter {
 public:
     CodeGenerator(std::string_view moduleName);
 
     auto generate(StatementPtr& stmt) -> bool;
+
+    // Generates the code while `parser` parses the program, without an AST
+    // (-one-pass). False also on syntax errors, they are in the parser.
+    //
+    // The captured variables are unknown when a procedure starts: all the
+    // variables of the procedures with nested ones are in their frame, and
+    // the nested procedures always get the static link. The races of the
+    // parallel blocks aren't reported.
+    auto generate(parser::Parser& parser) -> bool;
+    auto optimize() -> void;
     auto produceObjectFile() -> void;
 
+    // The object file in memory, nullptr on error. It's handed to the
+    // object cache, if any.
+    [[nodiscard]]
+    auto produceObjectBuffer() -> std::unique_ptr<MemoryBuffer>;
+
+    // The object of the module in the cache, nullptr if missing. Looked up
+    // before optimizing, to skip also the optimizer.
+    [[nodiscard]]
+    auto cachedObject() -> std::unique_ptr<MemoryBuffer>;
+
+    inline auto setObjectCache(ObjectCache* cache) -> void {
+        m_objectCache = cache;
+    }
+
     [[nodiscard]] 
     auto produceExecutable() -> bool;
 
@@ -37,8 +77,80 @@ public:
         m_module->print(outs(), nullptr);
     }
 
+    [[nodiscard]]
+    inline auto module() const -> const Module& {
+        return *m_module;
+    }
+
+    // From 0 to 3, like -O0 ... -O3.
+    inline auto setOptimizationLevel(unsigned level) -> void {
+        m_optimizationLevel = level;
+    }
+
+    // The module is the whole program: everything except main gets internal
+    // linkage, so the optimizer can see every use of globals and procedures.
+    inline auto setWholeProgram(bool wholeProgram) -> void {
+        m_wholeProgram = wholeProgram;
+    }
+
+    // The globals are only declared, their memory is somewhere else, e.g.
+    // in the interpreter running the rest of the program (-tiered).
+    inline auto setExternalGlobals(bool externalGlobals) -> void {
+        m_externalGlobals = externalGlobals;
+    }
+
+    // Generates code for the CPU and features of this machine, not a
+    // generic one: the code runs in this process.
+    inline auto setHostTarget(bool hostTarget) -> void {
+        m_hostTarget = hostTarget;
+    }
+
+    // Drops the procedures never called from the main program. Their code
+    // is still generated, for the errors, and erased before optimizing.
+    inline auto setEliminateDeadProcedures(bool eliminate) -> void {
+        m_eliminateDeadProcedures = eliminate;
+    }
+
+    // Runs the consecutive calls that are independent concurrently
+    // (-auto-parallel), see EffectAnalysis.
+    inline auto setAutoParallel(bool autoParallel) -> void {
+        m_autoParallel = autoParallel;
+    }
+
+    // Emits the DWARF line table mapping the code to the lines of
+    // `sourcePath` and keeps the frame pointers (-g), for perf and the
+    // debuggers. Call it after setOptimizationLevel.
+    auto setDebugInfo(std::string_view sourcePath) -> void;
+
+    // Counts the calls and the cycles of every procedure and the iterations
+    // of every loop (-profile-runtime). The program writes the report at
+    // exit, see pl0rt_profile_start.
+    inline auto setProfileRuntime(bool profile) -> void {
+        m_profileRuntime = profile;
+    }
+
+    // The procedures dropped, in source order.
+    constexpr auto removedProcedures() const -> const std::vector<const ProcedureDeclaration*>& {
+        return m_removedProcedures;
+    }
+
+    // True if the procedure `name` (mangled) can be called alone by other
+    // code: it has no static link and doesn't start parallel blocks.
+    [[nodiscard]]
+    auto isStandalone(std::string_view name) const -> bool;
+
+    // Keeps only the procedure `name`, as external symbol, and the
+    // functions it calls: main and the other procedures are dropped.
+    auto extractProcedure(std::string_view name) -> void;
+
 private:
 
+    auto initializeTarget() -> bool;
+
+    // The functions called by `procedure`, directly or not, and itself.
+    auto reachableFunctions(Function* procedure) const -> SmallPtrSet<Function*, 8>;
+    auto emitObject(raw_pwrite_stream& stream) -> bool;
+
     auto beginScope() -> void;
     auto endScope() -> void;
     auto endProgram() -> void;
@@ -51,6 +163,192 @@ private:
         return ConstantInt::getSigned(getIntegerType(), value);
     }
 
+    inline auto getPointerType() -> PointerType* {
+        return PointerType::getUnqual(m_context);
+    }
+
+    // Nesting level of the code being generated, 0 is the main program.
+    inline auto depth() const -> std::uint32_t {
+        return static_cast<std::uint32_t>(m_procedures.size());
+    }
+
+    inline auto getLinkage() const -> GlobalValue::LinkageTypes {
+        return m_wholeProgram
+            ? GlobalValue::InternalLinkage
+            : GlobalValue::ExternalLinkage;
+    }
+
+    // Debug info of a function starting at `line`, see setDebugInfo.
+    auto createSubprogram(Function* function, std::string_view name, std::uint32_t line) -> DISubprogram*;
+
+    // The next instructions come from `line` of the current procedure.
+    inline auto setLocation(std::uint32_t line) -> void {
+        m_line = line;
+        if(m_debugBuilder == nullptr) return;
+
+        DISubprogram* scope = m_procedures.empty() ? m_mainSubprogram : m_procedures.back().subprogram;
+        m_builder.SetCurrentDebugLocation(DILocation::get(m_context, line, 0, scope));
+    }
+
+    // Adds an entry of `kind` to the profile of the program, the address of
+    // its first counter is returned.
+    auto addProfileEntry(std::string_view procedure, std::uint32_t line, std::int32_t kind,
+                         std::uint32_t counters) -> Constant*;
+
+    // Counts the calls of `function` and, for about one call out of
+    // PL0RT_PROFILE_SAMPLING, the cycles until it returns or tail calls:
+    // those of the procedures it waits for are included, a tail call hands
+    // over and its cycles are the callee's. Every call starts at `body`,
+    // also the self tail calls jumping there.
+    auto profileFunction(Function* function, BasicBlock* body, std::string_view name, std::uint32_t line) -> void;
+
+    // Adds `iterations` to the counter of a new loop.
+    auto profileLoop(std::int32_t kind, std::uint32_t line, Value* iterations) -> void;
+
+    // Adds `amount` to a counter of the profile, the value before is
+    // returned. emitProfile makes the update atomic if needed.
+    auto addToProfileCounter(IRBuilder<>& builder, Value* counter, Value* amount, const Twine& name = "") -> Value*;
+
+    // Creates the table of the counters and the entries, and hands them to
+    // the runtime when main starts.
+    auto emitProfile() -> void;
+
+    // PL/0 names can't clash with the C library ones (e.g. 'div'), nested
+    // procedures are qualified by the enclosing ones: pl0.outer.inner
+    auto mangle(std::string_view name) const -> std::string;
+
+    // Frame of the procedure at `depth`, reached through the static links.
+    auto getFrame(std::uint32_t depth) -> Value*;
+    auto getVariableAddress(SymbolEntry* entry) -> Value*;
+
+    // Address of the element of the array `name` selected by `index`, after
+    // checking the bounds. nullptr on error.
+    auto getElementAddress(SymbolEntry* entry, const Token& name, ExpressionPtr& index) -> Value*;
+
+    // Called when an index is out of bounds, it never returns.
+    auto getIndexErrorFunction() -> Function*;
+
+    // left / right like the interpreter: a division by zero is a runtime
+    // error, INT_MIN / -1 wraps around to INT_MIN.
+    auto createDivision(Value* left, Value* right, std::uint32_t line) -> Value*;
+
+    // Called on a division by zero, it never returns.
+    auto getDivisionErrorFunction() -> Function*;
+
+    // Value of the number or constant giving the length of an array.
+    auto arrayLength(const Token& length) -> std::optional<std::uint32_t>;
+
+    // Allocates the activation frame of the current procedure.
+    auto createFrame(const VariableDeclarations* variables) -> void;
+
+    // Field of the variable, the `position`-th of its declaration, in the
+    // frame of the current procedure. 0 if it isn't captured.
+    auto frameIndex(const Token& variable, std::size_t position) const -> std::uint32_t;
+
+    // Shared variables are loaded and stored atomically.
+    auto loadVariable(SymbolEntry* entry, std::string_view name) -> Value*;
+    auto storeVariable(SymbolEntry* entry, Value* value) -> void;
+
+    // Turns x := x + e and x := x - e on a shared variable into a single
+    // atomic update, `rvalue` is the value generated for the right side.
+    auto emitAtomicUpdate(SymbolEntry* entry, Value* rvalue) -> bool;
+
+    // Looks up the procedure called by a call statement, nullptr on error.
+    auto lookupProcedure(const Token& callee) -> SymbolEntry*;
+
+    // Runs the call statements `calls` on the thread pool of the runtime
+    // and waits for them.
+    auto emitParallelCalls(std::span<StatementPtr> calls) -> void;
+
+    inline auto isLoopVariable(const SymbolEntry* entry) const -> bool {
+        return std::find(m_loopVariables.begin(), m_loopVariables.end(), entry) != m_loopVariables.end();
+    }
+
+    // Calls a procedure, as a tail call when it's the last action of the caller.
+    auto emitCall(Function* procedure, Value* staticLink) -> void;
+
+    // Turns the tail calls from `first` on into plain calls, their statement
+    // wasn't the last one.
+    auto demoteTailCalls(std::size_t first) -> void;
+
+    // Blocks around the body of an if, while or for statement, from its
+    // enterX to its exitX.
+    struct Compound {
+        BasicBlock* end;
+
+        // Condition of a while, latch of a for.
+        BasicBlock* header = nullptr;
+        bool wasTailPosition = false;
+
+        // Counted loops.
+        BasicBlock* body = nullptr;
+        PHINode* counter = nullptr;
+        PHINode* value = nullptr;
+        ConstantInt* step = nullptr;
+        Value* tripCount = nullptr;
+    };
+
+    // nullopt on error, the body isn't generated.
+    auto enterIf(ExpressionPtr& condition) -> std::optional<Compound>;
+    auto exitIf(const Compound& compound) -> void;
+
+    auto enterWhile(ExpressionPtr& condition) -> std::optional<Compound>;
+    auto exitWhile(const Compound& compound) -> void;
+
+    auto enterFor(const Token& variable, ExpressionPtr& from,
+                  ExpressionPtr& to, ExpressionPtr& step) -> std::optional<Compound>;
+    auto exitFor(const Compound& compound) -> void;
+
+    auto enterProcedure(const Token& name, const ProcedureDeclaration* decl, bool hasStaticLink) -> void;
+    auto exitProcedure() -> void;
+
+    inline auto pushCompound(std::optional<Compound> compound) -> void {
+        if(!compound.has_value()) m_skippedCompounds++;
+        m_compounds.push_back(compound);
+    }
+
+    inline auto popCompound() -> std::optional<Compound> {
+        std::optional<Compound> compound = m_compounds.back();
+        m_compounds.pop_back();
+
+        if(!compound.has_value()) m_skippedCompounds--;
+        return compound;
+    }
+
+    // True if the statements are in the body of a compound statement that
+    // failed, they aren't generated.
+    inline auto isSkipping() const -> bool {
+        return m_skippedCompounds > 0;
+    }
+
+    // False if `procedure` (a nested one) surely doesn't use its static
+    // link: in one pass it's generated before being called, except by
+    // itself and its nested procedures.
+    auto usesStaticLink(Function* procedure) const -> bool;
+
+    auto beginBlock(StatementPtr& constants, StatementPtr& variables,
+                    StatementPtr& shared, bool hasProcedures) -> void;
+    auto endBlock() -> void;
+
+    auto beginProcedure(const Token& name) -> void;
+    auto endProcedure() -> void;
+
+    auto statement(StatementPtr& stmt) -> void;
+
+    auto beginStatements() -> void;
+    auto nextStatement() -> void;
+    auto endStatements() -> void;
+
+    auto beginIf(ExpressionPtr& condition) -> void;
+    auto endIf() -> void;
+
+    auto beginWhile(ExpressionPtr& condition) -> void;
+    auto endWhile() -> void;
+
+    auto beginFor(const Token& variable, ExpressionPtr& from,
+                  ExpressionPtr& to, ExpressionPtr& step) -> void;
+    auto endFor() -> void;
+
     auto visit(Block* block) -> void;
     auto visit(ConstDeclarations* decl) -> void;
     auto visit(VariableDeclarations* decl) -> void;
@@ -63,11 +361,14 @@ private:
     auto visit(BeginStatement* stmt) -> void;
     auto visit(IfStatement* stmt) -> void;
     auto visit(WhileStatement* stmt) -> void;
+    auto visit(ForStatement* stmt) -> void;
+    auto visit(ParallelStatement* stmt) -> void;
     
     auto visit(OddExpression* expr) -> void;
     auto visit(BinaryExpression* expr) -> void;
     auto visit(UnaryExpression* expr) -> void;
     auto visit(VariableExpression* expr) -> void;
+    auto visit(IndexExpression* expr) -> void;
     auto visit(LiteralExpression* expr) -> void;
 
     template<typename... Args>
@@ -76,15 +377,20 @@ private:
         setValue(nullptr);
     }
 
+    template<typename... Args>
+    inline auto warning(std::string_view fmt, Args&&... args) -> void {
+        pushWarning(std::vformat(fmt, std::make_format_args(args...)));
+    }
+
     inline auto codegenStatement(StatementPtr& stmt) -> void {
         if(stmt == nullptr) return;
 
-        stmt->accept(this);
+        os::withStack([&] { stmt->accept(this); });
         setValue(nullptr);
     }
 
     inline auto codegenExpression(ExpressionPtr& expr) -> llvm::Value* {
-        expr->accept(this);
+        os::withStack([&] { expr->accept(this); });
         return getValue();
     }
 
@@ -104,6 +410,108 @@ private:
     LLVMContext m_context;
     IRBuilder<> m_builder = IRBuilder<>(m_context);
     std::unique_ptr<Module> m_module;
+    std::unique_ptr<TargetMachine> m_targetMachine = nullptr;
+
+    unsigned m_optimizationLevel = 0;
+    bool m_wholeProgram = false;
+    bool m_externalGlobals = false;
+    bool m_hostTarget = false;
+
+    ObjectCache* m_objectCache = nullptr;
+
+    // Line of the code being generated.
+    std::uint32_t m_line = 1;
+
+    std::unique_ptr<DIBuilder> m_debugBuilder;
+    DIFile* m_debugFile = nullptr;
+    DISubprogram* m_mainSubprogram = nullptr;
+
+    struct Procedure {
+        std::string_view name;
+        std::uint32_t line;
+        const ProcedureDeclaration* declaration = nullptr;
+
+        // Activation frame holding the captured variables, if any.
+        StructType* frameType = nullptr;
+        Value* frame = nullptr;
+
+        // Frame of the enclosing procedure, if passed as argument.
+        Value* staticLink = nullptr;
+
+        // Start of the body, after the frame setup. Self-recursive calls
+        // in tail position jump back here.
+        BasicBlock* body = nullptr;
+
+        // Where the code of the enclosing procedure continues.
+        BasicBlock* enclosingBlock = nullptr;
+        bool wasTailPosition = false;
+
+        // With -g.
+        DISubprogram* subprogram = nullptr;
+        DebugLoc enclosingLocation = DebugLoc();
+    };
+
+    // Procedures enclosing the code being generated.
+    std::vector<Procedure> m_procedures;
+
+    analysis::CaptureAnalysis m_captures;
+    analysis::EffectAnalysis m_effects;
+    analysis::CallGraphAnalysis m_callGraph;
+
+    bool m_eliminateDeadProcedures = false;
+    bool m_autoParallel = false;
+
+    // The counters are used before their number is known: they are offsets
+    // in a placeholder, replaced by the table in emitProfile.
+    struct ProfileEntry {
+        std::string procedure;
+        std::uint32_t line;
+        std::int32_t kind;
+        std::uint32_t counter;
+    };
+
+    bool m_profileRuntime = false;
+    GlobalVariable* m_profileCounters = nullptr;
+    std::vector<ProfileEntry> m_profileEntries;
+    std::uint32_t m_profileCounterCount = 0;
+
+    // Stores of the counters, made atomic with parallel blocks.
+    std::vector<StoreInst*> m_profileUpdates;
+
+    // Iterations and line of the while loops being generated.
+    std::vector<std::pair<AllocaInst*, std::uint32_t>> m_profiledLoops;
+
+    std::vector<const ProcedureDeclaration*> m_removedProcedures;
+    std::vector<Function*> m_deadFunctions;
+
+    // True while generating a statement after which the procedure returns.
+    bool m_tailPosition = false;
+
+    // Variables of the for loops being generated, they are read-only.
+    std::vector<const SymbolEntry*> m_loopVariables;
+
+    bool m_onePass = false;
+
+    // In one pass a statement is generated before knowing if it's the last
+    // one of its begin...end: its calls in tail position are emitted as tail
+    // calls, and turned back into plain calls when a ';' follows.
+    struct TailCall {
+        CallInst* call;             // nullptr for a self-recursive jump
+        Instruction* exit;          // the ret or the jump
+        BasicBlock* next;
+        Function* procedure;
+        Value* staticLink;
+    };
+
+    std::vector<TailCall> m_tailCalls;
+
+    // First tail call of the current statement of every begin...end.
+    std::vector<std::size_t> m_statementTailCalls;
+
+    // Compound statements being generated in one pass, nullopt when their
+    // code isn't: after an error the body is skipped, like with the AST.
+    std::vector<std::optional<Compound>> m_compounds;
+    std::size_t m_skippedCompounds = 0;
 
     std::shared_ptr<SymbolTable> m_symtable = nullptr; 
 
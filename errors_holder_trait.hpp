@@ -19,14 +19,23 @@ public:
         return m_errors;
     }
 
+    constexpr auto warnings() const -> const std::vector<std::string>& {
+        return m_warnings;
+    }
+
 protected:
     
     constexpr auto pushError(std::string error) -> void {
         m_errors.push_back(std::move(error));
     }
 
+    constexpr auto pushWarning(std::string warning) -> void {
+        m_warnings.push_back(std::move(warning));
+    }
+
 private:
     std::vector<std::string> m_errors;
+    std::vector<std::string> m_warnings;
 };
 
 }
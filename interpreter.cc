@@ -0,0 +1,501 @@
+#include "interpreter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace pl0::interpreter {
+
+using bytecode::OpCode;
+
+static auto wrap(std::int64_t value) -> std::int32_t {
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+}
+
+static auto isJump(OpCode opcode) -> bool {
+    return (opcode >= OpCode::JumpUnlessEqual && opcode <= OpCode::JumpIfFalse)
+        || opcode == OpCode::ForInit
+        || opcode == OpCode::ForNext;
+}
+
+// Calls plus back-edges making a procedure hot, PL0_TIER_THRESHOLD overrides it.
+static constexpr std::uint32_t defaultThreshold = 1000;
+
+Interpreter::Interpreter(const bytecode::Program& program, Tier* tier)
+    : m_program(program), m_tier(tier) {
+
+    if(m_tier == nullptr) return;
+
+    m_threshold = defaultThreshold;
+
+    if(const char* threshold = std::getenv("PL0_TIER_THRESHOLD")) {
+        m_threshold = static_cast<std::uint32_t>(std::max(1L, std::strtol(threshold, nullptr, 10)));
+    }
+
+    m_heat.assign(program.procedures.size(), 0);
+    m_native = std::vector<std::atomic<NativeProcedure>>(program.procedures.size());
+}
+
+auto Interpreter::thread(const void* const* handlers, const void* const* countingHandlers) -> void {
+
+    const auto& code = m_program.code;
+    m_code.resize(code.size());
+
+    for(std::size_t pc = 0; pc < code.size();) {
+        const auto opcode = static_cast<OpCode>(code[pc]);
+        const std::uint32_t operands = bytecode::operandCount(opcode);
+
+        m_code[pc].handler = handlers[code[pc]];
+
+        if(countingHandlers != nullptr) {
+            switch(opcode) {
+                case OpCode::Call: m_code[pc].handler = countingHandlers[0]; break;
+                case OpCode::TailCall: m_code[pc].handler = countingHandlers[1]; break;
+                case OpCode::ForNext: m_code[pc].handler = countingHandlers[2]; break;
+                case OpCode::Jump:
+                    // Backward jumps close the while loops.
+                    if(static_cast<std::size_t>(code[pc + 1]) <= pc) m_code[pc].handler = countingHandlers[3];
+                    break;
+                default: break;
+            }
+        }
+
+        for(std::uint32_t i = 1; i <= operands; i++) {
+            m_code[pc + i].operand = code[pc + i];
+        }
+
+        // The target is always the last operand.
+        if(isJump(opcode)) {
+            m_code[pc + operands].target = m_code.data() + code[pc + operands];
+        }
+
+        pc += operands + 1;
+    }
+
+    for(const auto& procedure : m_program.procedures) {
+        m_entries.push_back(m_code.data() + procedure.entry);
+    }
+
+    // Every instruction pushes at most one value.
+    m_stack.resize(code.size() + 1);
+}
+
+auto Interpreter::reserve(std::size_t top) -> void {
+    if(top > m_memory.size()) {
+        m_memory.resize(std::max(top, m_memory.size() * 2));
+    }
+}
+
+auto Interpreter::indexError(std::int64_t line, std::int32_t index, std::int64_t length) -> void {
+    std::printf("[Ln: %d] Runtime Error: index %d out of bounds, the length is %d.\n",
+                static_cast<int>(line), index, static_cast<int>(length));
+
+    if(m_tier != nullptr) m_tier->stop();
+    std::exit(EXIT_FAILURE);
+}
+
+auto Interpreter::divisionError(std::int64_t line) -> void {
+    std::printf("[Ln: %d] Runtime Error: division by zero.\n", static_cast<int>(line));
+
+    if(m_tier != nullptr) m_tier->stop();
+    std::exit(EXIT_FAILURE);
+}
+
+auto Interpreter::run() -> int {
+
+    // In the order of the opcodes.
+    static const void* const handlers[] = {
+        &&Push, &&Dup,
+        &&LoadGlobal, &&StoreGlobal, &&LoadLocal, &&StoreLocal, &&LoadOuter, &&StoreOuter,
+        &&LoadGlobalElement, &&StoreGlobalElement, &&LoadLocalElement, &&StoreLocalElement,
+        &&LoadOuterElement, &&StoreOuterElement,
+        &&Add, &&Sub, &&Mul, &&Div, &&Negate, &&Odd,
+        &&Equal, &&NotEqual, &&Less, &&LessEqual, &&Greater, &&GreaterEqual,
+        &&AddImmediate, &&AddGlobal, &&AddLocal, &&AddGlobalImmediate, &&AddLocalImmediate,
+        &&JumpUnlessEqual, &&JumpUnlessNotEqual, &&JumpUnlessLess, &&JumpUnlessLessEqual,
+        &&JumpUnlessGreater, &&JumpUnlessGreaterEqual,
+        &&Jump, &&JumpIfFalse,
+        &&ForInit, &&ForNext,
+        &&Call, &&TailCall, &&Return,
+        &&Print, &&Input,
+        &&Halt,
+    };
+
+    static_assert(std::size(handlers) == static_cast<std::size_t>(OpCode::Count));
+
+    static const void* const countingHandlers[] = {
+        &&CountedCall, &&CountedTailCall, &&CountedForNext, &&CountedJump,
+    };
+
+    thread(handlers, m_tier != nullptr ? countingHandlers : nullptr);
+
+    m_globals.assign(m_program.globals, 0);
+
+    if(m_tier != nullptr) {
+        m_tier->start(m_globals.data(), m_native.data());
+    }
+
+    std::uint32_t fp = 0;
+    std::size_t top = m_program.procedures[0].frameSize;
+
+    m_memory.assign(std::max<std::size_t>(top, 1024), 0);
+
+    std::int32_t* globals = m_globals.data();
+    std::int32_t* memory = m_memory.data();
+    std::int32_t* frame = memory + fp;
+    std::int32_t* sp = m_stack.data();
+
+    const Word* pc = m_entries[0];
+    std::uint32_t procedure = 0;
+
+    // sp points to the first free slot of the stack.
+    #define DISPATCH() goto *pc->handler
+    #define NEXT(operands) do { pc += (operands) + 1; DISPATCH(); } while(0)
+    #define OPERAND(n) pc[n].operand
+
+    #define BINARY(expression) do {     \
+        const std::int64_t b = *--sp;   \
+        const std::int64_t a = sp[-1];  \
+        sp[-1] = (expression);          \
+        NEXT(0);                        \
+    } while(0)
+
+    #define JUMP_UNLESS(condition) do {                 \
+        const std::int32_t b = *--sp;                   \
+        const std::int32_t a = *--sp;                   \
+        if(condition) NEXT(1);                          \
+        pc = pc[1].target;                              \
+        DISPATCH();                                     \
+    } while(0)
+
+    // Frame of the procedure `levels` static links up.
+    const auto outer = [&memory](std::int32_t* frame, std::int64_t levels) {
+        while(levels-- > 0) frame = memory + frame[0];
+        return frame;
+    };
+
+    DISPATCH();
+
+Push:
+    *sp++ = static_cast<std::int32_t>(OPERAND(1));
+    NEXT(1);
+
+Dup:
+    *sp = sp[-1];
+    sp++;
+    NEXT(0);
+
+LoadGlobal:
+    *sp++ = globals[OPERAND(1)];
+    NEXT(1);
+
+StoreGlobal:
+    globals[OPERAND(1)] = *--sp;
+    NEXT(1);
+
+LoadLocal:
+    *sp++ = frame[OPERAND(1)];
+    NEXT(1);
+
+StoreLocal:
+    frame[OPERAND(1)] = *--sp;
+    NEXT(1);
+
+LoadOuter:
+    *sp++ = outer(frame, OPERAND(1))[OPERAND(2)];
+    NEXT(2);
+
+StoreOuter:
+    outer(frame, OPERAND(1))[OPERAND(2)] = *--sp;
+    NEXT(2);
+
+LoadGlobalElement: {
+    const std::int32_t index = sp[-1];
+    if(static_cast<std::uint32_t>(index) >= OPERAND(2)) indexError(OPERAND(3), index, OPERAND(2));
+    sp[-1] = globals[OPERAND(1) + index];
+    NEXT(3);
+}
+
+StoreGlobalElement: {
+    const std::int32_t value = *--sp;
+    const std::int32_t index = *--sp;
+    if(static_cast<std::uint32_t>(index) >= OPERAND(2)) indexError(OPERAND(3), index, OPERAND(2));
+    globals[OPERAND(1) + index] = value;
+    NEXT(3);
+}
+
+LoadLocalElement: {
+    const std::int32_t index = sp[-1];
+    if(static_cast<std::uint32_t>(index) >= OPERAND(2)) indexError(OPERAND(3), index, OPERAND(2));
+    sp[-1] = frame[OPERAND(1) + index];
+    NEXT(3);
+}
+
+StoreLocalElement: {
+    const std::int32_t value = *--sp;
+    const std::int32_t index = *--sp;
+    if(static_cast<std::uint32_t>(index) >= OPERAND(2)) indexError(OPERAND(3), index, OPERAND(2));
+    frame[OPERAND(1) + index] = value;
+    NEXT(3);
+}
+
+LoadOuterElement: {
+    const std::int32_t index = sp[-1];
+    if(static_cast<std::uint32_t>(index) >= OPERAND(3)) indexError(OPERAND(4), index, OPERAND(3));
+    sp[-1] = outer(frame, OPERAND(1))[OPERAND(2) + index];
+    NEXT(4);
+}
+
+StoreOuterElement: {
+    const std::int32_t value = *--sp;
+    const std::int32_t index = *--sp;
+    if(static_cast<std::uint32_t>(index) >= OPERAND(3)) indexError(OPERAND(4), index, OPERAND(3));
+    outer(frame, OPERAND(1))[OPERAND(2) + index] = value;
+    NEXT(4);
+}
+
+Add:
+    BINARY(wrap(a + b));
+
+Sub:
+    BINARY(wrap(a - b));
+
+Mul:
+    BINARY(wrap(a * b));
+
+Div: {
+    const std::int64_t b = *--sp;
+    const std::int64_t a = sp[-1];
+    if(b == 0) divisionError(OPERAND(1));
+    sp[-1] = wrap(a / b);
+    NEXT(1);
+}
+
+Negate:
+    sp[-1] = wrap(-static_cast<std::int64_t>(sp[-1]));
+    NEXT(0);
+
+Odd:
+    sp[-1] = sp[-1] % 2 != 0;
+    NEXT(0);
+
+Equal:
+    BINARY(a == b);
+
+NotEqual:
+    BINARY(a != b);
+
+Less:
+    BINARY(a < b);
+
+LessEqual:
+    BINARY(a <= b);
+
+Greater:
+    BINARY(a > b);
+
+GreaterEqual:
+    BINARY(a >= b);
+
+AddImmediate:
+    sp[-1] = wrap(static_cast<std::int64_t>(sp[-1]) + OPERAND(1));
+    NEXT(1);
+
+AddGlobal: {
+    std::int32_t& variable = globals[OPERAND(1)];
+    variable = wrap(static_cast<std::int64_t>(variable) + *--sp);
+    NEXT(1);
+}
+
+AddLocal: {
+    std::int32_t& variable = frame[OPERAND(1)];
+    variable = wrap(static_cast<std::int64_t>(variable) + *--sp);
+    NEXT(1);
+}
+
+AddGlobalImmediate: {
+    std::int32_t& variable = globals[OPERAND(1)];
+    variable = wrap(static_cast<std::int64_t>(variable) + OPERAND(2));
+    NEXT(2);
+}
+
+AddLocalImmediate: {
+    std::int32_t& variable = frame[OPERAND(1)];
+    variable = wrap(static_cast<std::int64_t>(variable) + OPERAND(2));
+    NEXT(2);
+}
+
+JumpUnlessEqual:
+    JUMP_UNLESS(a == b);
+
+JumpUnlessNotEqual:
+    JUMP_UNLESS(a != b);
+
+JumpUnlessLess:
+    JUMP_UNLESS(a < b);
+
+JumpUnlessLessEqual:
+    JUMP_UNLESS(a <= b);
+
+JumpUnlessGreater:
+    JUMP_UNLESS(a > b);
+
+JumpUnlessGreaterEqual:
+    JUMP_UNLESS(a >= b);
+
+Jump:
+    pc = pc[1].target;
+    DISPATCH();
+
+JumpIfFalse:
+    if(*--sp != 0) NEXT(1);
+    pc = pc[1].target;
+    DISPATCH();
+
+ForInit: {
+    const std::int64_t to = *--sp;
+    const std::int64_t from = *--sp;
+    const std::int64_t step = OPERAND(2);
+
+    const std::int64_t distance = step > 0 ? to - from : from - to;
+
+    if(distance < 0) {
+        pc = pc[3].target;
+        DISPATCH();
+    }
+
+    std::int32_t* loop = frame + OPERAND(1);
+
+    loop[0] = static_cast<std::int32_t>(from);
+    loop[1] = wrap(distance / (step > 0 ? step : -step));
+
+    *sp++ = loop[0];
+    NEXT(3);
+}
+
+ForNext: {
+    std::int32_t* loop = frame + OPERAND(1);
+
+    if(loop[1] == 0) NEXT(3);
+
+    loop[1] = wrap(static_cast<std::uint32_t>(loop[1]) - 1);
+    loop[0] = wrap(static_cast<std::int64_t>(loop[0]) + OPERAND(2));
+
+    *sp++ = loop[0];
+    pc = pc[3].target;
+    DISPATCH();
+}
+
+Call: {
+    const auto& callee = m_program.procedures[OPERAND(1)];
+    const auto link = static_cast<std::int32_t>(outer(frame, OPERAND(2)) - memory);
+
+    m_calls.push_back({pc + 3, fp, procedure});
+    procedure = static_cast<std::uint32_t>(OPERAND(1));
+
+    fp = static_cast<std::uint32_t>(top);
+    top += callee.frameSize;
+
+    reserve(top);
+    memory = m_memory.data();
+    frame = memory + fp;
+
+    std::fill(frame, memory + top, 0);
+    frame[0] = link;
+
+    pc = m_entries[OPERAND(1)];
+    DISPATCH();
+}
+
+TailCall: {
+    // The caller's frame is replaced, the static link is above it.
+    const auto& callee = m_program.procedures[OPERAND(1)];
+    const auto link = static_cast<std::int32_t>(outer(frame, OPERAND(2)) - memory);
+
+    top = fp + callee.frameSize;
+
+    reserve(top);
+    memory = m_memory.data();
+    frame = memory + fp;
+
+    std::fill(frame, memory + top, 0);
+    frame[0] = link;
+
+    procedure = static_cast<std::uint32_t>(OPERAND(1));
+    pc = m_entries[OPERAND(1)];
+    DISPATCH();
+}
+
+Return: {
+    const CallRecord caller = m_calls.back();
+    m_calls.pop_back();
+
+    top = fp;
+    fp = caller.frame;
+    frame = memory + fp;
+    procedure = caller.procedure;
+
+    pc = caller.returnAddress;
+    DISPATCH();
+}
+
+CountedCall: {
+    const auto callee = static_cast<std::uint32_t>(OPERAND(1));
+
+    // The native code uses only the globals, the interpreter state is
+    // untouched.
+    if(const NativeProcedure native = m_native[callee].load(std::memory_order_acquire)) {
+        native();
+        NEXT(2);
+    }
+
+    if(++m_heat[callee] == m_threshold) m_tier->compile(callee);
+    goto Call;
+}
+
+CountedTailCall: {
+    const auto callee = static_cast<std::uint32_t>(OPERAND(1));
+
+    if(const NativeProcedure native = m_native[callee].load(std::memory_order_acquire)) {
+        native();
+        goto Return;
+    }
+
+    if(++m_heat[callee] == m_threshold) m_tier->compile(callee);
+    goto TailCall;
+}
+
+CountedForNext:
+    if(++m_heat[procedure] == m_threshold && procedure != 0) m_tier->compile(procedure);
+    goto ForNext;
+
+CountedJump:
+    if(++m_heat[procedure] == m_threshold && procedure != 0) m_tier->compile(procedure);
+    goto Jump;
+
+Print:
+    std::printf("%d\n", *--sp);
+    NEXT(0);
+
+Input: {
+    // The variable keeps its value when the input isn't a number.
+    int value;
+    if(std::scanf("%d", &value) == 1) sp[-1] = value;
+    NEXT(0);
+}
+
+Halt:
+    #undef DISPATCH
+    #undef NEXT
+    #undef OPERAND
+    #undef BINARY
+    #undef JUMP_UNLESS
+
+    // The tier writes in m_native until it's stopped.
+    if(m_tier != nullptr) m_tier->stop();
+
+    return EXIT_SUCCESS;
+}
+
+}
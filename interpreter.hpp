@@ -0,0 +1,102 @@
+#ifndef _INTERPRETER_HPP_
+#define _INTERPRETER_HPP_
+
+#include "bytecode.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace pl0::interpreter {
+
+using NativeProcedure = void (*)();
+
+// Compiles the hot procedures to native code (-tiered), the interpreter
+// calls them at the next call.
+class Tier {
+public:
+    virtual ~Tier() = default;
+
+    // `globals` is the memory of the global variables, shared with the
+    // native code. The native procedures are published in `entries`.
+    virtual auto start(std::int32_t* globals, std::atomic<NativeProcedure>* entries) -> void = 0;
+
+    // Asks for the native code of a hot procedure, it doesn't wait for it.
+    virtual auto compile(std::uint32_t procedure) -> void = 0;
+
+    // Waits for the compilation in progress, nothing is published in
+    // `entries` afterwards. Called before the interpreter memory is freed
+    // and before exiting the process.
+    virtual auto stop() -> void = 0;
+};
+
+/*
+
+Direct-threaded interpreter of the bytecode: every opcode is replaced by
+the address of the code executing it, so an instruction jumps straight to
+the next one (computed goto) instead of going back to a dispatch switch.
+
+The jump targets become pointers to the threaded code too.
+
+With a tier, calls and loop back-edges are counted per procedure: a
+procedure crossing the threshold is handed to the tier, and its calls go to
+the native code as soon as it's ready.
+
+*/
+class Interpreter final {
+public:
+    explicit Interpreter(const bytecode::Program& program, Tier* tier = nullptr);
+
+    // Runs the program, returns its exit status.
+    auto run() -> int;
+
+private:
+
+    union Word {
+        const void* handler;
+        const Word* target;
+        std::int64_t operand;
+    };
+
+    struct CallRecord {
+        const Word* returnAddress;
+        std::uint32_t frame;
+        std::uint32_t procedure;
+    };
+
+    // The counting handlers replace the ones of the calls and the loop
+    // back-edges when there is a tier.
+    auto thread(const void* const* handlers, const void* const* countingHandlers) -> void;
+
+    // Makes room for the frames up to `top`.
+    auto reserve(std::size_t top) -> void;
+
+    [[noreturn]]
+    auto indexError(std::int64_t line, std::int32_t index, std::int64_t length) -> void;
+
+    [[noreturn]]
+    auto divisionError(std::int64_t line) -> void;
+
+private:
+    const bytecode::Program& m_program;
+
+    std::vector<Word> m_code;
+    std::vector<const Word*> m_entries;
+
+    // The globals never move, the native code uses them.
+    std::vector<std::int32_t> m_globals;
+    std::vector<std::int32_t> m_memory;
+    std::vector<std::int32_t> m_stack;
+    std::vector<CallRecord> m_calls;
+
+    Tier* m_tier;
+    std::uint32_t m_threshold = 0;
+
+    // Calls and back-edges of every procedure.
+    std::vector<std::uint32_t> m_heat;
+    std::vector<std::atomic<NativeProcedure>> m_native;
+};
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include "jit.hpp"
+#include "codegen.hpp"
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace pl0::jit {
+
+using namespace llvm;
+
+namespace {
+
+// The tier whose native code is running. The runtime errors of that code
+// exit through exitProcess, which stops it first like the interpreter.
+std::atomic<NativeTier*> running = nullptr;
+
+[[noreturn]] auto exitProcess(int status) -> void {
+    if(NativeTier* tier = running.load()) tier->stop();
+    std::exit(status);
+}
+
+}
+
+NativeTier::NativeTier(ast::StatementPtr ast, const bytecode::Program& program)
+    : m_ast(std::move(ast)), m_program(program), m_visited(program.procedures.size(), false) {}
+
+NativeTier::~NativeTier() {
+    stop();
+
+    NativeTier* self = this;
+    running.compare_exchange_strong(self, nullptr);
+}
+
+auto NativeTier::stop() -> void {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_wakeup.notify_one();
+
+    if(m_worker.joinable()) m_worker.join();
+}
+
+auto NativeTier::start(std::int32_t* globals, std::atomic<NativeProcedure>* entries) -> void {
+    m_globals = globals;
+    m_entries = entries;
+
+    if(!m_cacheDirectory.empty()) {
+        const std::string target = codegen::hostCpuName() + ' ' + codegen::hostCpuFeatures()
+            + " -O" + std::to_string(m_optimizationLevel);
+
+        m_cache = std::make_unique<cache::DiskCache>(m_cacheDirectory, target);
+    }
+
+    running = this;
+    m_worker = std::thread(&NativeTier::work, this);
+}
+
+auto NativeTier::compile(std::uint32_t procedure) -> void {
+    {
+        std::lock_guard lock(m_mutex);
+        m_requests.push_back(procedure);
+    }
+
+    m_wakeup.notify_one();
+}
+
+auto NativeTier::work() -> void {
+
+    std::unique_lock lock(m_mutex);
+
+    while(true) {
+        m_wakeup.wait(lock, [this] { return m_stopping || !m_requests.empty(); });
+        if(m_stopping) return;
+
+        const std::uint32_t procedure = m_requests.front();
+        m_requests.pop_front();
+
+        lock.unlock();
+        tierUp(procedure);
+        lock.lock();
+    }
+}
+
+auto NativeTier::createJit() -> bool {
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    orc::LLJITBuilder builder;
+
+    if(!m_sourcePath.empty()) {
+        std::error_code error;
+        m_perfMap = std::make_unique<raw_fd_ostream>("/tmp/perf-" + std::to_string(::getpid()) + ".map", error);
+
+        if(error) m_perfMap.reset();
+
+        // The loaded objects tell where their sections are, to list the functions.
+        builder.setObjectLinkingLayerCreator([this](orc::ExecutionSession& session, const Triple&) {
+            auto layer = std::make_unique<orc::RTDyldObjectLinkingLayer>(session, [] {
+                return std::make_unique<SectionMemoryManager>();
+            });
+
+            layer->setNotifyLoaded([this](orc::MaterializationResponsibility&, const object::ObjectFile& object,
+                                          const RuntimeDyld::LoadedObjectInfo& info) {
+                writePerfMap(object, info);
+            });
+
+            return Expected<std::unique_ptr<orc::ObjectLayer>>(std::move(layer));
+        });
+    }
+
+    auto jit = builder.create();
+
+    if(!jit) {
+        consumeError(jit.takeError());
+        return false;
+    }
+
+    orc::JITDylib& library = (*jit)->getMainJITDylib();
+
+    // printf and scanf come from the process.
+    auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+
+    if(!process) {
+        consumeError(process.takeError());
+        return false;
+    }
+
+    library.addGenerator(std::move(*process));
+
+    orc::SymbolMap symbols;
+
+    for(const auto& [name, address] : m_program.variables) {
+        symbols[(*jit)->mangleAndIntern("pl0." + name)] = {
+            orc::ExecutorAddr::fromPtr(m_globals + address),
+            JITSymbolFlags::Exported
+        };
+    }
+
+    // Defined here, the process exit isn't looked up.
+    symbols[(*jit)->mangleAndIntern("exit")] = {
+        orc::ExecutorAddr::fromPtr(&exitProcess),
+        JITSymbolFlags::Exported | JITSymbolFlags::Callable
+    };
+
+    if(Error error = library.define(orc::absoluteSymbols(std::move(symbols)))) {
+        consumeError(std::move(error));
+        return false;
+    }
+
+    m_jit = std::move(*jit);
+    return true;
+}
+
+auto NativeTier::writePerfMap(const object::ObjectFile& object, const RuntimeDyld::LoadedObjectInfo& info) -> void {
+
+    if(m_perfMap == nullptr) return;
+
+    // A copy of the object with the sections at their load addresses.
+    const object::OwningBinary<object::ObjectFile> loaded = info.getObjectForDebug(object);
+    if(loaded.getBinary() == nullptr) return;
+
+    for(const auto& [symbol, size] : object::computeSymbolSizes(*loaded.getBinary())) {
+        auto type = symbol.getType();
+        auto name = symbol.getName();
+        auto address = symbol.getAddress();
+
+        if(!type || !name || !address) {
+            consumeError(type.takeError());
+            consumeError(name.takeError());
+            consumeError(address.takeError());
+            continue;
+        }
+
+        if(*type != object::SymbolRef::ST_Function || size == 0) continue;
+
+        *m_perfMap << format_hex_no_prefix(*address, 1) << ' ' << format_hex_no_prefix(size, 1) << ' ' << *name << '\n';
+    }
+
+    m_perfMap->flush();
+}
+
+auto NativeTier::tierUp(std::uint32_t procedure) -> void {
+
+    if(m_visited[procedure]) return;
+
+    if(m_jit == nullptr && !createJit()) return;
+
+    codegen::CodeGenerator codegen("pl0.tier");
+    codegen.setOptimizationLevel(m_optimizationLevel);
+    codegen.setWholeProgram(true);
+    codegen.setExternalGlobals(true);
+    codegen.setHostTarget(true);
+    codegen.setObjectCache(m_cache.get());
+
+    if(!m_sourcePath.empty()) codegen.setDebugInfo(m_sourcePath);
+
+    if(!codegen.generate(m_ast) || codegen.hadError()) {
+        m_visited[procedure] = true;
+        return;
+    }
+
+    // From the hot procedure outwards, the first one that can switch.
+    std::uint32_t candidate = procedure;
+
+    while(candidate != 0 && !m_visited[candidate] && !codegen.isStandalone(mangle(candidate))) {
+        m_visited[candidate] = true;
+        candidate = m_program.procedures[candidate].parent;
+    }
+
+    if(candidate == 0 || m_visited[candidate]) return;
+
+    m_visited[candidate] = true;
+
+    const std::string name = mangle(candidate);
+
+    codegen.extractProcedure(name);
+
+    std::unique_ptr<MemoryBuffer> object = codegen.cachedObject();
+
+    if(object == nullptr) {
+        codegen.optimize();
+        object = codegen.produceObjectBuffer();
+    }
+
+    if(object == nullptr) return;
+
+    if(Error error = m_jit->addObjectFile(std::move(object))) {
+        consumeError(std::move(error));
+        return;
+    }
+
+    auto address = m_jit->lookup(name);
+
+    if(!address) {
+        consumeError(address.takeError());
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+    if(m_stopping) return;
+
+    m_entries[candidate].store(address->toPtr<NativeProcedure>(), std::memory_order_release);
+}
+
+auto NativeTier::mangle(std::uint32_t procedure) const -> std::string {
+
+    std::string mangled = m_program.procedures[procedure].name;
+
+    for(std::uint32_t parent = m_program.procedures[procedure].parent; parent != 0;
+        parent = m_program.procedures[parent].parent) {
+        mangled = m_program.procedures[parent].name + '.' + mangled;
+    }
+
+    return "pl0." + mangled;
+}
+
+}
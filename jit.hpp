@@ -0,0 +1,119 @@
+#ifndef _JIT_HPP_
+#define _JIT_HPP_
+
+#include "ast.hpp"
+#include "bytecode.hpp"
+#include "cache.hpp"
+#include "interpreter.hpp"
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pl0::jit {
+
+using interpreter::NativeProcedure;
+
+/*
+
+Optimizing tier of the interpreter (-tiered). The hot procedures are
+compiled by the CodeGenerator on a background thread, linked in process
+with ORC and published to the interpreter, which calls them from then on.
+
+The native code keeps the globals in the interpreter memory, so only the
+procedures without a static link can switch: when a nested procedure is hot,
+the nearest enclosing one without it is compiled instead. Procedures
+starting parallel blocks stay in the interpreter. The runtime errors of the
+native code stop the tier before exiting, like those of the interpreter.
+
+With -g the code has frame pointers and every function linked is listed in
+/tmp/perf-<pid>.map, where perf looks up the symbols of the code it can't
+find in a file.
+
+*/
+class NativeTier final : public interpreter::Tier {
+public:
+    // The AST is kept to generate the code of the hot procedures.
+    NativeTier(ast::StatementPtr ast, const bytecode::Program& program);
+    ~NativeTier() override;
+
+    NativeTier(const NativeTier&) = delete;
+    NativeTier& operator=(const NativeTier&) = delete;
+
+    // From 0 to 3, like -O0 ... -O3.
+    inline auto setOptimizationLevel(unsigned level) -> void {
+        m_optimizationLevel = level;
+    }
+
+    // Keeps the compiled procedures in `directory` for the next runs,
+    // empty disables the cache.
+    inline auto setCacheDirectory(std::string directory) -> void {
+        m_cacheDirectory = std::move(directory);
+    }
+
+    // Compiles with the line table of `sourcePath` and writes the perf map.
+    inline auto setDebugInfo(std::string sourcePath) -> void {
+        m_sourcePath = std::move(sourcePath);
+    }
+
+    auto start(std::int32_t* globals, std::atomic<NativeProcedure>* entries) -> void override;
+    auto compile(std::uint32_t procedure) -> void override;
+    auto stop() -> void override;
+
+private:
+
+    // Body of the background thread.
+    auto work() -> void;
+
+    auto createJit() -> bool;
+
+    // Adds the functions of an object just loaded to the perf map.
+    auto writePerfMap(const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info) -> void;
+
+    auto tierUp(std::uint32_t procedure) -> void;
+
+    // Name of the procedure in the generated code: pl0.outer.inner
+    auto mangle(std::uint32_t procedure) const -> std::string;
+
+private:
+    ast::StatementPtr m_ast;
+    const bytecode::Program& m_program;
+
+    unsigned m_optimizationLevel = 2;
+
+    std::string m_cacheDirectory;
+    std::unique_ptr<cache::DiskCache> m_cache;
+
+    std::int32_t* m_globals = nullptr;
+    std::atomic<NativeProcedure>* m_entries = nullptr;
+
+    std::unique_ptr<llvm::orc::LLJIT> m_jit;
+
+    // With -g.
+    std::string m_sourcePath;
+    std::unique_ptr<llvm::raw_fd_ostream> m_perfMap;
+
+    // Procedures already compiled or unable to switch, used by the
+    // background thread only.
+    std::vector<bool> m_visited;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<std::uint32_t> m_requests;
+    bool m_stopping = false;
+
+    std::thread m_worker;
+};
+
+}
+
+#endif
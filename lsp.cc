@@ -0,0 +1,631 @@
+#include "lsp.hpp"
+#include "os.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
+namespace pl0::lsp {
+
+using namespace ast;
+using parser::Parser;
+using tokenizer::Tokenizer;
+
+namespace json = llvm::json;
+
+namespace {
+
+// Slot of the AST holding `target`, searched from the node of the region
+// around it without entering the other regions.
+class SlotFinder final : public AstVisitor {
+public:
+    explicit SlotFinder(Statement* target)
+        : m_target(target) {}
+
+    auto find(Statement* root) -> StatementPtr* {
+        m_root = root;
+        root->accept(this);
+
+        return m_slot;
+    }
+
+private:
+    auto visitSlot(StatementPtr& slot) -> void {
+        if(m_slot != nullptr || slot == nullptr) return;
+
+        if(slot.get() == m_target) {
+            m_slot = &slot;
+        } else {
+            os::withStack([&] { slot->accept(this); });
+        }
+    }
+
+    auto visit(Block* block) -> void {
+        for(auto& procedure : block->procedureDeclarations) visitSlot(procedure);
+        visitSlot(block->statement);
+    }
+
+    auto visit(ConstDeclarations* decl) -> void {}
+    auto visit(VariableDeclarations* decl) -> void {}
+
+    auto visit(ProcedureDeclaration* decl) -> void {
+        if(decl == m_root) visitSlot(decl->block);
+    }
+
+    auto visit(AssignStatement* stmt) -> void {}
+    auto visit(CallStatement* stmt) -> void {}
+    auto visit(InputStatement* stmt) -> void {}
+    auto visit(PrintStatement* stmt) -> void {}
+
+    auto visit(BeginStatement* stmt) -> void {
+        if(stmt != m_root) return;
+
+        for(auto& statement : stmt->statements) visitSlot(statement);
+    }
+
+    auto visit(IfStatement* stmt) -> void { visitSlot(stmt->body); }
+    auto visit(WhileStatement* stmt) -> void { visitSlot(stmt->body); }
+    auto visit(ForStatement* stmt) -> void { visitSlot(stmt->body); }
+    auto visit(ParallelStatement* stmt) -> void {}
+
+    auto visit(OddExpression* expr) -> void {}
+    auto visit(BinaryExpression* expr) -> void {}
+    auto visit(UnaryExpression* expr) -> void {}
+    auto visit(VariableExpression* expr) -> void {}
+    auto visit(IndexExpression* expr) -> void {}
+    auto visit(LiteralExpression* expr) -> void {}
+
+private:
+    Statement* m_target;
+    Statement* m_root = nullptr;
+    StatementPtr* m_slot = nullptr;
+};
+
+// The parser errors start with "[Ln: <line>]".
+auto toDiagnostic(std::string_view error) -> Diagnostic {
+
+    Diagnostic diagnostic = {1, std::string(error)};
+
+    const std::size_t close = error.find(']');
+    if(!error.starts_with("[Ln") || close == std::string_view::npos) return diagnostic;
+
+    const std::size_t digits = error.find_first_of("0123456789");
+    if(digits > close) return diagnostic;
+
+    std::from_chars(error.data() + digits, error.data() + close, diagnostic.line);
+
+    error.remove_prefix(close + 1);
+    if(error.starts_with(' ')) error.remove_prefix(1);
+
+    diagnostic.message = error;
+    return diagnostic;
+}
+
+auto splitLines(std::string_view text) -> std::vector<std::unique_ptr<std::string>> {
+
+    std::vector<std::unique_ptr<std::string>> lines;
+
+    while(true) {
+        const std::size_t newline = text.find('\n');
+        lines.push_back(std::make_unique<std::string>(text.substr(0, newline)));
+
+        if(newline == std::string_view::npos) return lines;
+        text.remove_prefix(newline + 1);
+    }
+}
+
+// Replaces the elements [first, last) of `elements`, moving only the ones
+// after them and only when the count changes.
+template<typename T>
+auto splice(std::vector<T>& elements, std::size_t first, std::size_t last, std::vector<T> replacement) -> void {
+
+    const std::size_t common = std::min(last - first, replacement.size());
+    std::move(replacement.begin(), replacement.begin() + common, elements.begin() + first);
+
+    if(common < replacement.size()) {
+        elements.insert(elements.begin() + last,
+                        std::make_move_iterator(replacement.begin() + common),
+                        std::make_move_iterator(replacement.end()));
+    } else {
+        elements.erase(elements.begin() + first + common, elements.begin() + last);
+    }
+}
+
+// Bytes of the UTF-8 character starting with `byte`, 1 for a stray
+// continuation byte.
+constexpr auto characterBytes(unsigned char byte) -> std::uint32_t {
+    return byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+}
+
+// The characters out of the Basic Multilingual Plane are surrogate pairs.
+constexpr auto utf16Units(std::uint32_t bytes) -> std::uint32_t {
+    return bytes == 4 ? 2 : 1;
+}
+
+// Byte offset in `line` of the UTF-16 offset `units`, the end of the line
+// past it.
+auto utf16ToBytes(std::string_view line, std::uint32_t units) -> std::uint32_t {
+
+    std::uint32_t bytes = 0;
+
+    while(bytes < line.size() && units > 0) {
+        const std::uint32_t size = characterBytes(line[bytes]);
+        if(units < utf16Units(size)) break;
+
+        units -= utf16Units(size);
+        bytes = std::min<std::uint32_t>(bytes + size, line.size());
+    }
+
+    return bytes;
+}
+
+auto bytesToUtf16(std::string_view line, std::uint32_t bytes) -> std::uint32_t {
+
+    std::uint32_t units = 0;
+
+    for(std::uint32_t i = 0; i < std::min<std::size_t>(bytes, line.size());) {
+        const std::uint32_t size = characterBytes(line[i]);
+
+        units += utf16Units(size);
+        i += size;
+    }
+
+    return units;
+}
+
+auto toRange(std::uint32_t line, std::uint32_t start, std::uint32_t end) -> json::Object {
+    return json::Object{
+        {"start", json::Object{{"line", line - 1}, {"character", start}}},
+        {"end", json::Object{{"line", line - 1}, {"character", end}}}
+    };
+}
+
+}
+
+// Document
+
+Document::Document(std::string_view text)
+    : m_lines(splitLines(text)) {
+
+    m_tokens = lex(1, m_lines.size());
+    parseProgram();
+}
+
+auto Document::text() const -> std::string {
+
+    std::string text;
+
+    for(const auto& line : m_lines) {
+        if(&line != &m_lines.front()) text += '\n';
+        text += *line;
+    }
+
+    return text;
+}
+
+auto Document::lex(std::uint32_t line, std::uint32_t count) const -> std::vector<Token> {
+
+    std::vector<Token> tokens;
+
+    // Tokens never span lines.
+    for(std::uint32_t i = line; i < line + count; i++) {
+        std::vector<Token> lineTokens = Tokenizer(*m_lines[i - 1], i).tokenize();
+        tokens.insert(tokens.end(), lineTokens.begin(), lineTokens.end() - 1);
+    }
+
+    return tokens;
+}
+
+auto Document::edit(Position start, Position end, std::string_view text) -> void {
+
+    const auto lastLine = static_cast<std::uint32_t>(m_lines.size() - 1);
+
+    start.line = std::min(start.line, lastLine);
+    end.line = std::min(end.line, lastLine);
+
+    if(end.line < start.line || (end.line == start.line && end.character < start.character)) {
+        std::swap(start, end);
+    }
+
+    const std::string& first = *m_lines[start.line];
+    const std::string& last = *m_lines[end.line];
+
+    std::string replaced = first.substr(0, std::min<std::size_t>(start.character, first.size()));
+    replaced += text;
+    replaced += std::string_view(last).substr(std::min<std::size_t>(end.character, last.size()));
+
+    auto lines = splitLines(replaced);
+
+    const std::int64_t lineDelta = static_cast<std::int64_t>(lines.size()) - (end.line - start.line + 1);
+
+    splice(m_lines, start.line, end.line + 1, std::move(lines));
+
+    // Tokens of the replaced lines, the lines of the tokens count from 1.
+    const auto lineBegin = [this](std::uint32_t line) {
+        return static_cast<std::uint32_t>(std::partition_point(m_tokens.begin(), m_tokens.end(), [line](const Token& token) {
+            return token.line < line;
+        }) - m_tokens.begin());
+    };
+
+    const std::uint32_t firstToken = lineBegin(start.line + 1);
+    const std::uint32_t lastToken = lineBegin(end.line + 2);
+
+    std::vector<Token> tokens = lex(start.line + 1, end.line - start.line + 1 + lineDelta);
+    const std::size_t lexed = tokens.size();
+    const std::int64_t tokenDelta = static_cast<std::int64_t>(lexed) - (lastToken - firstToken);
+
+    splice(m_tokens, firstToken, lastToken, std::move(tokens));
+
+    if(lineDelta != 0) {
+        for(auto token = m_tokens.begin() + firstToken + lexed; token != m_tokens.end(); token++) {
+            token->line += lineDelta;
+        }
+    }
+
+    m_reparsedTokens = 0;
+
+    // The regions still have the indices of the old tokens.
+    for(std::size_t region = enclosingRegion(firstToken, lastToken); region != m_regions.size();
+        region = enclosingRegion(m_regions[region].first, m_regions[region].last + 1)) {
+
+        if(reparse(region, tokenDelta, lineDelta)) return;
+    }
+
+    parseProgram();
+}
+
+auto Document::parseProgram() -> void {
+
+    std::vector<Token> tokens = m_tokens;
+    tokens.emplace_back(TokenType::Eof, std::string_view(), m_lines.size());
+
+    Parser parser(tokens);
+    parser.setRecordRegions(true);
+
+    m_ast = parser.parseProgram();
+    m_regions = std::move(parser.regions());
+    prune(m_regions, m_ast != nullptr);
+
+    m_diagnostics.clear();
+    for(const auto& error : parser.errors()) {
+        m_diagnostics.push_back(toDiagnostic(error));
+    }
+
+    m_reparsedTokens += m_tokens.size();
+}
+
+auto Document::reparse(std::size_t index, std::int64_t tokenDelta, std::int64_t lineDelta) -> bool {
+
+    const Region old = m_regions[index];
+    const std::uint32_t last = old.last + tokenDelta;
+
+    std::vector<Token> tokens(m_tokens.begin() + old.first, m_tokens.begin() + last + 1);
+    tokens.emplace_back(TokenType::Eof, std::string_view(), tokens.back().line);
+
+    Parser parser(tokens);
+    parser.setRecordRegions(true);
+
+    StatementPtr node = parser.parseRegion();
+    std::vector<Region>& regions = parser.regions();
+
+    m_reparsedTokens += last + 1 - old.first;
+
+    // Ending elsewhere or unparsed, the region changed the structure
+    // around it.
+    if(node == nullptr || regions.front().last != last - old.first) return false;
+
+    const std::size_t parent = enclosingRegion(old.first, old.last + 1);
+    Statement* root = parent != m_regions.size() ? m_regions[parent].node : m_ast.get();
+
+    StatementPtr* slot = SlotFinder(old.node).find(root);
+    if(slot == nullptr) return false;
+
+    *slot = std::move(node);
+
+    // The regions nested in the old one are replaced too.
+    std::size_t end = index + 1;
+    while(end < m_regions.size() && m_regions[end].first <= old.last) end++;
+
+    for(auto& region : regions) {
+        region.first += old.first;
+        region.last += old.first;
+    }
+
+    prune(regions, true);
+
+    for(std::size_t i = 0; i < index; i++) {
+        if(m_regions[i].last >= old.last) m_regions[i].last += tokenDelta;
+    }
+
+    for(std::size_t i = end; i < m_regions.size(); i++) {
+        m_regions[i].first += tokenDelta;
+        m_regions[i].last += tokenDelta;
+    }
+
+    m_regions.erase(m_regions.begin() + index, m_regions.begin() + end);
+    m_regions.insert(m_regions.begin() + index, regions.begin(), regions.end());
+
+    // Lines of the region before the edit.
+    const std::uint32_t firstLine = m_tokens[old.first].line;
+    const std::uint32_t lastLine = m_tokens[last].line - lineDelta;
+
+    std::erase_if(m_diagnostics, [=](const Diagnostic& diagnostic) {
+        return diagnostic.line >= firstLine && diagnostic.line <= lastLine;
+    });
+
+    for(auto& diagnostic : m_diagnostics) {
+        if(diagnostic.line > lastLine) diagnostic.line += lineDelta;
+    }
+
+    for(const auto& error : parser.errors()) {
+        m_diagnostics.push_back(toDiagnostic(error));
+    }
+
+    std::stable_sort(m_diagnostics.begin(), m_diagnostics.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        return a.line < b.line;
+    });
+
+    return true;
+}
+
+auto Document::enclosingRegion(std::uint32_t first, std::uint32_t last) const -> std::size_t {
+
+    // In the order of the first tokens, the innermost region comes last.
+    auto region = std::partition_point(m_regions.begin(), m_regions.end(), [first](const Region& region) {
+        return region.first < first;
+    });
+
+    while(region != m_regions.begin()) {
+        region--;
+
+        if(region->last >= last && region->node != nullptr) {
+            return region - m_regions.begin();
+        }
+    }
+
+    return m_regions.size();
+}
+
+auto Document::prune(std::vector<Region>& regions, bool hasParent) -> void {
+
+    std::vector<const Region*> enclosing;
+
+    for(auto& region : regions) {
+        while(!enclosing.empty() && enclosing.back()->last < region.first) {
+            enclosing.pop_back();
+        }
+
+        if(enclosing.empty() ? !hasParent : enclosing.back()->node == nullptr) {
+            region.node = nullptr;
+        }
+
+        enclosing.push_back(&region);
+    }
+}
+
+// Server
+
+auto Server::run() -> int {
+
+    std::string message;
+
+    while(!m_exit && read(message)) {
+        auto value = json::parse(message);
+
+        if(!value) {
+            llvm::consumeError(value.takeError());
+
+            send(json::Object{
+                {"jsonrpc", "2.0"},
+                {"id", nullptr},
+                {"error", json::Object{{"code", -32700}, {"message", "Parse error"}}}
+            });
+
+            continue;
+        }
+
+        if(const json::Object* object = value->getAsObject()) {
+            handle(*object);
+        }
+    }
+
+    return m_shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+auto Server::read(std::string& message) -> bool {
+
+    std::size_t length = 0;
+    std::string header;
+
+    // Headers up to an empty line, only the length matters.
+    while(std::getline(m_input, header)) {
+        if(header.ends_with('\r')) header.pop_back();
+        if(header.empty()) break;
+
+        if(header.starts_with("Content-Length:")) {
+            length = std::strtoull(header.c_str() + 15, nullptr, 10);
+        }
+    }
+
+    if(!m_input) return false;
+
+    message.resize(length);
+    return static_cast<bool>(m_input.read(message.data(), length));
+}
+
+auto Server::send(json::Value message) -> void {
+
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    stream << message;
+    stream.flush();
+
+    m_output << "Content-Length: " << text.size() << "\r\n\r\n" << text;
+    m_output.flush();
+}
+
+auto Server::reply(const json::Value& id, json::Value result) -> void {
+    send(json::Object{{"jsonrpc", "2.0"}, {"id", id}, {"result", std::move(result)}});
+}
+
+auto Server::handle(const json::Object& message) -> void {
+
+    const llvm::StringRef method = message.getString("method").value_or("");
+
+    // Notifications don't have an id and get no reply.
+    const json::Value* request = message.get("id");
+    const json::Value id = request != nullptr ? *request : nullptr;
+
+    const json::Object* params = message.getObject("params");
+    const json::Object* textDocument = params != nullptr ? params->getObject("textDocument") : nullptr;
+    const llvm::StringRef uri = textDocument != nullptr ? textDocument->getString("uri").value_or("") : "";
+
+    if(method == "initialize") {
+        const json::Object* capabilities = params != nullptr ? params->getObject("capabilities") : nullptr;
+        const json::Object* general = capabilities != nullptr ? capabilities->getObject("general") : nullptr;
+        const json::Array* encodings = general != nullptr ? general->getArray("positionEncodings") : nullptr;
+
+        if(encodings != nullptr) {
+            m_utf8 = std::any_of(encodings->begin(), encodings->end(), [](const json::Value& encoding) {
+                return encoding.getAsString() == llvm::StringRef("utf-8");
+            });
+        }
+
+        reply(id, json::Object{
+            {"capabilities", json::Object{
+                {"positionEncoding", m_utf8 ? "utf-8" : "utf-16"},
+                {"textDocumentSync", json::Object{{"openClose", true}, {"change", 2}}},
+                {"documentSymbolProvider", true}
+            }},
+            {"serverInfo", json::Object{{"name", "pl0"}}}
+        });
+    } else if(method == "shutdown") {
+        m_shutdown = true;
+        reply(id, nullptr);
+    } else if(method == "exit") {
+        m_exit = true;
+    } else if(method == "textDocument/didOpen" && !uri.empty()) {
+        m_documents.insert_or_assign(uri.str(), Document(textDocument->getString("text").value_or("")));
+        publishDiagnostics(uri);
+    } else if(method == "textDocument/didChange" && !uri.empty()) {
+        const auto document = m_documents.find(uri.str());
+        const json::Array* changes = params->getArray("contentChanges");
+
+        if(document == m_documents.end() || changes == nullptr) return;
+
+        for(const auto& change : *changes) {
+            const json::Object* object = change.getAsObject();
+            if(object == nullptr) continue;
+
+            const std::string_view text = object->getString("text").value_or("");
+
+            // Without a range the change is the whole text.
+            if(const json::Object* range = object->getObject("range")) {
+                document->second.edit(toPosition(document->second, range->getObject("start")),
+                                      toPosition(document->second, range->getObject("end")), text);
+            } else {
+                document->second = Document(text);
+            }
+        }
+
+        publishDiagnostics(uri);
+    } else if(method == "textDocument/didClose" && !uri.empty()) {
+        m_documents.erase(uri.str());
+        publishDiagnostics(uri);
+    } else if(method == "textDocument/documentSymbol" && request != nullptr) {
+        const auto document = m_documents.find(uri.str());
+        std::size_t region = 0;
+
+        reply(id, document != m_documents.end()
+            ? symbols(document->second, region, UINT32_MAX)
+            : json::Array());
+    } else if(request != nullptr) {
+        send(json::Object{
+            {"jsonrpc", "2.0"},
+            {"id", id},
+            {"error", json::Object{{"code", -32601}, {"message", "Unknown method " + method.str()}}}
+        });
+    }
+}
+
+auto Server::publishDiagnostics(llvm::StringRef uri) -> void {
+
+    json::Array diagnostics;
+
+    if(const auto document = m_documents.find(uri.str()); document != m_documents.end()) {
+        for(const auto& [line, message] : document->second.diagnostics()) {
+            const std::uint32_t end = toCharacter(document->second, line, document->second.lineLength(line));
+
+            diagnostics.push_back(json::Object{
+                {"range", toRange(line, 0, end)},
+                {"severity", 1},
+                {"source", "pl0"},
+                {"message", message}
+            });
+        }
+    }
+
+    send(json::Object{
+        {"jsonrpc", "2.0"},
+        {"method", "textDocument/publishDiagnostics"},
+        {"params", json::Object{{"uri", uri}, {"diagnostics", std::move(diagnostics)}}}
+    });
+}
+
+auto Server::symbols(const Document& document, std::size_t& region, std::uint32_t last) const -> json::Array {
+
+    const auto& regions = document.regions();
+    const auto& tokens = document.tokens();
+
+    json::Array symbols;
+
+    while(region < regions.size() && regions[region].first <= last) {
+        const Region& procedure = regions[region++];
+
+        if(tokens[procedure.first].type != TokenType::ProcedureKeyword
+            || procedure.first + 1 >= tokens.size()
+            || tokens[procedure.first + 1].type != TokenType::Identifier) continue;
+
+        const Token& keyword = tokens[procedure.first];
+        const Token& name = tokens[procedure.first + 1];
+        const Token& end = tokens[procedure.last];
+
+        json::Object range = toRange(keyword.line, toCharacter(document, keyword.line, document.column(keyword)), 0);
+        range["end"] = json::Object{
+            {"line", end.line - 1},
+            {"character", toCharacter(document, end.line, document.column(end) + end.lexeme.size())}
+        };
+
+        const std::uint32_t nameColumn = document.column(name);
+
+        symbols.push_back(json::Object{
+            {"name", std::string(name.lexeme)},
+            {"kind", 12},
+            {"range", std::move(range)},
+            {"selectionRange", toRange(name.line, toCharacter(document, name.line, nameColumn),
+                                       toCharacter(document, name.line, nameColumn + name.lexeme.size()))},
+            {"children", this->symbols(document, region, procedure.last)}
+        });
+    }
+
+    return symbols;
+}
+
+auto Server::toPosition(const Document& document, const json::Object* position) const -> Position {
+
+    const auto line = static_cast<std::uint32_t>(position->getInteger("line").value_or(0));
+    const auto character = static_cast<std::uint32_t>(position->getInteger("character").value_or(0));
+
+    if(m_utf8) return {line, character};
+
+    // The edits take the lines past the end as the last one.
+    const std::uint32_t text = std::min(line + 1, document.lineCount());
+    return {line, utf16ToBytes(document.line(text), character)};
+}
+
+auto Server::toCharacter(const Document& document, std::uint32_t line, std::uint32_t column) const -> std::uint32_t {
+    return m_utf8 ? column : bytesToUtf16(document.line(line), column);
+}
+
+}
@@ -0,0 +1,171 @@
+#ifndef _LSP_HPP_
+#define _LSP_HPP_
+
+#include "ast.hpp"
+#include "parser.hpp"
+#include "token.hpp"
+
+#include "llvm/Support/JSON.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pl0::lsp {
+
+using namespace token;
+using ast::StatementPtr;
+using parser::Region;
+
+// Position in a document, counted from 0. Characters are bytes, the
+// server converts them from and to the encoding of the client.
+struct Position {
+    std::uint32_t line;
+    std::uint32_t character;
+};
+
+struct Diagnostic {
+    std::uint32_t line;
+    std::string message;
+};
+
+/*
+
+Document opened in the language server. The lines, tokens, regions and AST
+are kept between the edits: an edit relexes the lines it touches, then
+reparses the innermost procedure or begin...end around them and puts the
+new subtree in place of the old one. When the region doesn't end on the
+same token anymore the enclosing one is reparsed, up to the whole program.
+
+Every line is a separate string, so the lexemes of the tokens on the other
+lines stay valid. The nodes outside the reparsed regions keep the line
+numbers of their last parse, the positions come from the tokens.
+
+*/
+class Document final {
+public:
+    explicit Document(std::string_view text);
+
+    // Replaces the text from `start` to `end`.
+    auto edit(Position start, Position end, std::string_view text) -> void;
+
+    constexpr auto diagnostics() const -> const std::vector<Diagnostic>& {
+        return m_diagnostics;
+    }
+
+    constexpr auto tokens() const -> const std::vector<Token>& {
+        return m_tokens;
+    }
+
+    constexpr auto regions() const -> const std::vector<Region>& {
+        return m_regions;
+    }
+
+    constexpr auto ast() -> StatementPtr& {
+        return m_ast;
+    }
+
+    // Tokens parsed by the last edit, the whole program included.
+    constexpr auto reparsedTokens() const -> std::size_t {
+        return m_reparsedTokens;
+    }
+
+    inline auto lineCount() const -> std::uint32_t {
+        return m_lines.size();
+    }
+
+    // Line counted from 1, like the tokens.
+    inline auto line(std::uint32_t line) const -> std::string_view {
+        return *m_lines[line - 1];
+    }
+
+    inline auto lineLength(std::uint32_t line) const -> std::uint32_t {
+        return m_lines[line - 1]->size();
+    }
+
+    inline auto column(const Token& token) const -> std::uint32_t {
+        return token.lexeme.data() - m_lines[token.line - 1]->data();
+    }
+
+    auto text() const -> std::string;
+
+private:
+
+    auto lex(std::uint32_t line, std::uint32_t count) const -> std::vector<Token>;
+
+    auto parseProgram() -> void;
+    auto reparse(std::size_t region, std::int64_t tokenDelta, std::int64_t lineDelta) -> bool;
+
+    // Innermost region with a node around the tokens [first, last), the
+    // number of regions if there isn't.
+    auto enclosingRegion(std::uint32_t first, std::uint32_t last) const -> std::size_t;
+
+    // Removes the node of the regions nested in a region without one, they
+    // were destroyed with it.
+    static auto prune(std::vector<Region>& regions, bool hasParent) -> void;
+
+private:
+    std::vector<std::unique_ptr<std::string>> m_lines;
+    std::vector<Token> m_tokens;
+    std::vector<Region> m_regions;
+
+    StatementPtr m_ast;
+    std::vector<Diagnostic> m_diagnostics;
+
+    std::size_t m_reparsedTokens = 0;
+};
+
+/*
+
+Language server (-lsp) speaking JSON-RPC on the given streams. The documents
+are synchronized incrementally, every change publishes the syntax errors,
+and the procedures are listed as document symbols.
+
+The characters of the positions are UTF-16 code units, as the protocol
+requires by default, or bytes when the client accepts UTF-8.
+
+*/
+class Server final {
+public:
+    Server(std::istream& input, std::ostream& output)
+        : m_input(input), m_output(output) {}
+
+    // Serves until the exit notification, returns the exit code.
+    auto run() -> int;
+
+private:
+
+    auto read(std::string& message) -> bool;
+    auto send(llvm::json::Value message) -> void;
+    auto reply(const llvm::json::Value& id, llvm::json::Value result) -> void;
+
+    auto handle(const llvm::json::Object& message) -> void;
+    auto publishDiagnostics(llvm::StringRef uri) -> void;
+
+    auto symbols(const Document& document, std::size_t& region, std::uint32_t last) const -> llvm::json::Array;
+
+    // Position of the protocol to the bytes of `document`, and back for
+    // the byte `column` of a line counted from 1.
+    auto toPosition(const Document& document, const llvm::json::Object* position) const -> Position;
+    auto toCharacter(const Document& document, std::uint32_t line, std::uint32_t column) const -> std::uint32_t;
+
+private:
+    std::istream& m_input;
+    std::ostream& m_output;
+
+    std::unordered_map<std::string, Document> m_documents;
+
+    bool m_utf8 = false;
+
+    bool m_shutdown = false;
+    bool m_exit = false;
+};
+
+}
+
+#endif
@@ -1,12 +1,27 @@
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <ostream>
+#include <thread>
 
 #include "tokenizer.hpp"
 #include "parser.hpp"
+#include "astbin.hpp"
+#include "bytecode.hpp"
 #include "codegen.hpp"
+#include "interpreter.hpp"
+#include "jit.hpp"
+#include "lsp.hpp"
+#include "memstats.hpp"
+#include "pipeline.hpp"
+#include "timing.hpp"
+
+#include "llvm/Support/MemoryBuffer.h"
 
 /*
 
@@ -17,28 +32,41 @@
 program = block "." ;
 
 block = [ "const" ident "=" number {"," ident "=" number} ";"]
-        [ "var" ident {"," ident} ";"]
+        [ "var" variable {"," variable} ";"]
+        [ "shared" ident {"," ident} ";"]
         { "procedure" ident ";" block ";" } statement ;
-statement = [ ident ":=" expression
+variable = ident [ "[" (number | ident) "]" ] ;
+statement = [ ident [ "[" expression "]" ] ":=" expression
               | "call" ident
-              | "?" ident | "!" expression
+              | "?" ident [ "[" expression "]" ] | "!" expression
               | "begin" statement {";" statement } "end"
               | "if" condition "then" statement
-              | "while" condition "do" statement ];
+              | "while" condition "do" statement
+              | "for" ident ":=" expression "to" expression [ "step" expression ] "do" statement
+              | "parallel" "begin" "call" ident {";" "call" ident } "end" ];
 
 condition = "odd" expression |
             expression ("="|"#"|"<"|"<="|">"|">=") expression ;
 
 expression = [ "+"|"-"] term { ("+"|"-") term};
 term = factor {("*"|"/") factor};
-factor = ident | number | "(" expression ")";
+factor = ident [ "[" expression "]" ] | number | "(" expression ")";
 
 */
 
 using pl0::tokenizer::Tokenizer;
 using pl0::parser::Parser;
 using pl0::ast::AstPrinter;
+using pl0::ast::AstJsonPrinter;
+using pl0::astbin::AstWriter;
+using pl0::astbin::AstReader;
 using pl0::codegen::CodeGenerator;
+using pl0::interpreter::Interpreter;
+using pl0::jit::NativeTier;
+using pl0::pipeline::LexerThread;
+using pl0::timing::Phase;
+using pl0::memstats::Category;
+using pl0::memstats::CategoryScope;
 
 static auto readFile(const char* path) -> std::string {
     std::ifstream stream(path);
@@ -57,10 +85,30 @@ auto main(int argc, char** argv) -> int {
 
     if(argc < 2){
 
-        std::cerr << "Usage: " << argv[0] << " [-llvm] [-ast] [-object] <file>\n"
-            << "    -llvm\tDump LLVM IR\n"
-            << "    -object\tProduce only the object file\n"
-            << "    -ast\tDump AST\n"
+        std::cerr << "Usage: " << argv[0] << " [-llvm] [-ast] [-ast-json] [-emit-ast-bin] [-object] [-interp] [-tiered] [-no-jit-cache] [-bytecode] [-one-pass] [-pipeline] [-parallel-parse[=<threads>]] [-auto-parallel] [-O<level>] [-g] [-profile-runtime] [-verbose] [-time-phases] [-trace=<file.json>] [-mem-stats] <file>\n"
+            << "       " << argv[0] << " -lsp\n"
+            << "    -llvm\t\tDump LLVM IR\n"
+            << "    -object\t\tProduce only the object file\n"
+            << "    -ast\t\tDump AST\n"
+            << "    -ast-json\t\tDump AST as JSON\n"
+            << "    -emit-ast-bin\tWrite the parsed AST to <file>.ast, loaded later in place of the source\n"
+            << "    -interp\t\tRun the program in the bytecode interpreter\n"
+            << "    -tiered\t\tInterpret, compile the hot procedures to native code in background\n"
+            << "    -no-jit-cache\tDon't reuse nor store the native code of -tiered on disk\n"
+            << "    -bytecode\t\tDump the bytecode of the interpreter\n"
+            << "    -one-pass\t\tGenerate the code while parsing, without the tokens and the AST in memory\n"
+            << "    -pipeline\t\tLex on a separate thread while parsing\n"
+            << "    -parallel-parse[=<threads>]\tParse the procedures concurrently, on all the cores by default\n"
+            << "    -O<level>\tOptimization level, from -O0 (default, -O2 with -tiered) to -O3\n"
+            << "    -auto-parallel\tRun the consecutive independent calls concurrently\n"
+            << "    -g\t\t\tEmit DWARF line tables and keep the frame pointers, write the perf map of -tiered\n"
+            << "    -profile-runtime\tCount the calls, cycles and loop iterations, reported at exit to <file>.profile\n"
+            << "    -verbose\t\tReport the procedures removed because they are never called\n"
+            << "    -time-phases\tPrint the wall/CPU time spent in each phase\n"
+            << "    -trace=<file>\tWrite a Chrome trace-event JSON of the compilation\n"
+            << "    -mem-stats\t\tPrint the memory used by each phase and data structure\n"
+            << "    -lsp\t\tRun a language server on stdin/stdout\n"
+            << "\n<file> is a .pl0 source or a .ast written by -emit-ast-bin\n"
             << std::endl;
 
         std::exit(EXIT_FAILURE);
@@ -68,7 +116,21 @@ auto main(int argc, char** argv) -> int {
 
     bool dumpIR = false;
     bool dumpAST = false;
+    bool dumpAstJson = false;
+    bool emitAstBinary = false;
     bool produceOnlyObject = false;
+    bool interpret = false;
+    bool dumpBytecode = false;
+    bool tiered = false;
+    bool useJitCache = true;
+    bool onePass = false;
+    bool pipeline = false;
+    unsigned parseThreads = 1;
+    bool verbose = false;
+    bool debugInfo = false;
+    bool profileRuntime = false;
+    bool autoParallel = false;
+    std::optional<unsigned> optimizationLevel;
 
     char** args;
     for(args = argv + 1; *args != argv[argc]; args++){
@@ -77,10 +139,48 @@ auto main(int argc, char** argv) -> int {
 
         if(std::strncmp(*args, "-llvm", 5) == 0) {
             dumpIR = true;
+        } else if(std::strcmp(*args, "-ast-json") == 0) {
+            dumpAstJson = true;
         } else if(std::strncmp(*args, "-ast", 4) == 0){
             dumpAST = true;
+        } else if(std::strcmp(*args, "-emit-ast-bin") == 0) {
+            emitAstBinary = true;
         } else if(std::strncmp(*args, "-object", 7) == 0) {
             produceOnlyObject = true;
+        } else if(std::strcmp(*args, "-interp") == 0) {
+            interpret = true;
+        } else if(std::strcmp(*args, "-tiered") == 0) {
+            tiered = true;
+        } else if(std::strcmp(*args, "-no-jit-cache") == 0) {
+            useJitCache = false;
+        } else if(std::strcmp(*args, "-bytecode") == 0) {
+            dumpBytecode = true;
+        } else if(std::strcmp(*args, "-one-pass") == 0) {
+            onePass = true;
+        } else if(std::strcmp(*args, "-pipeline") == 0) {
+            pipeline = true;
+        } else if(std::strcmp(*args, "-parallel-parse") == 0) {
+            parseThreads = std::max(1u, std::thread::hardware_concurrency());
+        } else if(std::strncmp(*args, "-parallel-parse=", 16) == 0 && std::atoi(*args + 16) > 0) {
+            parseThreads = std::atoi(*args + 16);
+        } else if(std::strncmp(*args, "-O", 2) == 0 && (*args)[2] >= '0' && (*args)[2] <= '3' && (*args)[3] == '\0') {
+            optimizationLevel = (*args)[2] - '0';
+        } else if(std::strcmp(*args, "-auto-parallel") == 0) {
+            autoParallel = true;
+        } else if(std::strcmp(*args, "-g") == 0) {
+            debugInfo = true;
+        } else if(std::strcmp(*args, "-profile-runtime") == 0) {
+            profileRuntime = true;
+        } else if(std::strcmp(*args, "-verbose") == 0) {
+            verbose = true;
+        } else if(std::strncmp(*args, "-time-phases", 12) == 0) {
+            pl0::timing::enablePhaseReport();
+        } else if(std::strncmp(*args, "-trace=", 7) == 0) {
+            pl0::timing::enableTrace(argv[0], *args + 7);
+        } else if(std::strncmp(*args, "-mem-stats", 10) == 0) {
+            pl0::memstats::enable();
+        } else if(std::strcmp(*args, "-lsp") == 0) {
+            return pl0::lsp::Server(std::cin, std::cout).run();
         } else {
             std::cerr << "Unknow option '" << *args << "'.\n";
             std::exit(EXIT_FAILURE);
@@ -89,41 +189,271 @@ auto main(int argc, char** argv) -> int {
 
     std::string_view filename = *args;
 
-    if(!filename.ends_with(".pl0")) {
-        std::cerr << "Invalid file. This file doesn't have '.pl0' file extension.\n";
+    const bool isAstBinary = filename.ends_with(".ast");
+
+    if(!filename.ends_with(".pl0") && !isAstBinary) {
+        std::cerr << "Invalid file. This file doesn't have '.pl0' or '.ast' file extension.\n";
         std::exit(EXIT_FAILURE);
     }
 
-    auto source = readFile(filename.data());
-    Tokenizer tokenizer = Tokenizer(source);
-    
-    auto tokens = tokenizer.tokenize();
+    // The lines of a .ast file are those of its source.
+    const std::string sourcePath = std::string(filename.substr(0, filename.size() - 4)) + ".pl0";
 
-    Parser parser(tokens);
-    auto ast = parser.parseProgram();
+    if(onePass && (isAstBinary || dumpAST || dumpAstJson || emitAstBinary || interpret || tiered || dumpBytecode)) {
+        std::cerr << "-one-pass compiles a .pl0 source to LLVM IR or native code only.\n";
+        std::exit(EXIT_FAILURE);
+    }
 
-    if(parser.hadError()) {
-        for(const auto& error : parser.errors()){
-            std::cout << error << '\n';
-        }
+    if(pipeline && isAstBinary) {
+        std::cerr << "-pipeline lexes a .pl0 source, a .ast is already parsed.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(profileRuntime && (interpret || tiered || dumpBytecode)) {
+        std::cerr << "-profile-runtime instruments the compiled programs, not -interp nor -tiered.\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(autoParallel && onePass) {
+        std::cerr << "-auto-parallel needs the effects of the whole program, not -one-pass.\n";
+        std::exit(EXIT_FAILURE);
+    }
 
+    if(parseThreads > 1 && (isAstBinary || pipeline || onePass)) {
+        std::cerr << "-parallel-parse needs the tokens of the whole program, without -pipeline nor -one-pass.\n";
         std::exit(EXIT_FAILURE);
     }
 
+    std::string source;
+    std::unique_ptr<llvm::MemoryBuffer> mappedSource;
+    {
+        Phase phase("read");
+
+        // Mapped in one pass, the pages are read while the tokens are
+        // pulled and are never copied in memory.
+        if(onePass) {
+            auto file = llvm::MemoryBuffer::getFile(filename, false, false);
+
+            if(!file) {
+                std::cerr << "Unable to read '" << filename << "'.\n";
+                std::exit(EXIT_FAILURE);
+            }
+
+            mappedSource = std::move(*file);
+        } else {
+            source = readFile(filename.data());
+        }
+    }
+
+    pl0::ast::StatementPtr ast;
+
+    // In one pass the source is parsed by the code generator.
+    if(isAstBinary) {
+        // The lexemes of the loaded tokens point into the source.
+        AstReader reader(source);
+        {
+            Phase phase("load-ast");
+            CategoryScope category(Category::Ast);
+            ast = reader.read();
+        }
+
+        if(reader.hadError()) {
+            for(const auto& error : reader.errors()){
+                std::cout << error << '\n';
+            }
+
+            std::exit(EXIT_FAILURE);
+        }
+    } else if(pipeline && !onePass) {
+        // The batches of tokens are freed as they are parsed.
+        std::unique_ptr<LexerThread> lexer;
+        std::unique_ptr<Parser> parser;
+        {
+            Phase phase("lex+parse");
+            CategoryScope category(Category::Ast);
+            lexer = std::make_unique<LexerThread>(source);
+            parser = std::make_unique<Parser>(*lexer);
+            ast = parser->parseProgram();
+        }
+
+        if(parser->hadError()) {
+            for(const auto& error : parser->errors()){
+                std::cout << error << '\n';
+            }
+
+            std::exit(EXIT_FAILURE);
+        }
+    } else if(!onePass) {
+        std::vector<pl0::token::Token> tokens;
+        {
+            Phase phase("lex");
+            CategoryScope category(Category::Tokens);
+            Tokenizer tokenizer = Tokenizer(source);
+            tokens = tokenizer.tokenize();
+        }
+
+        Parser parser(tokens);
+        parser.setThreads(parseThreads);
+        {
+            Phase phase("parse");
+            CategoryScope category(Category::Ast);
+            ast = parser.parseProgram();
+        }
+
+        if(parser.hadError()) {
+            for(const auto& error : parser.errors()){
+                std::cout << error << '\n';
+            }
+
+            std::exit(EXIT_FAILURE);
+        }
+
+        {
+            Phase phase("release-tokens");
+            parser.releaseTokens();
+            pl0::memstats::returnFreedMemory();
+        }
+    }
+
+    if(emitAstBinary) {
+        Phase phase("emit-ast-bin");
+
+        std::string path(filename.substr(0, filename.size() - 4));
+        path += ".ast";
+
+        const std::string encoded = AstWriter().write(ast);
+        std::ofstream stream(path, std::ios::binary);
+
+        if(!stream.write(encoded.data(), encoded.size())) {
+            std::cerr << "Unable to write '" << path << "'.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        if(!dumpAST && !dumpAstJson && !dumpIR && !dumpBytecode && !interpret && !tiered) return EXIT_SUCCESS;
+    }
+
     if(dumpAST) {
+        Phase phase("dump-ast");
         AstPrinter printer;
         printer.print(ast);
+    }
 
-        if(!dumpIR) return EXIT_SUCCESS;
+    if(dumpAstJson) {
+        Phase phase("dump-ast-json");
+        AstJsonPrinter printer;
+        printer.print(ast);
     }
 
-    filename.remove_suffix(4); // remove .pl0
+    if((dumpAST || dumpAstJson) && !dumpIR && !dumpBytecode && !interpret && !tiered) return EXIT_SUCCESS;
+
+    if(interpret || tiered || dumpBytecode) {
+        pl0::bytecode::Compiler compiler;
+        pl0::bytecode::Program program;
+        {
+            Phase phase("bytecode");
+            program = compiler.compile(ast);
+        }
+
+        if(compiler.hadError()) {
+            for(const auto& error : compiler.errors()){
+                std::cout << error << '\n';
+            }
+
+            std::exit(EXIT_FAILURE);
+        }
+
+        // The tier generates the code of the hot procedures from the AST.
+        if(!tiered) {
+            Phase phase("release-ast");
+            ast.reset();
+            pl0::memstats::returnFreedMemory();
+        }
+
+        if(dumpBytecode) {
+            Phase phase("dump-bytecode");
+            pl0::bytecode::disassemble(program);
+            return EXIT_SUCCESS;
+        }
+
+        Phase phase("interpret");
+
+        if(tiered) {
+            NativeTier tier(std::move(ast), program);
+            tier.setOptimizationLevel(optimizationLevel.value_or(2));
+
+            if(useJitCache) {
+                tier.setCacheDirectory(pl0::cache::defaultDirectory());
+            }
+
+            if(debugInfo) tier.setDebugInfo(sourcePath);
+
+            Interpreter interpreter(program, &tier);
+            return interpreter.run();
+        }
+
+        Interpreter interpreter(program);
+        return interpreter.run();
+    }
+
+    filename.remove_suffix(4); // remove .pl0 or .ast
+
+    CategoryScope moduleCategory(Category::LlvmModule);
     CodeGenerator codegen(filename);
+    codegen.setOptimizationLevel(optimizationLevel.value_or(0));
+
+    // An object file may be linked with other code, the executable not.
+    codegen.setWholeProgram(!produceOnlyObject);
 
-    if(!codegen.generate(ast)) {
+    // In one pass a procedure is generated before knowing if it's called,
+    // the procedures of an object file may be called by the code linked with it.
+    codegen.setEliminateDeadProcedures(!onePass && !produceOnlyObject);
+    codegen.setAutoParallel(autoParallel);
+
+    codegen.setProfileRuntime(profileRuntime);
+
+    if(debugInfo) codegen.setDebugInfo(sourcePath);
+
+    bool isGenerated;
+
+    if(onePass) {
+        std::unique_ptr<pl0::tokenizer::TokenSource> lexer;
+
+        if(pipeline) {
+            lexer = std::make_unique<LexerThread>(mappedSource->getBuffer());
+        } else {
+            lexer = std::make_unique<Tokenizer>(mappedSource->getBuffer());
+        }
+
+        Parser parser(*lexer);
+
+        isGenerated = codegen.generate(parser);
+
+        if(parser.hadError()) {
+            for(const auto& error : parser.errors()){
+                std::cout << error << '\n';
+            }
+
+            std::exit(EXIT_FAILURE);
+        }
+    } else {
+        isGenerated = codegen.generate(ast);
+    }
+
+    if(!isGenerated) {
         std::exit(EXIT_FAILURE);
     }
 
+    for(const auto& warning : codegen.warnings()) {
+        std::cerr << warning << '\n';
+    }
+
+    if(verbose) {
+        for(const auto* procedure : codegen.removedProcedures()) {
+            std::cerr << "[Ln: " << procedure->name.line << "] Note: procedure '" << procedure->name.lexeme
+                << "' is never called, removed.\n";
+        }
+    }
+
     if(codegen.hadError()) {
         for(const auto& error : codegen.errors()){
             std::cout << error << '\n';
@@ -132,12 +462,29 @@ auto main(int argc, char** argv) -> int {
         std::exit(EXIT_FAILURE);
     } 
 
+    {
+        Phase phase("release-ast");
+        ast.reset();
+        pl0::memstats::returnFreedMemory();
+    }
+
+    {
+        Phase phase("optimize");
+        codegen.optimize();
+    }
+
     if(dumpIR) {
+        Phase phase("dump-llvm");
         codegen.dumpLLVM();
     } else {
-        codegen.produceObjectFile();
+        {
+            Phase phase("emit-object");
+            CategoryScope category(Category::LlvmBackend);
+            codegen.produceObjectFile();
+        }
 
         if(!produceOnlyObject) {
+            Phase phase("link");
             if(!codegen.produceExecutable()) {
                 std::cerr << "An error occurred while generating the executable." << std::endl;
                 std::exit(EXIT_FAILURE);
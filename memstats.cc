@@ -0,0 +1,350 @@
+#include "memstats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <malloc.h>
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <malloc.h>
+    #include <unistd.h>
+    #include <sys/resource.h>
+#endif
+
+namespace pl0::memstats {
+
+namespace {
+
+constexpr std::size_t CATEGORIES = static_cast<std::size_t>(Category::Count);
+
+constexpr const char* categoryNames[CATEGORIES] = {
+    "other",
+    "tokens",
+    "ast",
+    "symbol tables",
+    "llvm module",
+    "llvm backend"
+};
+
+struct Counters {
+    std::atomic<std::uint64_t> allocations = 0;
+    std::atomic<std::uint64_t> bytes = 0;
+};
+
+struct PhaseMemory {
+    const char* name;
+    std::uint32_t depth;
+    std::int64_t liveBytes;
+    std::int64_t peakBytes;
+    std::uint64_t rssBytes;
+    std::uint64_t peakRssBytes;
+};
+
+std::atomic<bool> enabled = false;
+bool reportRegistered = false;
+
+Counters counters[CATEGORIES];
+
+std::atomic<std::int64_t> liveBytes = 0;
+std::atomic<std::int64_t> peakBytes = 0;
+std::atomic<std::int64_t> phasePeakBytes = 0;
+
+std::vector<PhaseMemory> phases;
+
+// Heap peaks of the enclosing phases, suspended while a nested one runs.
+std::vector<std::int64_t> enclosingPeaks;
+
+thread_local Category currentCategory = Category::Other;
+
+inline auto allocationSize(void* pointer) -> std::size_t {
+#ifdef _WIN32
+    return _msize(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+inline auto raise(std::atomic<std::int64_t>& peak, std::int64_t value) -> void {
+    std::int64_t current = peak.load(std::memory_order_relaxed);
+    while(value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+inline auto countAllocation(void* pointer) -> void {
+    if(pointer == nullptr || !enabled.load(std::memory_order_relaxed)) return;
+
+    const auto size = static_cast<std::int64_t>(allocationSize(pointer));
+    Counters& category = counters[static_cast<std::size_t>(currentCategory)];
+
+    category.allocations.fetch_add(1, std::memory_order_relaxed);
+    category.bytes.fetch_add(size, std::memory_order_relaxed);
+
+    const std::int64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    raise(peakBytes, live);
+    raise(phasePeakBytes, live);
+}
+
+inline auto countDeallocation(void* pointer) -> void {
+    if(pointer == nullptr || !enabled.load(std::memory_order_relaxed)) return;
+
+    liveBytes.fetch_sub(static_cast<std::int64_t>(allocationSize(pointer)), std::memory_order_relaxed);
+}
+
+auto residentBytes() -> std::uint64_t {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))
+        ? memory.WorkingSetSize
+        : 0;
+#else
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if(statm == nullptr) return 0;
+
+    unsigned long long size = 0, resident = 0;
+    const int read = std::fscanf(statm, "%llu %llu", &size, &resident);
+    std::fclose(statm);
+
+    return read == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+auto peakResidentBytes() -> std::uint64_t {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))
+        ? memory.PeakWorkingSetSize
+        : 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+auto formatBytes(double bytes) -> std::string {
+
+    static constexpr const char* units[] = {"B", "KiB", "MiB", "GiB"};
+
+    std::size_t unit = 0;
+    while(std::abs(bytes) >= 1024 && unit + 1 < std::size(units)) {
+        bytes /= 1024;
+        unit++;
+    }
+
+    return std::format("{:.1f} {}", bytes, units[unit]);
+}
+
+auto printReport() -> void {
+
+    enabled = false;
+
+    std::string report = std::format("{:<32}{:>14}{:>14}\n", "Allocations by owner", "Count", "Bytes");
+
+    for(std::size_t i = 0; i < CATEGORIES; i++) {
+        report += std::format("{:<32}{:>14}{:>14}\n",
+                              categoryNames[i],
+                              counters[i].allocations.load(),
+                              formatBytes(counters[i].bytes.load()));
+    }
+
+    report += std::format("\n{:<32}{:>14}{:>14}{:>14}{:>14}\n", "Phase", "Heap live", "Heap peak", "RSS", "Peak RSS");
+
+    for(const auto& [name, depth, live, peak, rss, peakRss] : phases) {
+        const std::string label = std::string(depth * 2, ' ') + name;
+        report += std::format("{:<32}{:>14}{:>14}{:>14}{:>14}\n",
+                              label,
+                              formatBytes(live),
+                              formatBytes(peak),
+                              formatBytes(rss),
+                              formatBytes(peakRss));
+    }
+
+    report += std::format("{:<32}{:>14}{:>14}{:>14}{:>14}\n",
+                          "total",
+                          formatBytes(liveBytes.load()),
+                          formatBytes(peakBytes.load()),
+                          formatBytes(residentBytes()),
+                          formatBytes(peakResidentBytes()));
+
+    std::fputs(report.c_str(), stderr);
+}
+
+}
+
+auto enable() -> void {
+    enabled = true;
+
+    if(reportRegistered) return;
+
+    std::atexit(printReport);
+    reportRegistered = true;
+}
+
+auto isEnabled() -> bool {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+auto beginPhase() -> void {
+    if(!isEnabled()) return;
+
+    enclosingPeaks.push_back(phasePeakBytes.load(std::memory_order_relaxed));
+    phasePeakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+auto endPhase(const char* name, std::uint32_t depth) -> void {
+    if(!isEnabled()) return;
+
+    const std::int64_t peak = phasePeakBytes.load(std::memory_order_relaxed);
+
+    phases.push_back({
+        name,
+        depth,
+        liveBytes.load(std::memory_order_relaxed),
+        peak,
+        residentBytes(),
+        peakResidentBytes()
+    });
+
+    if(enclosingPeaks.empty()) return;
+
+    // The enclosing phase peak includes the nested one.
+    phasePeakBytes.store(std::max(enclosingPeaks.back(), peak), std::memory_order_relaxed);
+    enclosingPeaks.pop_back();
+}
+
+auto returnFreedMemory() -> void {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+CategoryScope::CategoryScope(Category category)
+    : m_previous(currentCategory) {
+    currentCategory = category;
+}
+
+CategoryScope::~CategoryScope() {
+    currentCategory = m_previous;
+}
+
+}
+
+// Global allocation functions, they count the allocations when -mem-stats
+// is enabled and otherwise are plain malloc/free.
+
+using pl0::memstats::countAllocation;
+using pl0::memstats::countDeallocation;
+
+// The compiler is built without exceptions, like LLVM, so running out of
+// memory is fatal unless a new handler frees some.
+static auto tryAllocate(std::size_t size, std::size_t alignment) -> void* {
+
+    size = std::max<std::size_t>(size, 1);
+    if(alignment != 0) size = (size + alignment - 1) / alignment * alignment;
+
+    while(true) {
+#ifdef _WIN32
+        void* pointer = alignment != 0 ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+        void* pointer = alignment != 0 ? std::aligned_alloc(alignment, size) : std::malloc(size);
+#endif
+        if(pointer != nullptr) {
+            countAllocation(pointer);
+            return pointer;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) return nullptr;
+        handler();
+    }
+}
+
+static auto allocate(std::size_t size, std::size_t alignment = 0) -> void* {
+
+    void* pointer = tryAllocate(size, alignment);
+
+    if(pointer == nullptr) {
+        std::fputs("Out of memory.\n", stderr);
+        std::abort();
+    }
+
+    return pointer;
+}
+
+static auto deallocate(void* pointer) -> void {
+    countDeallocation(pointer);
+    std::free(pointer);
+}
+
+static auto deallocateAligned(void* pointer) -> void {
+    countDeallocation(pointer);
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+auto operator new(std::size_t size) -> void* {
+    return allocate(size);
+}
+
+auto operator new[](std::size_t size) -> void* {
+    return allocate(size);
+}
+
+auto operator new(std::size_t size, const std::nothrow_t&) noexcept -> void* {
+    return tryAllocate(size, 0);
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t&) noexcept -> void* {
+    return tryAllocate(size, 0);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void* {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void* {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+auto operator delete(void* pointer) noexcept -> void {
+    deallocate(pointer);
+}
+
+auto operator delete[](void* pointer) noexcept -> void {
+    deallocate(pointer);
+}
+
+auto operator delete(void* pointer, std::size_t) noexcept -> void {
+    deallocate(pointer);
+}
+
+auto operator delete[](void* pointer, std::size_t) noexcept -> void {
+    deallocate(pointer);
+}
+
+auto operator delete(void* pointer, std::align_val_t) noexcept -> void {
+    deallocateAligned(pointer);
+}
+
+auto operator delete[](void* pointer, std::align_val_t) noexcept -> void {
+    deallocateAligned(pointer);
+}
+
+auto operator delete(void* pointer, std::size_t, std::align_val_t) noexcept -> void {
+    deallocateAligned(pointer);
+}
+
+auto operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept -> void {
+    deallocateAligned(pointer);
+}
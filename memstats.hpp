@@ -0,0 +1,47 @@
+#ifndef _MEMSTATS_HPP_
+#define _MEMSTATS_HPP_
+
+#include <cstdint>
+
+namespace pl0::memstats {
+
+// Owner of the allocations, tracked by the global operator new.
+enum class Category : std::uint8_t {
+    Other,
+    Tokens,
+    Ast,
+    SymbolTables,
+    LlvmModule,
+    LlvmBackend,
+
+    Count
+};
+
+// Starts counting the allocations, the report is printed on stderr at exit.
+auto enable() -> void;
+
+auto isEnabled() -> bool;
+
+// Memory snapshots taken by timing::Phase.
+auto beginPhase() -> void;
+auto endPhase(const char* name, std::uint32_t depth) -> void;
+
+// Gives the freed heap pages back to the OS, so RSS drops after a release.
+auto returnFreedMemory() -> void;
+
+// Charges the allocations of the current thread to `category`.
+class CategoryScope final {
+public:
+    explicit CategoryScope(Category category);
+    ~CategoryScope();
+
+    CategoryScope(const CategoryScope&) = delete;
+    CategoryScope& operator=(const CategoryScope&) = delete;
+
+private:
+    Category m_previous;
+};
+
+}
+
+#endif
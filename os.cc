@@ -1,7 +1,9 @@
 #include "os.hpp"
 
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 
 #ifdef _WIN32
 
@@ -56,6 +58,7 @@ static int spwanProcessWindows(const char* program, char* const args[]) {
 
 #else
 
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -102,5 +105,156 @@ int spawnProcess(const char* program, char* const args[]) {
 #endif
 }
 
+std::string executableDirectory() {
+
+#ifdef _WIN32
+    char path[MAX_PATH];
+    const DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    std::string executable(path, length);
+#else
+    char path[4096];
+    const ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+    std::string executable(path, length > 0 ? length : 0);
+#endif
+
+    const std::size_t separator = executable.find_last_of("/\\");
+
+    return separator != std::string::npos
+        ? executable.substr(0, separator)
+        : std::string();
+}
+
+// Room left for the code that doesn't check it: the LLVM calls, the
+// visits between two checks.
+static constexpr std::uintptr_t STACK_RED_ZONE = 256 * 1024;
+static constexpr std::size_t STACK_SEGMENT_SIZE = 16 * 1024 * 1024;
+
+#ifdef _WIN32
+
+bool isStackLow() {
+    ULONG_PTR low, high;
+    GetCurrentThreadStackLimits(&low, &high);
+
+    // The limits of the fiber running, the thread or one of runOnNewStack.
+    const auto here = reinterpret_cast<std::uintptr_t>(&low);
+    return here - low < STACK_RED_ZONE;
+}
+
+struct StackCall {
+    void (*function)(void*);
+    void* argument;
+    void* caller;
+};
+
+static VOID CALLBACK runStackCall(LPVOID parameter) {
+    auto* call = static_cast<StackCall*>(parameter);
+    call->function(call->argument);
+
+    SwitchToFiber(call->caller);
+}
+
+void runOnNewStack(void (*function)(void*), void* argument) {
+
+    const bool isFiber = IsThreadAFiber();
+    StackCall call{function, argument, isFiber ? GetCurrentFiber() : ConvertThreadToFiber(nullptr)};
+
+    void* fiber = CreateFiber(STACK_SEGMENT_SIZE, runStackCall, &call);
+
+    if(fiber == nullptr) {
+        std::fputs("Out of memory for the stack.\n", stderr);
+        std::exit(EXIT_FAILURE);
+    }
+
+    SwitchToFiber(fiber);
+    DeleteFiber(fiber);
+
+    if(!isFiber) ConvertFiberToThread();
+}
+
+#else
+
+// Lowest address of the stack running, 0 until known.
+static thread_local std::uintptr_t stackLimit = 0;
+
+// 0 where the limits of the stack can't be asked, the stack is never low.
+static std::uintptr_t threadStackLimit() {
+
+    void* address = nullptr;
+
+#if defined(__APPLE__)
+    address = static_cast<char*>(pthread_get_stackaddr_np(pthread_self())) - pthread_get_stacksize_np(pthread_self());
+#elif defined(__linux__)
+    // glibc and musl.
+    pthread_attr_t attributes;
+    std::size_t size = 0;
+
+    if(pthread_getattr_np(pthread_self(), &attributes) == 0) {
+        pthread_attr_getstack(&attributes, &address, &size);
+        pthread_attr_destroy(&attributes);
+    }
+#endif
+
+    return reinterpret_cast<std::uintptr_t>(address);
+}
+
+bool isStackLow() {
+    if(stackLimit == 0) stackLimit = threadStackLimit();
+
+    char marker;
+    return reinterpret_cast<std::uintptr_t>(&marker) - stackLimit < STACK_RED_ZONE;
+}
+
+#ifdef __GLIBC__
+
+// makecontext and swapcontext were removed from POSIX.1-2008, they are
+// deprecated on macOS and missing in musl: only glibc switches stacks.
+#include <ucontext.h>
+
+// Taken by the new context as soon as it starts.
+static thread_local void (*stackFunction)(void*) = nullptr;
+static thread_local void* stackArgument = nullptr;
+
+static void runStackFunction() {
+    stackFunction(stackArgument);
+}
+
+void runOnNewStack(void (*function)(void*), void* argument) {
+
+    // Not initialized, the pages are only mapped when the calls reach them.
+    std::unique_ptr<char[]> stack(new char[STACK_SEGMENT_SIZE]);
+
+    ucontext_t caller;
+    ucontext_t callee;
+
+    getcontext(&callee);
+    callee.uc_stack.ss_sp = stack.get();
+    callee.uc_stack.ss_size = STACK_SEGMENT_SIZE;
+    callee.uc_link = &caller;
+
+    stackFunction = function;
+    stackArgument = argument;
+    makecontext(&callee, runStackFunction, 0);
+
+    const std::uintptr_t limit = stackLimit;
+    stackLimit = reinterpret_cast<std::uintptr_t>(stack.get());
+
+    swapcontext(&caller, &callee);
+
+    stackLimit = limit;
+}
+
+#else
+
+// The bounded-depth fallback: the stack can't grow, the nesting that needs
+// more than it is an error.
+void runOnNewStack(void (*)(void*), void*) {
+    std::fputs("Error: the program is nested too deeply for the stack.\n", stderr);
+    std::exit(EXIT_FAILURE);
+}
+
+#endif
+
+#endif
+
 
 }
@@ -1,7 +1,45 @@
 #ifndef _OS_HPP_
+#define _OS_HPP_
+
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 namespace pl0::os {
     int spawnProcess(const char* program, char* const args[]);
+
+    // Directory of the running executable, empty if unknown.
+    std::string executableDirectory();
+
+    // True when the stack of the calling thread is almost exhausted.
+    bool isStackLow();
+
+    // Calls `function(argument)` on a new stack allocated on the heap, with
+    // Windows fibers and with glibc only. Elsewhere it reports that the
+    // program is nested too deeply and exits.
+    void runOnNewStack(void (*function)(void*), void* argument);
+
+    // Calls `function`, on a new stack when the current one is almost
+    // exhausted. The recursive walks of the AST go through it once per
+    // level, so the nesting of a program is limited by the memory only where
+    // the stacks can be switched, by the stack of the thread elsewhere.
+    template<typename Function>
+    auto withStack(Function&& function) -> std::invoke_result_t<Function&> {
+        using Result = std::invoke_result_t<Function&>;
+
+        if(!isStackLow()) return function();
+
+        if constexpr(std::is_void_v<Result>) {
+            runOnNewStack([](void* pointer) { (*static_cast<std::remove_reference_t<Function>*>(pointer))(); }, &function);
+        } else {
+            std::optional<Result> result;
+            auto call = [&] { result.emplace(function()); };
+
+            runOnNewStack([](void* pointer) { (*static_cast<decltype(call)*>(pointer))(); }, &call);
+            return std::move(*result);
+        }
+    }
 }
 
 #endif
@@ -1,14 +1,118 @@
 #include "parser.hpp"
 #include "ast.hpp"
 #include "token.hpp"
+#include "memstats.hpp"
+#include "os.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <charconv>
 #include <system_error>
+#include <thread>
 
 namespace pl0::parser {
 
+namespace {
+
+/*
+
+Pre-scan of the procedures declared by the main block. Only the keywords
+are looked at: a declaration ends at its ';', a body at the first ';' out of
+its begin...end. The ranges are checked by parsing them.
+
+*/
+class ProcedureScanner final {
+public:
+    explicit ProcedureScanner(const std::vector<Token>& tokens)
+        : m_tokens(tokens) {}
+
+    auto scan() const -> std::vector<std::pair<std::uint32_t, std::uint32_t>> {
+
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> procedures;
+        std::uint32_t i = skipDeclarations(0);
+
+        while(type(i) == TokenType::ProcedureKeyword) {
+            const auto last = procedure(i);
+            if(!last.has_value()) break;
+
+            procedures.emplace_back(i, last.value());
+            i = last.value() + 1;
+        }
+
+        return procedures;
+    }
+
+private:
+
+    inline auto type(std::uint32_t i) const -> TokenType {
+        return i < m_tokens.size() ? m_tokens[i].type : TokenType::Eof;
+    }
+
+    auto skipDeclarations(std::uint32_t i) const -> std::uint32_t {
+
+        for(TokenType keyword : {TokenType::ConstKeyword, TokenType::VarKeyword, TokenType::SharedKeyword}) {
+            if(type(i) != keyword) continue;
+
+            while(type(i) != TokenType::Semicolon && type(i) != TokenType::Eof) i++;
+            i++;
+        }
+
+        return i;
+    }
+
+    // The ';' after the body of the procedure declared at `i`.
+    auto procedure(std::uint32_t i) const -> std::optional<std::uint32_t> {
+
+        if(type(i + 1) != TokenType::Identifier || type(i + 2) != TokenType::Semicolon) return {};
+
+        i = skipDeclarations(i + 3);
+
+        while(type(i) == TokenType::ProcedureKeyword) {
+            const auto last = procedure(i);
+            if(!last.has_value()) return {};
+
+            i = last.value() + 1;
+        }
+
+        std::uint32_t depth = 0;
+
+        for(;; i++) {
+
+            switch(type(i)) {
+                case TokenType::BeginKeyword:
+                    depth++;
+                    break;
+                case TokenType::EndKeyword:
+                    if(depth == 0) return {};
+                    depth--;
+                    break;
+                case TokenType::Semicolon:
+                    if(depth == 0) return i;
+                    break;
+                case TokenType::ProcedureKeyword:
+                    [[fallthrough]];
+                case TokenType::Dot:
+                    [[fallthrough]];
+                case TokenType::Eof:
+                    return {};
+                default:
+                    break;
+            }
+        }
+    }
+
+private:
+    const std::vector<Token>& m_tokens;
+};
+
+}
+
 auto Parser::parseProgram() -> StatementPtr {
 
+    if(m_threads > 1 && m_source == nullptr && m_emitter == nullptr && !m_recordRegions) {
+        parseProcedures();
+    }
+
     StatementPtr program = block();
     
     if(!consume(TokenType::Dot, "Expect '.' at end of the program.").has_value()) {
@@ -22,6 +126,86 @@ auto Parser::parseProgram() -> StatementPtr {
     return program;
 }
 
+auto Parser::parseRegion() -> StatementPtr {
+
+    if(match({TokenType::ProcedureKeyword})) {
+        return region(&Parser::procedureDeclaration);
+    }
+
+    if(match({TokenType::BeginKeyword})) {
+        return region(&Parser::beginStatement);
+    }
+
+    error("[Ln: {}] Error: Expect 'procedure' or 'begin'.", current().line);
+    return nullptr;
+}
+
+auto Parser::region(StatementPtr (Parser::*parse)()) -> StatementPtr {
+
+    if(!m_recordRegions) return (this->*parse)();
+
+    const std::size_t index = m_regions.size();
+    m_regions.push_back({m_curr - 1, 0, nullptr});
+
+    StatementPtr stmt = (this->*parse)();
+
+    m_regions[index].last = m_curr - 1;
+    m_regions[index].node = stmt.get();
+
+    return stmt;
+}
+
+auto Parser::parseProcedures() -> void {
+
+    const auto procedures = ProcedureScanner(m_tokens).scan();
+    if(procedures.size() < 2) return;
+
+    m_parsed.resize(procedures.size());
+    std::atomic<std::size_t> next = 0;
+
+    const auto work = [&] {
+        memstats::CategoryScope category(memstats::Category::Ast);
+
+        for(std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < procedures.size();) {
+            const auto [first, last] = procedures[i];
+
+            Parser parser(m_tokens, first, last);
+            StatementPtr node = parser.parseRegion();
+
+            // Ending before its ';' the scan was wrong.
+            if(parser.hadError() || parser.m_curr != last + 1 - first) node = nullptr;
+
+            m_parsed[i] = {first, last, std::move(node)};
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const std::size_t threads = std::min<std::size_t>(m_threads, procedures.size());
+
+    for(std::size_t i = 1; i < threads; i++) {
+        workers.emplace_back(work);
+    }
+
+    work();
+
+    for(auto& worker : workers) worker.join();
+}
+
+auto Parser::takeParsed() -> StatementPtr {
+
+    if(m_nextParsed == m_parsed.size() || m_parsed[m_nextParsed].first != m_curr - 1) {
+        return nullptr;
+    }
+
+    ParsedProcedure& parsed = m_parsed[m_nextParsed++];
+
+    // In panic mode the parse in order skips some tokens first.
+    if(parsed.node == nullptr || m_panicMode) return nullptr;
+
+    m_curr = parsed.last + 1;
+    return std::move(parsed.node);
+}
+
 auto Parser::block() -> StatementPtr {
 
     StatementPtr constants = match({TokenType::ConstKeyword})
@@ -31,15 +215,27 @@ auto Parser::block() -> StatementPtr {
     StatementPtr variables = match({TokenType::VarKeyword})
         ? variableDeclarations()
         : nullptr;
+
+    StatementPtr shared = match({TokenType::SharedKeyword})
+        ? variableDeclarations(true)
+        : nullptr;
+
+    if(Emitter* emitter = this->emitter()) {
+        emitter->beginBlock(constants, variables, shared, current().type == TokenType::ProcedureKeyword);
+    }
     
     std::vector<StatementPtr> procedures;
     while(match({TokenType::ProcedureKeyword})){
-        procedures.push_back(procedureDeclaration());
+        StatementPtr procedure = takeParsed();
+        if(procedure == nullptr) procedure = region(&Parser::procedureDeclaration);
+        if(m_emitter == nullptr) procedures.push_back(std::move(procedure));
     }
 
-    StatementPtr stmt = statement();
+    StatementPtr stmt = bodyStatement();
+
+    if(endEmitted(&Emitter::endBlock)) return nullptr;
 
-    return buildStatement<Block>(constants, variables, procedures, stmt);
+    return buildStatement<Block>(constants, variables, shared, procedures, stmt);
 }
 
 auto Parser::constDeclarations() -> StatementPtr {
@@ -71,22 +267,37 @@ auto Parser::constDeclarations() -> StatementPtr {
     return buildStatement<ConstDeclarations>(declarations);
 }
 
-auto Parser::variableDeclarations() -> StatementPtr { 
+auto Parser::variableDeclarations(bool isShared) -> StatementPtr { 
 
-    std::vector<Token> identifiers;
+    std::vector<VariableDeclaration> declarations;
 
     do {
         auto ident = consume(TokenType::Identifier, "Expect constant name.");
         if(!ident.has_value()) return nullptr;
+
+        std::optional<Token> length = {};
+
+        if(match({TokenType::LeftBracket})) {
+            if(!match({TokenType::Number, TokenType::Identifier})) {
+                error("[Ln: {}] Error: Expect the array length.", current().line);
+                return nullptr;
+            }
+
+            length = previous();
+
+            if(!consume(TokenType::RightBracket, "Expect ']' after the array length.").has_value()) {
+                return nullptr;
+            }
+        }
         
-        identifiers.push_back(ident.value());
+        declarations.push_back({ident.value(), length});
     } while(match({TokenType::Comma}));
 
     if(!consume(TokenType::Semicolon, "Expect ';' after variable declarations.").has_value()) {
         return nullptr;
     }
 
-    return buildStatement<VariableDeclarations>(identifiers);
+    return buildStatement<VariableDeclarations>(declarations, isShared);
 }
 
 auto Parser::procedureDeclaration() -> StatementPtr { 
@@ -98,12 +309,16 @@ auto Parser::procedureDeclaration() -> StatementPtr {
         return nullptr;
     }
 
-    StatementPtr body = block();
+    if(Emitter* emitter = this->emitter()) emitter->beginProcedure(name.value());
+
+    StatementPtr body = os::withStack([this] { return block(); });
 
     if(!consume(TokenType::Semicolon, "Expect ';' at end of procedure body.").has_value()) {
         return nullptr;
     }
 
+    if(endEmitted(&Emitter::endProcedure)) return nullptr;
+
     return buildStatement<ProcedureDeclaration>(name.value(), body); 
 }
 
@@ -120,11 +335,15 @@ auto Parser::statement() -> StatementPtr {
     } else if(match({TokenType::ExclamationMark})) {
         return printStatement();
     } else if(match({TokenType::BeginKeyword})) {
-        return beginStatement();
+        return region(&Parser::beginStatement);
     } else if(match({TokenType::IfKeyword})) {
         return ifStatement();
     } else if(match({TokenType::WhileKeyword})) {
         return whileStatement();
+    } else if(match({TokenType::ForKeyword})) {
+        return forStatement();
+    } else if(match({TokenType::ParallelKeyword})) {
+        return parallelStatement();
     }
 
     error("[Ln: {}] Error: Invalid statement.", current().line);
@@ -133,13 +352,14 @@ auto Parser::statement() -> StatementPtr {
 
 auto Parser::assignStatement() -> StatementPtr{
     auto ident = previous();
+    ExpressionPtr index = arrayIndex();
 
     if(!consume(TokenType::Assign, "Expect ':=' after lvalue.").has_value()) {
         return nullptr;
     }
 
     ExpressionPtr rvalue = expression();
-    return buildStatement<AssignStatement>(ident, rvalue);
+    return buildStatement<AssignStatement>(ident, index, rvalue);
 }
 
 auto Parser::callStatement() -> StatementPtr {
@@ -154,10 +374,10 @@ auto Parser::callStatement() -> StatementPtr {
 auto Parser::inputStatement() -> StatementPtr{
 
     auto ident = consume(TokenType::Identifier, "Expect an identifier.");
+    if(!ident.has_value()) return nullptr;
 
-    return ident.has_value()
-        ? buildStatement<InputStatement>(ident.value())
-        : nullptr;
+    ExpressionPtr index = arrayIndex();
+    return buildStatement<InputStatement>(ident.value(), index);
 }
 
 auto Parser::printStatement() -> StatementPtr {
@@ -169,16 +389,37 @@ auto Parser::beginStatement() -> StatementPtr{
 
     std::vector<StatementPtr> statements;
 
+    if(Emitter* emitter = this->emitter()) emitter->beginStatements();
+
     do {
-        statements.push_back(statement());
+        const std::size_t reported = errors().size();
+
+        StatementPtr stmt = bodyStatement();
+        if(m_emitter == nullptr) statements.push_back(std::move(stmt));
+
+        // A broken statement ends at the next ';' or 'end', the following
+        // ones are still parsed.
+        if(current().type != TokenType::Semicolon && current().type != TokenType::EndKeyword) {
+            if(errors().size() == reported) {
+                error("[Ln: {}] Error: Expect 'end' after statements.", current().line);
+            }
+
+            skipStatement();
+        }
+
+        if(Emitter* emitter = this->emitter(); emitter != nullptr && current().type == TokenType::Semicolon) {
+            emitter->nextStatement();
+        }
     } while(match({TokenType::Semicolon}));
-    
-    if(!consume(TokenType::EndKeyword, "Expect 'end' after statements.").has_value()) {
-        return nullptr;
-    }
+
+    // Reported in the loop when missing.
+    if(!match({TokenType::EndKeyword})) return nullptr;
+
+    if(endEmitted(&Emitter::endStatements)) return nullptr;
     
     return buildStatement<BeginStatement>(statements);
 }
+
 auto Parser::ifStatement() -> StatementPtr{
 
     ExpressionPtr cond = condition();
@@ -187,7 +428,11 @@ auto Parser::ifStatement() -> StatementPtr{
         return nullptr;
     }
 
-    StatementPtr body = statement();
+    if(Emitter* emitter = this->emitter()) emitter->beginIf(cond);
+
+    StatementPtr body = bodyStatement();
+
+    if(endEmitted(&Emitter::endIf)) return nullptr;
 
     return buildStatement<IfStatement>(cond, body);
 }
@@ -200,11 +445,93 @@ auto Parser::whileStatement() -> StatementPtr{
         return nullptr;
     }
 
-    StatementPtr body = statement();
+    if(Emitter* emitter = this->emitter()) emitter->beginWhile(cond);
+
+    StatementPtr body = bodyStatement();
+
+    if(endEmitted(&Emitter::endWhile)) return nullptr;
 
     return buildStatement<WhileStatement>(cond, body);
 }
 
+auto Parser::forStatement() -> StatementPtr {
+
+    auto variable = consume(TokenType::Identifier, "Expect the loop variable after 'for'.");
+    if(!variable.has_value()) return nullptr;
+
+    if(!consume(TokenType::Assign, "Expect ':=' after the loop variable.").has_value()) {
+        return nullptr;
+    }
+
+    ExpressionPtr from = expression();
+
+    if(!consume(TokenType::ToKeyword, "Expect 'to' after the initial value.").has_value()) {
+        return nullptr;
+    }
+
+    ExpressionPtr to = expression();
+
+    ExpressionPtr step = match({TokenType::StepKeyword})
+        ? expression()
+        : nullptr;
+
+    if(!consume(TokenType::DoKeyword, "Expect 'do' after the final value.").has_value()) {
+        return nullptr;
+    }
+
+    if(Emitter* emitter = this->emitter()) emitter->beginFor(variable.value(), from, to, step);
+
+    StatementPtr body = bodyStatement();
+
+    if(endEmitted(&Emitter::endFor)) return nullptr;
+
+    return buildStatement<ForStatement>(variable.value(), from, to, step, body);
+}
+
+auto Parser::parallelStatement() -> StatementPtr {
+
+    Token keyword = previous();
+
+    if(!consume(TokenType::BeginKeyword, "Expect 'begin' after 'parallel'.").has_value()) {
+        return nullptr;
+    }
+
+    std::vector<StatementPtr> calls;
+
+    do {
+        if(!consume(TokenType::CallKeyword, "Only 'call' statements can run in parallel.").has_value()) {
+            return nullptr;
+        }
+
+        calls.push_back(callStatement());
+    } while(match({TokenType::Semicolon}));
+
+    if(!consume(TokenType::EndKeyword, "Expect 'end' after the parallel calls.").has_value()) {
+        return nullptr;
+    }
+
+    return buildStatement<ParallelStatement>(keyword, calls);
+}
+
+auto Parser::bodyStatement() -> StatementPtr {
+
+    StatementPtr stmt = os::withStack([this] { return statement(); });
+
+    Emitter* emitter = this->emitter();
+    if(emitter == nullptr || stmt == nullptr) return stmt;
+
+    emitter->statement(stmt);
+    return nullptr;
+}
+
+auto Parser::endEmitted(void (Emitter::*end)()) -> bool {
+
+    if(m_emitter == nullptr) return false;
+
+    if(Emitter* emitter = this->emitter()) (emitter->*end)();
+    return true;
+}
+
 auto Parser::condition() -> ExpressionPtr {
 
     if(match({TokenType::OddKeyword})){
@@ -267,7 +594,12 @@ auto Parser::termExpression() -> ExpressionPtr {
 auto Parser::factorExpression() -> ExpressionPtr { 
 
     if(match({TokenType::Identifier})) {
-        return buildExpression<VariableExpression>(previous());
+        Token name = previous();
+        ExpressionPtr index = arrayIndex();
+
+        return index != nullptr
+            ? buildExpression<IndexExpression>(name, index)
+            : buildExpression<VariableExpression>(name);
     }
 
     if(match({TokenType::Number})){
@@ -279,7 +611,7 @@ auto Parser::factorExpression() -> ExpressionPtr {
     }
     
     if(match({TokenType::LeftParen})){
-        ExpressionPtr expr = expression();
+        ExpressionPtr expr = os::withStack([this] { return expression(); });
         if(consume(TokenType::RightParen, "Expect a ')' after the expression.").has_value()){
             return expr;
         }
@@ -291,6 +623,19 @@ auto Parser::factorExpression() -> ExpressionPtr {
     return nullptr; 
 }
 
+auto Parser::arrayIndex() -> ExpressionPtr {
+
+    if(!match({TokenType::LeftBracket})) return nullptr;
+
+    ExpressionPtr index = os::withStack([this] { return expression(); });
+
+    if(!consume(TokenType::RightBracket, "Expect ']' after the index.").has_value()) {
+        return nullptr;
+    }
+
+    return index;
+}
+
 auto Parser::convertToInteger(Token token) -> std::optional<int> {
 
     const auto& lexeme = token.lexeme;
@@ -313,6 +658,19 @@ auto Parser::convertToInteger(Token token) -> std::optional<int> {
     return result;
 }
 
+auto Parser::refill() -> void {
+
+    m_tokens.front() = m_tokens.back();
+    m_tokens.resize(1);
+    m_curr = 1;
+
+    if(m_tokens.front().type != TokenType::Eof) {
+        m_source->read(m_tokens);
+    }
+
+    m_view = m_tokens;
+}
+
 auto Parser::match(const std::initializer_list<TokenType>& types) -> bool {
     for(TokenType type : types){
         if(current().type == type){
@@ -334,6 +692,37 @@ auto Parser::consume(TokenType type, const char* message) -> std::optional<Token
 }
 
 
+auto Parser::skipStatement() -> void {
+
+    std::uint32_t depth = 0;
+
+    while(!isAtEnd()) {
+
+        switch(current().type) {
+            case TokenType::BeginKeyword:
+                depth++;
+                break;
+            case TokenType::EndKeyword:
+                if(depth == 0) return;
+                depth--;
+                break;
+            case TokenType::Semicolon:
+                if(depth == 0) return;
+                break;
+            case TokenType::ProcedureKeyword:
+                [[fallthrough]];
+            case TokenType::Dot:
+                [[fallthrough]];
+            case TokenType::Eof:
+                return;
+            default:
+                break;
+        }
+
+        advance();
+    }
+}
+
 auto Parser::synchronize() -> void {
 
     while(!isAtEnd()){
@@ -359,11 +748,17 @@ auto Parser::synchronize() -> void {
                 [[fallthrough]];
             case TokenType::DoKeyword:
                 [[fallthrough]];
+            case TokenType::ForKeyword:
+                [[fallthrough]];
+            case TokenType::ParallelKeyword:
+                [[fallthrough]];
             case TokenType::QuestionMark:
                 [[fallthrough]];
             case TokenType::ExclamationMark:
                 [[fallthrough]];
             case TokenType::Identifier:
+                [[fallthrough]];
+            case TokenType::Eof:
                 return;
             default:
                 advance();
@@ -3,12 +3,14 @@
 
 #include "ast.hpp"
 #include "token.hpp"
+#include "tokenizer.hpp"
 #include "errors_holder_trait.hpp"
 
 #include <vector>
 #include <format>
 #include <utility>
 #include <optional>
+#include <span>
 #include <string_view>
 #include <initializer_list>
 
@@ -18,20 +20,133 @@ using namespace error;
 using namespace token;
 using namespace ast;
 
+// Tokens of a procedure declaration or a begin...end, from its keyword to
+// its last token. `node` is nullptr when it didn't parse.
+struct Region {
+    std::uint32_t first;
+    std::uint32_t last;
+    Statement* node;
+};
+
+// Top level procedure parsed ahead on a worker thread, from its keyword to
+// the ';' after its body. `node` is nullptr when it must be parsed again in
+// order.
+struct ParsedProcedure {
+    std::uint32_t first;
+    std::uint32_t last;
+    StatementPtr node;
+};
+
+/*
+
+Back end fed while the program is parsed, in one pass (-one-pass). The
+declarations and the simple statements (assignments, calls, input, print
+and parallel blocks) are handed over as soon as they are parsed, and freed
+right after. The compound statements are events around their bodies.
+
+Nothing is emitted after the first syntax error.
+
+*/
+class Emitter {
+public:
+    virtual ~Emitter() = default;
+
+    // After the declarations of a block, `hasProcedures` if some follow.
+    virtual auto beginBlock(StatementPtr& constants, StatementPtr& variables,
+                            StatementPtr& shared, bool hasProcedures) -> void = 0;
+    virtual auto endBlock() -> void = 0;
+
+    virtual auto beginProcedure(const Token& name) -> void = 0;
+    virtual auto endProcedure() -> void = 0;
+
+    virtual auto statement(StatementPtr& stmt) -> void = 0;
+
+    // `nextStatement` when a ';' follows a statement of the begin...end.
+    virtual auto beginStatements() -> void = 0;
+    virtual auto nextStatement() -> void = 0;
+    virtual auto endStatements() -> void = 0;
+
+    virtual auto beginIf(ExpressionPtr& condition) -> void = 0;
+    virtual auto endIf() -> void = 0;
+
+    virtual auto beginWhile(ExpressionPtr& condition) -> void = 0;
+    virtual auto endWhile() -> void = 0;
+
+    virtual auto beginFor(const Token& variable, ExpressionPtr& from,
+                          ExpressionPtr& to, ExpressionPtr& step) -> void = 0;
+    virtual auto endFor() -> void = 0;
+};
+
 class Parser final : public ErrorsHolderTrait {
 public:
     explicit Parser(std::vector<Token>& tokens)
         : m_tokens(std::move(tokens)),
+          m_view(m_tokens),
           m_curr(0),
           m_panicMode(false) {}
-          
+
+    // Pulls the tokens from `source` while parsing, only the current
+    // batch and the previous token are kept. Regions can't be recorded.
+    explicit Parser(tokenizer::TokenSource& source)
+        : m_curr(0),
+          m_panicMode(false),
+          m_source(&source) {
+        source.read(m_tokens);
+        m_view = m_tokens;
+    }
+
+    // The parser reads its tokens through m_view, which may point into them.
+    Parser(const Parser&) = delete;
+    auto operator=(const Parser&) -> Parser& = delete;
+
+    // Hands the program to `emitter` instead of building the AST, the
+    // parse functions return nullptr.
+    inline auto setEmitter(Emitter* emitter) -> void {
+        m_emitter = emitter;
+    }
+
     auto parseProgram() -> StatementPtr;
 
+    // Parses the single procedure declaration or begin...end starting at
+    // the first token, to reparse a region of a program.
+    auto parseRegion() -> StatementPtr;
+
+    // Records the regions parsed, in the order of their first token.
+    inline auto setRecordRegions(bool record) -> void {
+        m_recordRegions = record;
+    }
+
+    inline auto regions() -> std::vector<Region>& {
+        return m_regions;
+    }
+
+    // Parses the procedures of the main block on `threads` threads before
+    // the rest of the program (-parallel-parse). Only when the parser owns
+    // all the tokens, without an emitter nor regions.
+    inline auto setThreads(unsigned threads) -> void {
+        m_threads = threads;
+    }
+
+    // The AST doesn't refer to the token vector, it can be freed as soon
+    // as the program is parsed.
+    inline auto releaseTokens() -> void {
+        m_tokens = std::vector<Token>();
+        m_view = m_tokens;
+        m_curr = 0;
+    }
+
 private:
+    // Parses `tokens[first]` to `tokens[last]` followed by an Eof, in place:
+    // the tokens are shared with the other workers and only read.
+    Parser(std::span<const Token> tokens, std::uint32_t first, std::uint32_t last)
+        : m_view(tokens.subspan(first, last + 1 - first)),
+          m_end(TokenType::Eof, std::string_view(), tokens[last].line),
+          m_curr(0),
+          m_panicMode(false) {}
 
     auto block() -> StatementPtr;
     auto constDeclarations() -> StatementPtr;
-    auto variableDeclarations() -> StatementPtr;
+    auto variableDeclarations(bool isShared = false) -> StatementPtr;
     auto procedureDeclaration() -> StatementPtr;
 
     auto statement() -> StatementPtr;
@@ -42,6 +157,20 @@ private:
     auto beginStatement() -> StatementPtr;
     auto ifStatement() -> StatementPtr;
     auto whileStatement() -> StatementPtr;
+    auto forStatement() -> StatementPtr;
+    auto parallelStatement() -> StatementPtr;
+
+    // Runs `parse` after the keyword of a region, recording the region.
+    auto region(StatementPtr (Parser::*parse)()) -> StatementPtr;
+
+    // Fills m_parsed, the procedures found by a pre-scan of the tokens are
+    // parsed concurrently.
+    auto parseProcedures() -> void;
+
+    // The procedure whose keyword was just matched if it was parsed ahead,
+    // nullptr to parse it now. The diagnostics come from the parse in
+    // order, so the procedures with errors are parsed again.
+    auto takeParsed() -> StatementPtr;
 
     auto condition() -> ExpressionPtr;
 
@@ -49,31 +178,55 @@ private:
     auto termExpression() -> ExpressionPtr;
     auto factorExpression() -> ExpressionPtr;
     
+    // [ expression ] after an array name, nullptr if there isn't.
+    auto arrayIndex() -> ExpressionPtr;
+
     auto convertToInteger(Token name) -> std::optional<int>;
 
     [[nodiscard]] 
     inline auto previous() const -> const Token& {
-        return m_tokens[m_curr - 1];
+        return m_view[m_curr - 1];
     }
 
+    // m_end past the tokens, a window of tokens has no Eof of its own.
     [[nodiscard]] 
     inline auto current() const -> const Token& {
-        return m_tokens[m_curr];
+        return m_curr < m_view.size() ? m_view[m_curr] : m_end;
     }
 
     constexpr auto isAtEnd() const -> bool {
-        return m_curr >= m_tokens.size();
+        return m_curr >= m_view.size();
     }
 
     inline auto advance() -> void {
         if(isAtEnd()) return;
+
         m_curr++;
+        if(m_source != nullptr && isAtEnd()) refill();
+    }
+
+    // Replaces the consumed batch by the next one, after the previous token.
+    auto refill() -> void;
+
+    inline auto emitter() const -> Emitter* {
+        return hadError() ? nullptr : m_emitter;
     }
+
+    // The statement of a block or a compound statement, emitted if it's a
+    // simple one.
+    auto bodyStatement() -> StatementPtr;
+
+    // Calls `end` at the end of a compound statement in one pass, false if
+    // the AST is built instead.
+    auto endEmitted(void (Emitter::*end)()) -> bool;
     
     auto match(const std::initializer_list<TokenType>& types) -> bool;
     auto consume(TokenType type, const char* message) -> std::optional<Token>;
     auto synchronize() -> void;
 
+    // Skips the rest of a statement in a begin...end.
+    auto skipStatement() -> void;
+
     template<typename... Args>
     inline auto error(std::string_view fmt, Args&&... args) -> void {
         pushError(std::vformat(fmt, std::make_format_args(args...)));
@@ -82,9 +235,24 @@ private:
 
 private:
     std::vector<Token> m_tokens;
+
+    // The tokens parsed: m_tokens, or a window of the tokens of another parser.
+    std::span<const Token> m_view;
+    Token m_end = Token(TokenType::Eof, std::string_view(), 0);
+
     std::uint32_t m_curr;
 
     bool m_panicMode;
+
+    bool m_recordRegions = false;
+    std::vector<Region> m_regions;
+
+    unsigned m_threads = 1;
+    std::vector<ParsedProcedure> m_parsed;
+    std::size_t m_nextParsed = 0;
+
+    tokenizer::TokenSource* m_source = nullptr;
+    Emitter* m_emitter = nullptr;
 };
 
 
@@ -0,0 +1,202 @@
+#include "peephole.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+namespace pl0::peephole {
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+namespace {
+
+// Instructions moved out of an if to turn its store into a select.
+constexpr unsigned MAX_HOISTED = 4;
+
+// icmp ne|eq (srem x, 2), 0
+auto simplifyOdd(ICmpInst* compare) -> Value* {
+
+    ICmpInst::Predicate predicate;
+    Value* operand;
+
+    if(!match(compare, m_ICmp(predicate, m_SRem(m_Value(operand), m_SpecificInt(2)), m_Zero()))) return nullptr;
+    if(!ICmpInst::isEquality(predicate)) return nullptr;
+
+    // The remainder of the odd numbers is 1 or -1, both with the low bit set.
+    IRBuilder<> builder(compare);
+    Value* odd = builder.CreateTrunc(operand, builder.getInt1Ty(), "odd");
+
+    return predicate == ICmpInst::ICMP_NE ? odd : builder.CreateNot(odd, "even");
+}
+
+// The integers wrap, so the negations cancel out without overflow checks.
+auto simplifyNegation(BinaryOperator* operation) -> Value* {
+
+    Value* left;
+    Value* right;
+
+    IRBuilder<> builder(operation);
+
+    if(match(operation, m_Neg(m_Neg(m_Value(right))))) {
+        return right;
+    }
+
+    if(match(operation, m_Neg(m_OneUse(m_Sub(m_Value(left), m_Value(right)))))) {
+        return builder.CreateSub(right, left, "subtmp");
+    }
+
+    if(match(operation, m_Sub(m_Value(left), m_Neg(m_Value(right))))) {
+        return builder.CreateAdd(left, right, "addtmp");
+    }
+
+    if(match(operation, m_c_Add(m_Value(left), m_Neg(m_Value(right))))) {
+        return builder.CreateSub(left, right, "subtmp");
+    }
+
+    return nullptr;
+}
+
+// Only loaded and stored, not reachable from the nested procedures nor the
+// other threads.
+auto isLocal(Value* pointer) -> bool {
+
+    if(!isa<AllocaInst>(pointer)) return false;
+
+    for(const User* user : pointer->users()) {
+        if(const auto* load = dyn_cast<LoadInst>(user)) {
+            if(!load->isSimple()) return false;
+        } else if(const auto* store = dyn_cast<StoreInst>(user)) {
+            if(store->getPointerOperand() != pointer || !store->isSimple()) return false;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The body of `if c then x := e` is the computation of e and the store:
+// e is computed anyway and x gets c ? e : x.
+auto convertToSelect(BranchInst* branch, BasicBlock* body) -> bool {
+
+    Instruction* last = body->getTerminator()->getPrevNode();
+    auto* store = dyn_cast_or_null<StoreInst>(last);
+
+    if(store == nullptr || !store->isSimple() || !isLocal(store->getPointerOperand())) return false;
+
+    unsigned hoisted = 0;
+
+    for(Instruction& instruction : *body) {
+        if(&instruction == store) break;
+        if(!isSafeToSpeculativelyExecute(&instruction) || ++hoisted > MAX_HOISTED) return false;
+    }
+
+    for(Instruction& instruction : make_early_inc_range(*body)) {
+        if(&instruction == store) break;
+        instruction.moveBefore(branch);
+    }
+
+    IRBuilder<> builder(branch);
+    builder.SetCurrentDebugLocation(store->getDebugLoc());
+
+    Value* local = store->getPointerOperand();
+    Value* value = store->getValueOperand();
+
+    Value* previous = builder.CreateLoad(value->getType(), local, "previous");
+    builder.CreateStore(builder.CreateSelect(branch->getCondition(), value, previous, "selecttmp"), local);
+
+    store->eraseFromParent();
+    return true;
+}
+
+// br c, body, end where the body only falls through to end.
+auto simplifyIf(BranchInst* branch) -> bool {
+
+    if(!branch->isConditional()) return false;
+
+    BasicBlock* body = branch->getSuccessor(0);
+    BasicBlock* end = branch->getSuccessor(1);
+
+    auto* exit = dyn_cast<BranchInst>(body->getTerminator());
+
+    if(body == end || body->getSinglePredecessor() != branch->getParent()) return false;
+    if(exit == nullptr || exit->isConditional() || exit->getSuccessor(0) != end) return false;
+    if(isa<PHINode>(end->front())) return false;
+
+    if(&body->front() != exit && !convertToSelect(branch, body)) return false;
+
+    Value* condition = branch->getCondition();
+
+    BranchInst::Create(end, branch);
+    branch->eraseFromParent();
+
+    RecursivelyDeleteTriviallyDeadInstructions(condition);
+    return true;
+}
+
+}
+
+auto PeepholePass::run(Function& function, FunctionAnalysisManager& analyses) -> PreservedAnalyses {
+
+    bool changedInstructions = false;
+    bool changedBlocks = false;
+
+    for(BasicBlock& block : function) {
+        for(Instruction& instruction : make_early_inc_range(block)) {
+            Value* simplified = nullptr;
+
+            if(auto* compare = dyn_cast<ICmpInst>(&instruction)) {
+                simplified = simplifyOdd(compare);
+            } else if(auto* operation = dyn_cast<BinaryOperator>(&instruction)) {
+                simplified = simplifyNegation(operation);
+            }
+
+            if(simplified == nullptr) continue;
+
+            instruction.replaceAllUsesWith(simplified);
+            RecursivelyDeleteTriviallyDeadInstructions(&instruction);
+
+            changedInstructions = true;
+        }
+    }
+
+    // The blocks of the ifs removed are only dropped at the end, then the
+    // code after them joins the code before.
+    SmallVector<WeakVH, 16> joins;
+
+    for(BasicBlock& block : function) {
+        if(ConstantFoldTerminator(&block)) {
+            joins.push_back(block.getTerminator()->getSuccessor(0));
+            changedBlocks = true;
+        }
+
+        auto* branch = dyn_cast<BranchInst>(block.getTerminator());
+
+        if(branch != nullptr && simplifyIf(branch)) {
+            joins.push_back(block.getTerminator()->getSuccessor(0));
+            changedBlocks = true;
+        }
+    }
+
+    if(changedBlocks) removeUnreachableBlocks(function);
+
+    // Unless they were unreachable too.
+    for(const WeakVH& join : joins) {
+        if(join != nullptr) MergeBlockIntoPredecessor(cast<BasicBlock>(join));
+    }
+
+    if(changedBlocks) return PreservedAnalyses::none();
+    if(!changedInstructions) return PreservedAnalyses::all();
+
+    PreservedAnalyses preserved;
+    preserved.preserveSet<CFGAnalyses>();
+    return preserved;
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef _PEEPHOLE_HPP_
+#define _PEEPHOLE_HPP_
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+
+namespace pl0::peephole {
+
+/*
+
+Rewrites the code the generator emits for some PL/0 constructs into its
+cheapest form. It runs first in the pipeline, at -O0 too:
+
+    odd x                   trunc x to i1, not srem x, 2 != 0
+    -(-x)                   x
+    -(a - b)                b - a
+    a + -b, a - -b          a - b, a + b
+    if c then x := e        x := c ? e : x, when x is a local only loaded
+                            and stored and e is safe to compute anyway
+    if c then <nothing>     no branch
+    if <constant> then s    s or nothing, without the branch
+
+*/
+class PeepholePass final : public llvm::PassInfoMixin<PeepholePass> {
+public:
+    auto run(llvm::Function& function, llvm::FunctionAnalysisManager& analyses) -> llvm::PreservedAnalyses;
+
+    // Not skipped at -O0.
+    static auto isRequired() -> bool {
+        return true;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "pipeline.hpp"
+#include "memstats.hpp"
+
+namespace pl0::pipeline {
+
+using memstats::Category;
+using memstats::CategoryScope;
+
+LexerThread::LexerThread(std::string_view source)
+    : m_tokenizer(source), m_worker(&LexerThread::work, this) {}
+
+LexerThread::~LexerThread() {
+    // The parser may stop before the end, after an error.
+    m_ring.close();
+    m_worker.join();
+}
+
+auto LexerThread::read(std::vector<Token>& tokens) -> void {
+    m_ring.pop(m_batch);
+    tokens.insert(tokens.end(), m_batch.begin(), m_batch.end());
+}
+
+auto LexerThread::work() -> void {
+
+    CategoryScope category(Category::Tokens);
+
+    std::vector<Token> batch;
+    batch.reserve(tokenizer::Tokenizer::BATCH_SIZE);
+
+    bool isLast;
+
+    do {
+        batch.clear();
+        m_tokenizer.read(batch);
+        isLast = batch.back().type == TokenType::Eof;
+    } while(m_ring.push(batch) && !isLast);
+}
+
+}
@@ -0,0 +1,126 @@
+#ifndef _PIPELINE_HPP_
+#define _PIPELINE_HPP_
+
+#include "token.hpp"
+#include "tokenizer.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pl0::pipeline {
+
+using namespace token;
+
+/*
+
+Bounded ring between one producer and one consumer thread. Each side owns
+one index: a slot is handed over by the release store of the index and
+taken with the acquire load on the other side, no lock is taken. A side
+sleeps on the other index while the ring is full or empty.
+
+The values are swapped in and out of the slots, so the buffers they own go
+back and forth instead of being allocated again.
+
+*/
+template<typename T, std::uint32_t Capacity>
+class SpscRing final {
+    static_assert(std::has_single_bit(Capacity), "the capacity must be a power of 2");
+
+public:
+
+    // Producer side, waits while the ring is full. False if the consumer
+    // closed the ring.
+    auto push(T& value) -> bool {
+        const std::uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        std::uint32_t head = m_head.load(std::memory_order_acquire);
+
+        while(tail - head == Capacity) {
+            m_head.wait(head, std::memory_order_acquire);
+            head = m_head.load(std::memory_order_acquire);
+        }
+
+        if(m_closed.load(std::memory_order_acquire)) return false;
+
+        std::swap(m_slots[tail & (Capacity - 1)], value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+
+        return true;
+    }
+
+    // Consumer side, waits while the ring is empty.
+    auto pop(T& value) -> void {
+        const std::uint32_t head = m_head.load(std::memory_order_relaxed);
+        std::uint32_t tail = m_tail.load(std::memory_order_acquire);
+
+        while(tail == head) {
+            m_tail.wait(tail, std::memory_order_acquire);
+            tail = m_tail.load(std::memory_order_acquire);
+        }
+
+        std::swap(m_slots[head & (Capacity - 1)], value);
+        m_head.store(head + 1, std::memory_order_release);
+        m_head.notify_one();
+    }
+
+    // Consumer side, the next pushes fail. Moving the head wakes a
+    // producer waiting on a full ring.
+    auto close() -> void {
+        m_closed.store(true, std::memory_order_release);
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        m_head.notify_one();
+    }
+
+private:
+    alignas(64) std::atomic<std::uint32_t> m_head = 0;
+    alignas(64) std::atomic<std::uint32_t> m_tail = 0;
+    std::atomic<bool> m_closed = false;
+
+    std::array<T, Capacity> m_slots;
+};
+
+/*
+
+Tokenizer running on its own thread (-pipeline), the parser consumes the
+batches while the next ones are scanned. At most RING_SIZE batches wait in
+the ring, the tokenizer stops when the parser falls behind.
+
+*/
+class LexerThread final : public tokenizer::TokenSource {
+public:
+    // `source` must outlive the tokens.
+    explicit LexerThread(std::string_view source);
+    ~LexerThread() override;
+
+    LexerThread(const LexerThread&) = delete;
+    LexerThread& operator=(const LexerThread&) = delete;
+
+    auto read(std::vector<Token>& tokens) -> void override;
+
+    static constexpr std::uint32_t RING_SIZE = 16;
+
+private:
+
+    // Body of the tokenizer thread.
+    auto work() -> void;
+
+private:
+    tokenizer::Tokenizer m_tokenizer;
+
+    SpscRing<std::vector<Token>, RING_SIZE> m_ring;
+
+    // Last batch read, used by the parser thread only.
+    std::vector<Token> m_batch;
+
+    std::thread m_worker;
+};
+
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include "pl0rt.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MAX_WORKERS 256
+
+struct batch {
+    int32_t remaining;
+};
+
+struct job {
+    pl0rt_task task;
+    struct batch* batch;
+    struct job* next;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobsAvailable = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+
+static struct job* head = NULL;
+static struct job* tail = NULL;
+
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static int workers = 0;
+
+static void run(pl0rt_task task) {
+    if(task.staticLink != NULL) {
+        ((void (*)(void*)) task.procedure)(task.staticLink);
+    } else {
+        task.procedure();
+    }
+}
+
+// Called with the lock held.
+static struct job* pop(void) {
+    struct job* job = head;
+
+    if(job != NULL) {
+        head = job->next;
+        if(head == NULL) tail = NULL;
+    }
+
+    return job;
+}
+
+// Called without the lock held.
+static void execute(struct job* job) {
+    run(job->task);
+
+    pthread_mutex_lock(&lock);
+    if(--job->batch->remaining == 0) pthread_cond_broadcast(&jobDone);
+    pthread_mutex_unlock(&lock);
+}
+
+static void* worker(void* argument) {
+    (void) argument;
+
+    for(;;) {
+        pthread_mutex_lock(&lock);
+
+        struct job* job;
+        while((job = pop()) == NULL) {
+            pthread_cond_wait(&jobsAvailable, &lock);
+        }
+
+        pthread_mutex_unlock(&lock);
+        execute(job);
+    }
+
+    return NULL;
+}
+
+static void startPool(void) {
+
+    const char* threads = getenv("PL0_THREADS");
+    long count = threads != NULL ? atol(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(count > MAX_WORKERS + 1) count = MAX_WORKERS + 1;
+
+    for(long i = 1; i < count; i++) {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, worker, NULL) != 0) break;
+
+        pthread_detach(thread);
+        workers++;
+    }
+}
+
+void pl0rt_parallel(const pl0rt_task* tasks, int32_t count) {
+
+    if(count <= 0) return;
+
+    pthread_once(&poolOnce, startPool);
+
+    if(workers == 0 || count == 1) {
+        for(int32_t i = 0; i < count; i++) run(tasks[i]);
+        return;
+    }
+
+    struct batch batch = { count - 1 };
+    struct job* jobs = malloc(sizeof(struct job) * (count - 1));
+
+    if(jobs == NULL) {
+        fputs("Out of memory.\n", stderr);
+        abort();
+    }
+
+    pthread_mutex_lock(&lock);
+
+    for(int32_t i = 1; i < count; i++) {
+        struct job* job = &jobs[i - 1];
+
+        job->task = tasks[i];
+        job->batch = &batch;
+        job->next = NULL;
+
+        if(tail != NULL) tail->next = job; else head = job;
+        tail = job;
+    }
+
+    pthread_cond_broadcast(&jobsAvailable);
+    pthread_mutex_unlock(&lock);
+
+    run(tasks[0]);
+
+    // While waiting, the caller runs the queued jobs too, so the nested
+    // parallel blocks can't run out of threads.
+    pthread_mutex_lock(&lock);
+
+    while(batch.remaining > 0) {
+        struct job* job = pop();
+
+        if(job != NULL) {
+            pthread_mutex_unlock(&lock);
+            execute(job);
+            pthread_mutex_lock(&lock);
+        } else {
+            pthread_cond_wait(&jobDone, &lock);
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+    free(jobs);
+}
+
+static const pl0rt_profile_entry* profileEntries = NULL;
+static int32_t profileCount = 0;
+static const char* profileProgram = NULL;
+
+// Cycles counted by a measure of nothing, taken off every sampled call.
+static double profileOverhead = 0.0;
+
+static void measureOverhead(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned long long fastest = ~0ULL;
+
+    for(int i = 0; i < 1000; i++) {
+        const unsigned long long start = __rdtsc();
+        const unsigned long long elapsed = __rdtsc() - start;
+
+        if(elapsed < fastest) fastest = elapsed;
+    }
+
+    profileOverhead = (double) fastest;
+#endif
+}
+
+// Cycles of all the calls, from the sampled ones. A call lasts until it
+// returns or tail calls, so the tail calls aren't counted twice.
+static double estimatedCycles(const pl0rt_profile_entry* entry) {
+    const int64_t calls = entry->counters[0];
+    const int64_t sampled = entry->counters[1];
+
+    if(sampled == 0) return 0.0;
+
+    const double perCall = (double) entry->counters[2] / sampled - profileOverhead;
+    return perCall > 0.0 ? perCall * calls : 0.0;
+}
+
+static int compareProcedures(const void* a, const void* b) {
+    const double first = estimatedCycles(*(const pl0rt_profile_entry* const*) a);
+    const double second = estimatedCycles(*(const pl0rt_profile_entry* const*) b);
+
+    return (first < second) - (first > second);
+}
+
+static int compareLoops(const void* a, const void* b) {
+    const int64_t first = (*(const pl0rt_profile_entry* const*) a)->counters[0];
+    const int64_t second = (*(const pl0rt_profile_entry* const*) b)->counters[0];
+
+    return (first < second) - (first > second);
+}
+
+static void writeProfile(void) {
+
+    char defaultPath[4096];
+    const char* path = getenv("PL0_PROFILE");
+
+    if(path == NULL) {
+        snprintf(defaultPath, sizeof(defaultPath), "%s.profile", profileProgram);
+        path = defaultPath;
+    }
+
+    FILE* file = fopen(path, "w");
+    if(file == NULL) return;
+
+    const pl0rt_profile_entry** procedures = malloc(sizeof(*procedures) * profileCount);
+    const pl0rt_profile_entry** loops = malloc(sizeof(*loops) * profileCount);
+    int32_t procedureCount = 0, loopCount = 0;
+    double total = 0.0;
+
+    if(procedures == NULL || loops == NULL) {
+        fclose(file);
+        return;
+    }
+
+    // What never ran is left out, e.g. the procedures never called.
+    for(int32_t i = 0; i < profileCount; i++) {
+        const pl0rt_profile_entry* entry = &profileEntries[i];
+        if(entry->counters[0] == 0) continue;
+
+        if(entry->kind == PL0RT_PROFILE_PROCEDURE) {
+            procedures[procedureCount++] = entry;
+
+            const double cycles = estimatedCycles(entry);
+            if(cycles > total) total = cycles;
+        } else {
+            loops[loopCount++] = entry;
+        }
+    }
+
+    qsort(procedures, procedureCount, sizeof(*procedures), compareProcedures);
+    qsort(loops, loopCount, sizeof(*loops), compareLoops);
+
+    fprintf(file, "# Runtime profile of %s. The cycles of a call last until it returns or\n", profileProgram);
+    fprintf(file, "# tail calls: they include the calls it waits for, not the tail calls, counted\n");
+    fprintf(file, "# as calls of the callee. They are estimated from about 1 call out of %d.\n\n", PL0RT_PROFILE_SAMPLING);
+
+    fprintf(file, "%-32s %8s %16s %20s %14s %7s\n", "procedure", "line", "calls", "cycles", "cycles/call", "share");
+
+    for(int32_t i = 0; i < procedureCount; i++) {
+        const double cycles = estimatedCycles(procedures[i]);
+        const int64_t calls = procedures[i]->counters[0];
+
+        fprintf(file, "%-32s %8d %16lld %20.0f %14.1f %6.1f%%\n", procedures[i]->procedure, procedures[i]->line,
+                (long long) calls, cycles, cycles / calls, total > 0.0 ? 100.0 * cycles / total : 0.0);
+    }
+
+    fprintf(file, "\n%-32s %8s %16s  %s\n", "loop", "line", "iterations", "procedure");
+
+    for(int32_t i = 0; i < loopCount; i++) {
+        fprintf(file, "%-32s %8d %16lld  %s\n", loops[i]->kind == PL0RT_PROFILE_WHILE ? "while" : "for",
+                loops[i]->line, (long long) loops[i]->counters[0], loops[i]->procedure);
+    }
+
+    free(procedures);
+    free(loops);
+    fclose(file);
+}
+
+void pl0rt_profile_start(const pl0rt_profile_entry* entries, int32_t count, const char* program) {
+    profileEntries = entries;
+    profileCount = count;
+    profileProgram = program;
+
+    measureOverhead();
+    atexit(writeProfile);
+}
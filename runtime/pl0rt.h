@@ -0,0 +1,56 @@
+#ifndef _PL0RT_H_
+#define _PL0RT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+
+Runtime library of the PL/0 programs, linked only when a program uses it.
+
+*/
+
+// A procedure call, `staticLink` is null when the procedure takes no
+// arguments.
+typedef struct pl0rt_task {
+    void (*procedure)(void);
+    void* staticLink;
+} pl0rt_task;
+
+// Runs the tasks concurrently on the thread pool and returns when all of
+// them are done. The calling thread runs the first task. The pool has one
+// thread less than the online CPUs, or PL0_THREADS - 1 when it's set.
+void pl0rt_parallel(const pl0rt_task* tasks, int32_t count);
+
+// Profile of a program compiled with -profile-runtime.
+
+enum {
+    PL0RT_PROFILE_PROCEDURE,    // counters: calls, sampled calls, cycles of the sampled calls
+    PL0RT_PROFILE_WHILE,        // counters: iterations
+    PL0RT_PROFILE_FOR           // counters: iterations
+};
+
+// The cycles are read in about one call out of PL0RT_PROFILE_SAMPLING, the
+// first one included. The calls are picked by a hash of their number, not
+// to follow the patterns of the loops calling them.
+#define PL0RT_PROFILE_SAMPLING 64
+
+typedef struct pl0rt_profile_entry {
+    const char* procedure;
+    int32_t line;
+    int32_t kind;
+    const int64_t* counters;
+} pl0rt_profile_entry;
+
+// Writes the report of the counters at exit, to PL0_PROFILE or
+// <program>.profile in the working directory.
+void pl0rt_profile_start(const pl0rt_profile_entry* entries, int32_t count, const char* program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include "symtable.hpp"
+#include "memstats.hpp"
 
 namespace pl0::symtable {
 
@@ -15,6 +16,8 @@ auto SymbolTable::lookup(const std::string& key) -> SymbolEntry* {
 
 auto SymbolTable::insert(const std::string& key, SymbolEntry info) -> bool {
 
+    memstats::CategoryScope category(memstats::Category::SymbolTables);
+
     if(m_symbols.contains(key)) {
         return false;
     }
@@ -1,6 +1,7 @@
 #ifndef _SYMTABLE_HPP_
 #define _SYMTABLE_HPP_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <variant>
@@ -12,13 +13,22 @@
 namespace pl0::symtable {
 
 
+// Variable living in the activation frame of the procedure at `depth`.
+struct FrameSlot {
+    std::uint32_t depth;
+    std::uint32_t index;
+};
+
 class SymbolEntry {
 private:
-    SymbolEntry(llvm::Value* value, bool isConstant)
-        : m_data(value), m_isConstant(isConstant) {}
+    SymbolEntry(llvm::Value* value, bool isConstant, bool isShared = false, std::uint32_t length = 0)
+        : m_data(value), m_isConstant(isConstant), m_isShared(isShared), m_length(length) {}
+
+    SymbolEntry(FrameSlot slot, std::uint32_t length)
+        : m_data(slot), m_isConstant(false), m_length(length) {}
 
-    SymbolEntry(llvm::Function* value)
-        : m_data(value), m_isConstant(false) {}
+    SymbolEntry(llvm::Function* value, std::uint32_t depth)
+        : m_data(value), m_isConstant(false), m_depth(depth) {}
 
 public:
     SymbolEntry() = default;
@@ -31,8 +41,24 @@ public:
         return SymbolEntry(value, false);
     }
 
-    static inline auto procedure(llvm::Function* value) -> SymbolEntry {
-        return SymbolEntry(value);
+    // Global accessed atomically, see the parallel statement.
+    static inline auto sharedVariable(llvm::Value* value) -> SymbolEntry {
+        return SymbolEntry(value, false, true);
+    }
+
+    // `value` points to `length` contiguous integers.
+    static inline auto array(llvm::Value* value, std::uint32_t length) -> SymbolEntry {
+        return SymbolEntry(value, false, false, length);
+    }
+
+    // `length` is 0 for scalars.
+    static inline auto capturedVariable(FrameSlot slot, std::uint32_t length = 0) -> SymbolEntry {
+        return SymbolEntry(slot, length);
+    }
+
+    // `depth` is the nesting level of the block declaring the procedure.
+    static inline auto procedure(llvm::Function* value, std::uint32_t depth) -> SymbolEntry {
+        return SymbolEntry(value, depth);
     }
 
     constexpr auto isProcedure() const -> bool {
@@ -47,6 +73,18 @@ public:
         return !isConstant() && !isProcedure();
     }
 
+    constexpr auto isShared() const -> bool {
+        return m_isShared;
+    }
+
+    constexpr auto isCaptured() const -> bool {
+        return std::holds_alternative<FrameSlot>(m_data);
+    }
+
+    constexpr auto isArray() const -> bool {
+        return m_length > 0;
+    }
+
     constexpr auto procedure() const -> llvm::Function* {
         return std::get<llvm::Function*>(m_data);
     }
@@ -59,10 +97,24 @@ public:
         return std::get<llvm::Value*>(m_data);
     } 
 
+    constexpr auto frameSlot() const -> FrameSlot {
+        return std::get<FrameSlot>(m_data);
+    }
+
+    constexpr auto depth() const -> std::uint32_t {
+        return m_depth;
+    }
+
+    constexpr auto length() const -> std::uint32_t {
+        return m_length;
+    }
     
 private:
-    std::variant<llvm::Value*, llvm::Function*>  m_data;
+    std::variant<llvm::Value*, llvm::Function*, FrameSlot>  m_data;
     bool m_isConstant;
+    bool m_isShared = false;
+    std::uint32_t m_depth = 0;
+    std::uint32_t m_length = 0;
 };
 
 class SymbolTable : public std::enable_shared_from_this<SymbolTable> {
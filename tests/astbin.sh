@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+#
+# Binary AST tests. Every valid program of the tests is saved with
+# -emit-ast-bin and loaded back: its -ast dump and its bytecode must be
+# those of the source. tests/astbin/program.pl0, with a node of every kind,
+# is also cut at every byte and each part must be a load error. The .hex
+# files are corrupt ASTs, written as one line of hex digits, whose load
+# error must be that of the .expected file next to them.
+#
+# Usage: tests/astbin.sh <pl0 compiler>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+
+for program in "$TESTS_DIR"/*/*.pl0; do
+    name=$(basename "$(dirname "$program")")_$(basename "$program" .pl0)
+    cp "$program" "$WORK/$name.pl0"
+
+    # The programs testing the diagnostics have no AST to save.
+    if ! "$COMPILER" -ast -bytecode "$WORK/$name.pl0" > "$WORK/$name.source"; then
+        continue
+    fi
+
+    if "$COMPILER" -emit-ast-bin "$WORK/$name.pl0" \
+        && "$COMPILER" -ast -bytecode "$WORK/$name.ast" > "$WORK/$name.loaded" \
+        && cmp -s "$WORK/$name.source" "$WORK/$name.loaded"; then
+        echo "PASS: astbin/round-trip $name"
+    else
+        echo "FAIL: astbin/round-trip $name"
+        failed=1
+    fi
+done
+
+ast="$WORK/astbin_program.ast"
+size=$(stat -c %s "$ast")
+truncated=0
+
+for ((length = 0; length < size; length++)); do
+    head -c "$length" "$ast" > "$WORK/truncated.ast"
+
+    status=0
+    "$COMPILER" -ast "$WORK/truncated.ast" > "$WORK/truncated.out" || status=$?
+
+    if [ "$status" -ne 1 ] || ! grep -q "^Load Error: " "$WORK/truncated.out"; then
+        echo "astbin/truncated: the first $length bytes aren't a load error (exit $status)."
+        truncated=1
+    fi
+done
+
+if [ "$truncated" -eq 0 ]; then
+    echo "PASS: astbin/truncated"
+else
+    echo "FAIL: astbin/truncated"
+    failed=1
+fi
+
+for hex in "$TESTS_DIR"/astbin/*.hex; do
+    name=$(basename "$hex" .hex)
+    printf '%b' "$(sed 's/../\\x&/g' "$hex")" > "$WORK/$name.ast"
+
+    status=0
+    "$COMPILER" -ast "$WORK/$name.ast" > "$WORK/$name.out" || status=$?
+    echo "[exit $status]" >> "$WORK/$name.out"
+
+    if diff -u "${hex%.hex}.expected" "$WORK/$name.out"; then
+        echo "PASS: astbin/$name"
+    else
+        echo "FAIL: astbin/$name"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+#
+# Differential tests: runs every program in tests/differential in every
+# mode in MODES, reading the .in file next to it when there is one, and
+# compares the output and the exit status with the .expected file, or the
+# compile errors and the exit status of the compiler when it fails. The
+# -tiered mode compiles the procedures from their first call, so that
+# the native code runs too.
+#
+# Usage: tests/differential.sh <pl0 compiler>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+MODES=(-interp -tiered -O0 -O2)
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+
+for program in "$TESTS_DIR"/differential/*.pl0; do
+    name=$(basename "$program" .pl0)
+
+    input=/dev/null
+    if [ -f "${program%.pl0}.in" ]; then
+        input=${program%.pl0}.in
+    fi
+
+    for mode in "${MODES[@]}"; do
+        dir="$WORK/$name$mode"
+        mkdir -p "$dir"
+        cp "$program" "$dir/$name.pl0"
+
+        status=0
+        if [ "$mode" = -interp ]; then
+            "$COMPILER" "$mode" "$dir/$name.pl0" < "$input" > "$dir/output" || status=$?
+        elif [ "$mode" = -tiered ]; then
+            PL0_TIER_THRESHOLD=1 "$COMPILER" "$mode" -no-jit-cache "$dir/$name.pl0" < "$input" > "$dir/output" || status=$?
+        elif "$COMPILER" "$mode" "$dir/$name.pl0" > "$dir/output"; then
+            "$dir/$name" < "$input" > "$dir/output" || status=$?
+        else
+            # The compile errors are compared like the runtime ones.
+            status=$?
+        fi
+        echo "[exit $status]" >> "$dir/output"
+
+        if diff -u "${program%.pl0}.expected" "$dir/output" > "$dir/diff"; then
+            echo "PASS: differential/$name $mode"
+        else
+            echo "FAIL: differential/$name $mode"
+            cat "$dir/diff"
+            failed=1
+        fi
+    done
+done
+
+exit $failed
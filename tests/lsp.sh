@@ -0,0 +1,145 @@
+#!/usr/bin/env bash
+#
+# Language server tests: opens every program in tests/lsp in one -lsp
+# session and applies the edits of the .edits file next to it one at a
+# time, as incremental changes. After each edit the same text is also sent
+# whole to a second document, which is parsed from scratch: the diagnostics
+# and the document symbols of both documents must be identical.
+#
+# An edit is a line "<start line> <start character> <end line> <end
+# character>|<text>", counted from 0 in UTF-16 code units like the client
+# that doesn't accept UTF-8, with the text escaped as in JSON.
+#
+# Usage: tests/lsp.sh <pl0 compiler>
+
+set -euo pipefail
+
+export LC_ALL=C
+
+COMPILER=$(realpath "$1")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+EDITED=file:///edited.pl0
+FRESH=file:///fresh.pl0
+
+# send <json>
+send() {
+    printf 'Content-Length: %d\r\n\r\n%s' "${#1}" "$1"
+}
+
+# The text of a file as a JSON string.
+quote() {
+    awk 'BEGIN { RS = "\001"; ORS = "" }
+         { gsub(/\\/, "\\\\"); gsub(/"/, "\\\""); gsub(/\t/, "\\t"); gsub(/\n/, "\\n"); text = $0 }
+         END { print "\"" text "\"" }' "$1"
+}
+
+# apply <file> <start line> <start character> <end line> <end character> <text>
+# Replaces the range like the server: the characters are UTF-16 code units,
+# the lines past the last one are the last one and the characters past the
+# end of a line are its end. awk unescapes the text.
+apply() {
+    awk -v startLine="$2" -v startCharacter="$3" -v endLine="$4" -v endCharacter="$5" -v text="$6" '
+        BEGIN {
+            RS = "\001"; ORS = ""
+            for(i = 1; i < 256; i++) byte[sprintf("%c", i)] = i
+        }
+
+        { document = $0 }
+
+        function offset(line, character,    position, i, newline, end_, code, size, units) {
+            position = 1
+
+            for(i = 0; i < line; i++) {
+                newline = index(substr(document, position), "\n")
+                if(newline == 0) break
+                position += newline
+            }
+
+            newline = index(substr(document, position), "\n")
+            end_ = newline == 0 ? length(document) + 1 : position + newline - 1
+
+            while(position < end_ && character > 0) {
+                code = byte[substr(document, position, 1)]
+                size = code >= 240 ? 4 : code >= 224 ? 3 : code >= 192 ? 2 : 1
+                units = size == 4 ? 2 : 1
+
+                if(character < units) break
+
+                character -= units
+                position = position + size < end_ ? position + size : end_
+            }
+
+            return position
+        }
+
+        END {
+            start = offset(startLine, startCharacter)
+            end_ = offset(endLine, endCharacter)
+            print substr(document, 1, start - 1) text substr(document, end_)
+        }' "$1" > "$1.new"
+
+    mv "$1.new" "$1"
+}
+
+failed=0
+
+for program in "$TESTS_DIR"/lsp/*.pl0; do
+    name=$(basename "$program" .pl0)
+    text="$WORK/$name.pl0"
+    cp "$program" "$text"
+
+    steps=0
+
+    {
+        send '{"jsonrpc":"2.0","id":0,"method":"initialize","params":{}}'
+
+        for uri in "$EDITED" "$FRESH"; do
+            send '{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"'"$uri"'","text":'"$(quote "$text")"'}}}'
+        done
+
+        while IFS= read -r edit; do
+            read -r startLine startCharacter endLine endCharacter <<< "${edit%%|*}"
+            change=${edit#*|}
+
+            apply "$text" "$startLine" "$startCharacter" "$endLine" "$endCharacter" "$change"
+            steps=$((steps + 1))
+
+            send '{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"'"$EDITED"'"},"contentChanges":[{"range":{"start":{"line":'"$startLine"',"character":'"$startCharacter"'},"end":{"line":'"$endLine"',"character":'"$endCharacter"'}},"text":"'"$change"'"}]}}'
+            send '{"jsonrpc":"2.0","id":'"$steps"',"method":"textDocument/documentSymbol","params":{"textDocument":{"uri":"'"$EDITED"'"}}}'
+
+            send '{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"'"$FRESH"'"},"contentChanges":[{"text":'"$(quote "$text")"'}]}}'
+            send '{"jsonrpc":"2.0","id":'"$steps"',"method":"textDocument/documentSymbol","params":{"textDocument":{"uri":"'"$FRESH"'"}}}'
+        done < "${program%.pl0}.edits"
+
+        send '{"jsonrpc":"2.0","id":0,"method":"shutdown"}'
+        send '{"jsonrpc":"2.0","method":"exit"}'
+    } > "$WORK/$name.in"
+
+    steps=$(wc -l < "${program%.pl0}.edits")
+
+    # One message per line, the replies of the edited document first. The
+    # initialize reply comes first, then the diagnostics of both documents
+    # opened, then per edit those of the edited document, its symbols,
+    # those of the fresh one and its symbols.
+    if "$COMPILER" -lsp < "$WORK/$name.in" > "$WORK/$name.out" \
+        && sed 's/Content-Length: [0-9]*\r$//' "$WORK/$name.out" | tr -d '\r' | grep -v '^$' \
+            | sed "s|$FRESH|$EDITED|" \
+            | awk -v steps="$steps" -v edited="$WORK/$name.edited" -v fresh="$WORK/$name.fresh" '
+                NR == 1 || NR > 3 + 4 * steps { next }
+                NR <= 3 { print > (NR == 2 ? edited : fresh); next }
+                { print > ((NR - 4) % 4 < 2 ? edited : fresh) }' \
+        && [ "$(wc -l < "$WORK/$name.edited")" -eq $((1 + 2 * steps)) ] \
+        && diff -u "$WORK/$name.edited" "$WORK/$name.fresh"; then
+        echo "PASS: lsp/$name"
+    else
+        echo "FAIL: lsp/$name"
+        failed=1
+    fi
+done
+
+exit $failed
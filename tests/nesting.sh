@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+#
+# Nesting test: generates a program whose main block is nested NESTING
+# levels deep (1,000,000 by default) and checks that every path through the
+# AST handles it without running out of stack: the bytecode interpreter, the
+# tiered mode, the binary AST written and loaded back, the JSON dump and the
+# compiled programs at -O0, at -O2 and in one pass, which must also run.
+#
+# Usage: tests/nesting.sh <pl0 compiler> <pl0gen>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+GENERATOR=$(realpath "$2")
+NESTING=${NESTING:-1000000}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+"$GENERATOR" -depth=0 -procedures=0 -nesting="$NESTING" > "$WORK/nesting.pl0"
+
+failed=0
+
+# check <name> <command>...
+check() {
+    local name=$1
+    shift
+
+    if "$@"; then
+        echo "PASS: nesting $name"
+    else
+        echo "FAIL: nesting $name"
+        failed=1
+    fi
+}
+
+compileAndRun() {
+    rm -f "$WORK/nesting"
+    "$COMPILER" "$@" "$WORK/nesting.pl0" && "$WORK/nesting"
+}
+
+astBinary() {
+    rm -f "$WORK/nesting.ast"
+    "$COMPILER" -emit-ast-bin "$WORK/nesting.pl0" && "$COMPILER" -interp "$WORK/nesting.ast"
+}
+
+astJson() {
+    "$COMPILER" -ast-json "$WORK/nesting.pl0" > /dev/null
+}
+
+check -interp "$COMPILER" -interp "$WORK/nesting.pl0"
+check -tiered "$COMPILER" -tiered -no-jit-cache "$WORK/nesting.pl0"
+check -emit-ast-bin astBinary
+check -ast-json astJson
+check -O0 compileAndRun -O0
+check -O2 compileAndRun -O2
+check -one-pass compileAndRun -one-pass
+
+exit $failed
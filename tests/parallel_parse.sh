@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+#
+# Parallel parse tests: parses every program in tests/parallel_parse in
+# order and with -parallel-parse=4, and checks that the ASTs, or the
+# diagnostics when the program doesn't parse, and the exit statuses are
+# identical. Besides a valid program, they cover the procedures parsed ahead
+# that must be parsed again in order: a syntax error in one of them, the
+# procedures after an error (panic mode), a pre-scan stopped by a malformed
+# header and a pre-scanned range running past the end of its procedure.
+#
+# Usage: tests/parallel_parse.sh <pl0 compiler>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+
+# parse <output> <options>...
+parse() {
+    local output=$1
+    shift
+
+    local status=0
+    "$COMPILER" "$@" -ast "$program" > "$output" 2>&1 || status=$?
+    echo "[exit $status]" >> "$output"
+}
+
+for program in "$TESTS_DIR"/parallel_parse/*.pl0; do
+    name=$(basename "$program" .pl0)
+
+    parse "$WORK/$name.serial"
+    parse "$WORK/$name.parallel" -parallel-parse=4
+
+    if diff -u "$WORK/$name.serial" "$WORK/$name.parallel"; then
+        echo "PASS: parallel_parse/$name"
+    else
+        echo "FAIL: parallel_parse/$name"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+#
+# Peephole tests: compiles every program in tests/peephole at -O0, where
+# the peephole pass is the only one run, and matches the LLVM IR against
+# the CHECK lines of the .check file next to it.
+#
+# Usage: tests/peephole.sh <pl0 compiler> <FileCheck>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+FILECHECK=$2
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+
+for program in "$TESTS_DIR"/peephole/*.pl0; do
+    name=$(basename "$program" .pl0)
+    cp "$program" "$WORK/$name.pl0"
+
+    if "$COMPILER" -O0 -llvm "$WORK/$name.pl0" > "$WORK/$name.ll" \
+        && "$FILECHECK" --input-file="$WORK/$name.ll" "$TESTS_DIR/peephole/$name.check"; then
+        echo "PASS: peephole/$name"
+    else
+        echo "FAIL: peephole/$name"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+#
+# Runtime profile tests: compiles every program in tests/profile with
+# -profile-runtime, runs it and compares the calls of the procedures and
+# the iterations of the loops in the profile with the .expected file. The
+# cycles vary from run to run and aren't compared.
+#
+# Usage: tests/profile.sh <pl0 compiler>
+
+set -euo pipefail
+
+COMPILER=$(realpath "$1")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+
+for program in "$TESTS_DIR"/profile/*.pl0; do
+    name=$(basename "$program" .pl0)
+    cp "$program" "$WORK/$name.pl0"
+
+    # One line per entry: procedure <name> <line> <calls> or
+    # <loop> <line> <iterations> <procedure>, sorted.
+    if "$COMPILER" -profile-runtime "$WORK/$name.pl0" \
+        && PL0_PROFILE="$WORK/$name.profile" "$WORK/$name" > /dev/null \
+        && awk '/^#/ || NF == 0 { next }
+                $1 == "procedure" && $2 == "line" { section = "procedure"; next }
+                $1 == "loop" && $2 == "line" { section = "loop"; next }
+                section == "procedure" { print "procedure", $1, $2, $3; next }
+                { print $1, $2, $3, $4 }' "$WORK/$name.profile" | LC_ALL=C sort > "$WORK/$name.counts" \
+        && diff -u "${program%.pl0}.expected" "$WORK/$name.counts"; then
+        echo "PASS: profile/$name"
+    else
+        echo "FAIL: profile/$name"
+        failed=1
+    fi
+done
+
+exit $failed
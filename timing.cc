@@ -0,0 +1,123 @@
+#include "timing.hpp"
+#include "memstats.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace pl0::timing {
+
+namespace {
+
+struct PhaseRecord {
+    const char* name;
+    std::uint32_t depth;
+    double wallMilliseconds;
+    double cpuMilliseconds;
+};
+
+bool reportEnabled = false;
+bool finishRegistered = false;
+
+// Phases are recorded on the main thread only, e.g. not the code
+// generation of the tier (-tiered) running beside the interpreter.
+const std::thread::id mainThread = std::this_thread::get_id();
+
+std::string tracePath;
+std::uint32_t currentDepth = 0;
+std::vector<PhaseRecord> records;
+
+auto printReport() -> void {
+
+    std::string report = std::format("{:<32}{:>14}{:>14}\n", "Phase", "Wall (ms)", "CPU (ms)");
+
+    double totalWall = 0;
+    double totalCpu = 0;
+
+    for(const auto& [name, depth, wall, cpu] : records) {
+        const std::string label = std::string(depth * 2, ' ') + name;
+        report += std::format("{:<32}{:>14.3f}{:>14.3f}\n", label, wall, cpu);
+
+        if(depth == 0) {
+            totalWall += wall;
+            totalCpu += cpu;
+        }
+    }
+
+    report += std::format("{:<32}{:>14.3f}{:>14.3f}\n", "total", totalWall, totalCpu);
+    std::fputs(report.c_str(), stderr);
+}
+
+auto writeTrace() -> void {
+
+    std::error_code errorCode;
+    llvm::raw_fd_ostream stream(tracePath, errorCode, llvm::sys::fs::OF_Text);
+
+    if(errorCode) {
+        llvm::errs() << "Could not open the trace file: " << errorCode.message() << '\n';
+    } else {
+        llvm::timeTraceProfilerWrite(stream);
+    }
+
+    llvm::timeTraceProfilerCleanup();
+}
+
+auto finish() -> void {
+    if(reportEnabled) printReport();
+    if(!tracePath.empty()) writeTrace();
+}
+
+auto registerFinish() -> void {
+    if(finishRegistered) return;
+
+    std::atexit(finish);
+    finishRegistered = true;
+}
+
+}
+
+auto enablePhaseReport() -> void {
+    reportEnabled = true;
+    registerFinish();
+}
+
+auto enableTrace(const char* processName, std::string path) -> void {
+    tracePath = std::move(path);
+
+    // Zero granularity keeps also the shortest passes in the trace.
+    llvm::timeTraceProfilerInitialize(0, processName);
+    registerFinish();
+}
+
+Phase::Phase(const char* name)
+    : m_traceScope(name),
+      m_index(std::this_thread::get_id() == mainThread ? records.size() : NOT_RECORDED),
+      m_wallStart(std::chrono::steady_clock::now()),
+      m_cpuStart(std::clock()) {
+
+    if(m_index == NOT_RECORDED) return;
+
+    records.push_back({name, currentDepth++, 0, 0});
+    memstats::beginPhase();
+}
+
+Phase::~Phase() {
+    if(m_index == NOT_RECORDED) return;
+
+    const std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - m_wallStart;
+    const double cpu = 1000.0 * static_cast<double>(std::clock() - m_cpuStart) / CLOCKS_PER_SEC;
+
+    records[m_index].wallMilliseconds = wall.count();
+    records[m_index].cpuMilliseconds = cpu;
+    currentDepth--;
+
+    memstats::endPhase(records[m_index].name, currentDepth);
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef _TIMING_HPP_
+#define _TIMING_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include "llvm/Support/TimeProfiler.h"
+
+namespace pl0::timing {
+
+// Enables the wall/CPU time table printed on stderr at exit.
+auto enablePhaseReport() -> void;
+
+// Enables the Chrome trace-event output written to `path` at exit. The
+// LLVM passes entries are recorded by the same profiler.
+auto enableTrace(const char* processName, std::string path) -> void;
+
+// Times a compiler phase, phases can be nested. It takes also the memory
+// snapshot of the phase when -mem-stats is enabled.
+class Phase final {
+public:
+    explicit Phase(const char* name);
+    ~Phase();
+
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+
+private:
+    static constexpr std::size_t NOT_RECORDED = static_cast<std::size_t>(-1);
+
+    llvm::TimeTraceScope m_traceScope;
+
+    std::size_t m_index;
+    std::chrono::steady_clock::time_point m_wallStart;
+    std::clock_t m_cpuStart;
+};
+
+}
+
+#endif
@@ -31,6 +31,8 @@ enum class TokenType : std::uint8_t {
     Slash,
     LeftParen,
     RightParen,
+    LeftBracket,
+    RightBracket,
     
     // Keywords
     ConstKeyword,
@@ -43,6 +45,11 @@ enum class TokenType : std::uint8_t {
     ThenKeyword,
     WhileKeyword,
     DoKeyword,
+    ForKeyword,
+    ToKeyword,
+    StepKeyword,
+    SharedKeyword,
+    ParallelKeyword,
     OddKeyword,
 
     // Errors
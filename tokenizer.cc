@@ -6,17 +6,35 @@ namespace pl0::tokenizer {
 
 auto Tokenizer::tokenize() -> std::vector<Token> {
 
+    std::vector<Token> tokens;
+
+    do {
+        tokens.push_back(next());
+    } while(tokens.back().type != TokenType::Eof);
+
+    return tokens;
+}
+
+auto Tokenizer::next() -> Token {
+
     while(!isAtEnd()){
         m_start = m_curr;
-        scanToken();
+        if(scanToken()) return m_token;
     }
 
     makeToken(TokenType::Eof);
+    return m_token;
+}
+
+auto Tokenizer::read(std::vector<Token>& tokens) -> void {
 
-    return m_tokens;
+    for(std::size_t i = 0; i < BATCH_SIZE; i++) {
+        tokens.push_back(next());
+        if(tokens.back().type == TokenType::Eof) return;
+    }
 }
 
-auto Tokenizer::scanToken() -> void {
+auto Tokenizer::scanToken() -> bool {
 
     const char c = advance();
 
@@ -29,68 +47,54 @@ auto Tokenizer::scanToken() -> void {
         case '\r':
             [[fallthrough]];
         case '\t':
-            break;
+            return false;
         case '.':
-            makeToken(TokenType::Dot);
-            break;
+            return makeToken(TokenType::Dot);
         case '=':
-            makeToken(TokenType::Equal);
-            break;
+            return makeToken(TokenType::Equal);
         case ',':
-            makeToken(TokenType::Comma);
-            break;
+            return makeToken(TokenType::Comma);
         case ';':
-            makeToken(TokenType::Semicolon);
-            break;
+            return makeToken(TokenType::Semicolon);
         case ':':
-            makeToken(match('=') 
+            return makeToken(match('=') 
                         ? TokenType::Assign
                         : TokenType::UnexpectedCharacter);
-            break;
         case '?':
-            makeToken(TokenType::QuestionMark);
-            break;
+            return makeToken(TokenType::QuestionMark);
         case '!':
-            makeToken(TokenType::ExclamationMark);
-            break;
+            return makeToken(TokenType::ExclamationMark);
         case '#':
-            makeToken(TokenType::NotEqual);
-            break;
+            return makeToken(TokenType::NotEqual);
         case '<':
-            makeToken(match('=') 
+            return makeToken(match('=') 
                         ? TokenType::LessEqual
                         : TokenType::Less);
-            break;
         case '>':
-            makeToken(match('=') 
+            return makeToken(match('=') 
                         ? TokenType::GreaterEqual
                         : TokenType::Greater);
-            break;
         case '+':
-            makeToken(TokenType::Plus);
-            break;
+            return makeToken(TokenType::Plus);
         case '-':
-            makeToken(TokenType::Minus);
-            break;
+            return makeToken(TokenType::Minus);
         case '*':
-            makeToken(TokenType::Star);
-            break;
+            return makeToken(TokenType::Star);
         case '/':
-            makeToken(TokenType::Slash);
-            break;
+            return makeToken(TokenType::Slash);
         case '(':
-            makeToken(TokenType::LeftParen);
-            break;
+            return makeToken(TokenType::LeftParen);
         case ')':
-            makeToken(TokenType::RightParen);
-            break;
+            return makeToken(TokenType::RightParen);
+        case '[':
+            return makeToken(TokenType::LeftBracket);
+        case ']':
+            return makeToken(TokenType::RightBracket);
         default: {
 
             if(std::isdigit(c)){
                 while(std::isdigit(peek())) advance();
-                makeToken(TokenType::Number);
-
-                break;
+                return makeToken(TokenType::Number);
             }
 
             if(std::isalpha(c)) {
@@ -100,15 +104,12 @@ auto Tokenizer::scanToken() -> void {
                 const auto lexeme = m_source.substr(m_start, m_curr - m_start);
                 const auto entry = m_keywords.find(lexeme);
 
-                makeToken(entry != m_keywords.end()
+                return makeToken(entry != m_keywords.end()
                             ? entry->second
                             : TokenType::Identifier);
-
-                break;
             }
 
-            makeToken(TokenType::UnexpectedCharacter);
-            break;
+            return makeToken(TokenType::UnexpectedCharacter);
         }
     }
 
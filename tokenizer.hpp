@@ -4,6 +4,7 @@
 #include "token.hpp"
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 #include <unordered_map>
@@ -12,16 +13,36 @@ namespace pl0::tokenizer {
 
 using namespace token;
 
-class Tokenizer final {
+// Tokens pulled by a parser, a batch at a time.
+class TokenSource {
 public:
-    explicit Tokenizer(std::string_view source) 
-        : m_source(source) {}
+    virtual ~TokenSource() = default;
+
+    // Appends the next batch to `tokens`, the last one ends with Eof and
+    // no batch is read after it.
+    virtual auto read(std::vector<Token>& tokens) -> void = 0;
+};
+
+class Tokenizer final : public TokenSource {
+public:
+    // `line` is the number of the first line of the source.
+    explicit Tokenizer(std::string_view source, std::uint32_t line = 1)
+        : m_source(source), m_line(line) {}
 
     auto tokenize() -> std::vector<Token>;
 
+    // Scans the next token only, Eof at the end and after it.
+    auto next() -> Token;
+
+    // Scans up to BATCH_SIZE tokens.
+    auto read(std::vector<Token>& tokens) -> void override;
+
+    static constexpr std::size_t BATCH_SIZE = 4096;
+
 private:
 
-    auto scanToken() -> void;
+    // True if the character scanned made a token, it's in m_token.
+    auto scanToken() -> bool;
 
     inline auto advance() -> char {
         return !isAtEnd()
@@ -42,20 +63,24 @@ private:
     }
 
     constexpr auto peek() const -> char {
-        return m_source[m_curr];
+        return !isAtEnd()
+            ? m_source[m_curr]
+            : '\0';
     }
     
-    inline auto makeToken(TokenType type) -> void {
+    inline auto makeToken(TokenType type) -> bool {
         const auto lexemeLength = m_curr - m_start;
-        m_tokens.emplace_back(type, m_source.substr(m_start, lexemeLength), m_line);
+        m_token = Token(type, m_source.substr(m_start, lexemeLength), m_line);
+
+        return true;
     }
 
 private:
 
     std::string_view m_source;
-    std::vector<Token> m_tokens;
+    Token m_token;
 
-    const std::unordered_map<std::string_view, TokenType> m_keywords = {
+    static inline const std::unordered_map<std::string_view, TokenType> m_keywords = {
         {"const", TokenType::ConstKeyword},
         {"var", TokenType::VarKeyword},
         {"procedure", TokenType::ProcedureKeyword},
@@ -66,13 +91,18 @@ private:
         {"then", TokenType::ThenKeyword},
         {"while", TokenType::WhileKeyword},
         {"do", TokenType::DoKeyword},
+        {"for", TokenType::ForKeyword},
+        {"to", TokenType::ToKeyword},
+        {"step", TokenType::StepKeyword},
+        {"shared", TokenType::SharedKeyword},
+        {"parallel", TokenType::ParallelKeyword},
         {"odd", TokenType::OddKeyword}
     };
 
     std::uint32_t m_curr = 0;
     std::uint32_t m_start = 0;
 
-    std::uint32_t m_line = 1;
+    std::uint32_t m_line;
 };
 
 }